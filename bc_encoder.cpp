@@ -0,0 +1,783 @@
+#include "bc_encoder.h"
+#include "cpu_features.h"
+#include "stb_image.h"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <immintrin.h>
+
+// Not part of GL 3.3 core, so glad doesn't define them
+#define BC_GL_COMPRESSED_RGB_S3TC_DXT1 0x83F0
+#define BC_GL_COMPRESSED_RGBA_S3TC_DXT5 0x83F3
+#define BC_GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+
+const char *BcFormatName(BcFormat f) {
+    switch (f) {
+    case BC_FORMAT_NONE: return "none";
+    case BC_FORMAT_BC1: return "bc1";
+    case BC_FORMAT_BC3: return "bc3";
+    case BC_FORMAT_BC7: return "bc7";
+    default: return "auto";
+    }
+}
+
+bool BcFormatParse(const char *name, BcFormat &f) {
+    const BcFormat formats[] = { BC_FORMAT_NONE, BC_FORMAT_BC1, BC_FORMAT_BC3, BC_FORMAT_BC7, BC_FORMAT_AUTO };
+    for (BcFormat candidate : formats) {
+        if (strcmp(name, BcFormatName(candidate)) == 0) {
+            f = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *BcPathName(BcPath path) {
+    switch (path) {
+    case BC_PATH_SCALAR: return "scalar";
+    case BC_PATH_AVX2: return "avx2";
+    default: return "auto";
+    }
+}
+
+static BcPath BcBestPath() {
+    return CpuGetFeatures().avx2 ? BC_PATH_AVX2 : BC_PATH_SCALAR;
+}
+
+uint32_t BcBlockBytes(BcFormat f) {
+    return f == BC_FORMAT_BC1 ? 8 : 16;
+}
+
+uint64_t BcImageSize(BcFormat f, uint32_t width, uint32_t height) {
+    uint64_t blocksX = (width + BC_BLOCK_DIM - 1) / BC_BLOCK_DIM;
+    uint64_t blocksY = (height + BC_BLOCK_DIM - 1) / BC_BLOCK_DIM;
+    return blocksX * blocksY * BcBlockBytes(f);
+}
+
+// One 4x4 block, channel planes of 16 pixels in row order
+// ---------------------------
+struct alignas(32) BcBlock {
+    float c[4][16]; // r, g, b, a
+};
+
+static void BcSourcePixel(const uint8_t *p, uint32_t channels, uint8_t rgba[4]) {
+    rgba[0] = p[0];
+    rgba[1] = channels >= 3 ? p[1] : p[0];
+    rgba[2] = channels >= 3 ? p[2] : p[0];
+    rgba[3] = channels == 4 ? p[3] : channels == 2 ? p[1] : 255;
+}
+
+static void BcFetchBlock(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t channels,
+                         uint32_t blockX, uint32_t blockY, BcBlock &b) {
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t x = std::min(blockX * BC_BLOCK_DIM + (i & 3), width - 1);
+        uint32_t y = std::min(blockY * BC_BLOCK_DIM + (i >> 2), height - 1);
+        uint8_t rgba[4];
+        BcSourcePixel(pixels + ((size_t)y * width + x) * channels, channels, rgba);
+        for (uint32_t c = 0; c < 4; ++c) {
+            b.c[c][i] = rgba[c];
+        }
+    }
+}
+
+// Least squares sums over the pixels for index weights a = levels-1-k and
+// b = k of position k
+struct BcRefitSums {
+    float aa, ab, bb;
+    float ap[4];
+    float bp[4];
+};
+
+// Per pixel kernels
+// ---------------------------
+struct BcKernels {
+    // Sum of each channel and of every channel product rr rg rb ra gg gb ga bb ba aa
+    void (*moments)(const BcBlock &b, float sums[4], float products[10]);
+    // Extent of the pixels along `axis` through `origin`
+    void (*axisRange)(const BcBlock &b, const float origin[4], const float axis[4], float &tMin, float &tMax);
+    // Nearest of `levels` evenly spaced positions from e0 to e1
+    void (*assign)(const BcBlock &b, const float e0[4], const float e1[4], uint32_t levels, uint8_t positions[16]);
+    void (*refit)(const BcBlock &b, const uint8_t positions[16], uint32_t levels, BcRefitSums &s);
+};
+
+static void BcMomentsScalar(const BcBlock &b, float sums[4], float products[10]) {
+    std::fill(sums, sums + 4, 0.0f);
+    std::fill(products, products + 10, 0.0f);
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t n = 0;
+        for (uint32_t c0 = 0; c0 < 4; ++c0) {
+            sums[c0] += b.c[c0][i];
+            for (uint32_t c1 = c0; c1 < 4; ++c1) {
+                products[n++] += b.c[c0][i] * b.c[c1][i];
+            }
+        }
+    }
+}
+
+static void BcAxisRangeScalar(const BcBlock &b, const float origin[4], const float axis[4], float &tMin, float &tMax) {
+    tMin = FLT_MAX;
+    tMax = -FLT_MAX;
+    for (uint32_t i = 0; i < 16; ++i) {
+        float t = (b.c[0][i] - origin[0]) * axis[0] + (b.c[1][i] - origin[1]) * axis[1] +
+                  (b.c[2][i] - origin[2]) * axis[2] + (b.c[3][i] - origin[3]) * axis[3];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+}
+
+static void BcAssignScalar(const BcBlock &b, const float e0[4], const float e1[4], uint32_t levels, uint8_t positions[16]) {
+    float d[4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        d[c] = e1[c] - e0[c];
+    }
+    float length2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + d[3] * d[3];
+    float top = (float)(levels - 1);
+    float scale = length2 > 0.0f ? top / length2 : 0.0f;
+    for (uint32_t i = 0; i < 16; ++i) {
+        float t = ((b.c[0][i] - e0[0]) * d[0] + (b.c[1][i] - e0[1]) * d[1] +
+                   (b.c[2][i] - e0[2]) * d[2] + (b.c[3][i] - e0[3]) * d[3]) * scale;
+        t = std::min(std::max(t, 0.0f), top);
+        positions[i] = (uint8_t)(int)(t + 0.5f);
+    }
+}
+
+static void BcRefitScalar(const BcBlock &b, const uint8_t positions[16], uint32_t levels, BcRefitSums &s) {
+    s = {};
+    float top = (float)(levels - 1);
+    for (uint32_t i = 0; i < 16; ++i) {
+        float k = positions[i];
+        float a = top - k;
+        s.aa += a * a;
+        s.ab += a * k;
+        s.bb += k * k;
+        for (uint32_t c = 0; c < 4; ++c) {
+            s.ap[c] += a * b.c[c][i];
+            s.bp[c] += k * b.c[c][i];
+        }
+    }
+}
+
+static const BcKernels bcKernelsScalar = { BcMomentsScalar, BcAxisRangeScalar, BcAssignScalar, BcRefitScalar };
+
+// AVX2: the 16 pixels are two registers per channel. The horizontal sums
+// only add integers below 2^24, exact in any order, so they match the
+// scalar loops bit for bit.
+// ---------------------------
+SIMD_TARGET_AVX2
+static inline float BcHsumAvx2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+SIMD_TARGET_AVX2
+static void BcMomentsAvx2(const BcBlock &b, float sums[4], float products[10]) {
+    __m256 lo[4], hi[4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        lo[c] = _mm256_load_ps(b.c[c]);
+        hi[c] = _mm256_load_ps(b.c[c] + 8);
+    }
+    uint32_t n = 0;
+    for (uint32_t c0 = 0; c0 < 4; ++c0) {
+        sums[c0] = BcHsumAvx2(_mm256_add_ps(lo[c0], hi[c0]));
+        for (uint32_t c1 = c0; c1 < 4; ++c1) {
+            products[n++] = BcHsumAvx2(_mm256_add_ps(_mm256_mul_ps(lo[c0], lo[c1]), _mm256_mul_ps(hi[c0], hi[c1])));
+        }
+    }
+}
+
+// Dot product of every pixel minus `origin` with `d`, in the scalar order
+SIMD_TARGET_AVX2
+static inline __m256 BcDotAvx2(const BcBlock &b, uint32_t first, const float origin[4], const float d[4]) {
+    __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.c[0] + first), _mm256_set1_ps(origin[0])), _mm256_set1_ps(d[0]));
+    for (uint32_t c = 1; c < 4; ++c) {
+        __m256 term = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b.c[c] + first), _mm256_set1_ps(origin[c])), _mm256_set1_ps(d[c]));
+        t = _mm256_add_ps(t, term);
+    }
+    return t;
+}
+
+SIMD_TARGET_AVX2
+static void BcAxisRangeAvx2(const BcBlock &b, const float origin[4], const float axis[4], float &tMin, float &tMax) {
+    __m256 t0 = BcDotAvx2(b, 0, origin, axis);
+    __m256 t1 = BcDotAvx2(b, 8, origin, axis);
+    __m256 low = _mm256_min_ps(t0, t1);
+    __m256 high = _mm256_max_ps(t0, t1);
+    __m128 l = _mm_min_ps(_mm256_castps256_ps128(low), _mm256_extractf128_ps(low, 1));
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(high), _mm256_extractf128_ps(high, 1));
+    l = _mm_min_ps(l, _mm_movehl_ps(l, l));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    tMin = _mm_cvtss_f32(_mm_min_ss(l, _mm_shuffle_ps(l, l, 1)));
+    tMax = _mm_cvtss_f32(_mm_max_ss(h, _mm_shuffle_ps(h, h, 1)));
+}
+
+SIMD_TARGET_AVX2
+static void BcAssignAvx2(const BcBlock &b, const float e0[4], const float e1[4], uint32_t levels, uint8_t positions[16]) {
+    float d[4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        d[c] = e1[c] - e0[c];
+    }
+    float length2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] + d[3] * d[3];
+    float top = (float)(levels - 1);
+    __m256 scale = _mm256_set1_ps(length2 > 0.0f ? top / length2 : 0.0f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 topV = _mm256_set1_ps(top);
+    __m256 half = _mm256_set1_ps(0.5f);
+    alignas(32) int32_t rounded[16];
+    for (uint32_t first = 0; first < 16; first += 8) {
+        __m256 t = _mm256_mul_ps(BcDotAvx2(b, first, e0, d), scale);
+        t = _mm256_min_ps(_mm256_max_ps(t, zero), topV);
+        _mm256_store_si256((__m256i *)(rounded + first), _mm256_cvttps_epi32(_mm256_add_ps(t, half)));
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        positions[i] = (uint8_t)rounded[i];
+    }
+}
+
+SIMD_TARGET_AVX2
+static void BcRefitAvx2(const BcBlock &b, const uint8_t positions[16], uint32_t levels, BcRefitSums &s) {
+    __m256 top = _mm256_set1_ps((float)(levels - 1));
+    __m256 k[2], a[2];
+    for (uint32_t half = 0; half < 2; ++half) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)(positions + half * 8));
+        k[half] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        a[half] = _mm256_sub_ps(top, k[half]);
+    }
+    s.aa = BcHsumAvx2(_mm256_add_ps(_mm256_mul_ps(a[0], a[0]), _mm256_mul_ps(a[1], a[1])));
+    s.ab = BcHsumAvx2(_mm256_add_ps(_mm256_mul_ps(a[0], k[0]), _mm256_mul_ps(a[1], k[1])));
+    s.bb = BcHsumAvx2(_mm256_add_ps(_mm256_mul_ps(k[0], k[0]), _mm256_mul_ps(k[1], k[1])));
+    for (uint32_t c = 0; c < 4; ++c) {
+        __m256 lo = _mm256_load_ps(b.c[c]);
+        __m256 hi = _mm256_load_ps(b.c[c] + 8);
+        s.ap[c] = BcHsumAvx2(_mm256_add_ps(_mm256_mul_ps(a[0], lo), _mm256_mul_ps(a[1], hi)));
+        s.bp[c] = BcHsumAvx2(_mm256_add_ps(_mm256_mul_ps(k[0], lo), _mm256_mul_ps(k[1], hi)));
+    }
+}
+
+static const BcKernels bcKernelsAvx2 = { BcMomentsAvx2, BcAxisRangeAvx2, BcAssignAvx2, BcRefitAvx2 };
+
+// Endpoint fitting
+// ---------------------------
+static float BcClamp255(float v) {
+    return std::min(std::max(v, 0.0f), 255.0f);
+}
+
+// Mean and unit principal axis of the first `channels` channels, the axis
+// is zero for a flat block
+static void BcPrincipalAxis(const float sums[4], const float products[10], uint32_t channels, float mean[4], float axis[4]) {
+    float covariance[4][4] = {};
+    for (uint32_t c = 0; c < 4; ++c) {
+        mean[c] = sums[c] / 16.0f;
+    }
+    uint32_t n = 0;
+    for (uint32_t c0 = 0; c0 < 4; ++c0) {
+        for (uint32_t c1 = c0; c1 < 4; ++c1) {
+            float value = products[n++] / 16.0f - mean[c0] * mean[c1];
+            if (c0 < channels && c1 < channels) {
+                covariance[c0][c1] = value;
+                covariance[c1][c0] = value;
+            }
+        }
+    }
+
+    // Power iteration, starting from the column of the largest variance so
+    // the start is never orthogonal to the answer
+    uint32_t start = 0;
+    for (uint32_t c = 1; c < 4; ++c) {
+        if (covariance[c][c] > covariance[start][start]) {
+            start = c;
+        }
+    }
+    std::fill(axis, axis + 4, 0.0f);
+    if (covariance[start][start] < 1.0e-3f) {
+        return;
+    }
+    float v[4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        v[c] = covariance[c][start];
+    }
+    for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+        float w[4];
+        float largest = 0.0f;
+        for (uint32_t r = 0; r < 4; ++r) {
+            w[r] = covariance[r][0] * v[0] + covariance[r][1] * v[1] + covariance[r][2] * v[2] + covariance[r][3] * v[3];
+            largest = std::max(largest, std::fabs(w[r]));
+        }
+        if (largest == 0.0f) {
+            return;
+        }
+        for (uint32_t r = 0; r < 4; ++r) {
+            v[r] = w[r] / largest;
+        }
+    }
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2] + v[3] * v[3]);
+    for (uint32_t c = 0; c < 4; ++c) {
+        axis[c] = v[c] / length;
+    }
+}
+
+static void BcAxisEndpoints(const BcBlock &b, const BcKernels &k, uint32_t channels, float e0[4], float e1[4]) {
+    float sums[4], products[10], mean[4], axis[4];
+    k.moments(b, sums, products);
+    BcPrincipalAxis(sums, products, channels, mean, axis);
+    float tMin = 0.0f, tMax = 0.0f;
+    if (axis[0] != 0.0f || axis[1] != 0.0f || axis[2] != 0.0f || axis[3] != 0.0f) {
+        k.axisRange(b, mean, axis, tMin, tMax);
+    }
+    for (uint32_t c = 0; c < 4; ++c) {
+        e0[c] = BcClamp255(mean[c] + tMin * axis[c]);
+        e1[c] = BcClamp255(mean[c] + tMax * axis[c]);
+    }
+}
+
+// Endpoints that best fit the pixels for the given positions; false when
+// every pixel sits on the same position
+static bool BcRefitSolve(const BcRefitSums &s, uint32_t levels, float e0[4], float e1[4]) {
+    float det = s.aa * s.bb - s.ab * s.ab;
+    if (det == 0.0f) {
+        return false;
+    }
+    float scale = (float)(levels - 1) / det;
+    for (uint32_t c = 0; c < 4; ++c) {
+        e0[c] = BcClamp255((s.bb * s.ap[c] - s.ab * s.bp[c]) * scale);
+        e1[c] = BcClamp255((s.aa * s.bp[c] - s.ab * s.ap[c]) * scale);
+    }
+    return true;
+}
+
+// 128 bit little endian bit stream, as BC7 blocks are laid out
+// ---------------------------
+struct BcBits {
+    uint64_t lo;
+    uint64_t hi;
+    uint32_t position;
+};
+
+static void BcBitsPut(BcBits &bits, uint32_t value, uint32_t count) {
+    if (bits.position >= 64) {
+        bits.hi |= (uint64_t)value << (bits.position - 64);
+    } else {
+        bits.lo |= (uint64_t)value << bits.position;
+        if (bits.position + count > 64) {
+            bits.hi |= (uint64_t)value >> (64 - bits.position);
+        }
+    }
+    bits.position += count;
+}
+
+static uint32_t BcBitsGet(BcBits &bits, uint32_t count) {
+    uint64_t value;
+    if (bits.position >= 64) {
+        value = bits.hi >> (bits.position - 64);
+    } else {
+        value = bits.lo >> bits.position;
+        if (bits.position + count > 64) {
+            value |= bits.hi << (64 - bits.position);
+        }
+    }
+    bits.position += count;
+    return (uint32_t)(value & ((1u << count) - 1));
+}
+
+static void BcStore(uint8_t *out, uint64_t value, uint32_t bytes) {
+    for (uint32_t i = 0; i < bytes; ++i) {
+        out[i] = (uint8_t)(value >> (i * 8));
+    }
+}
+
+static uint64_t BcLoad(const uint8_t *in, uint32_t bytes) {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < bytes; ++i) {
+        value |= (uint64_t)in[i] << (i * 8);
+    }
+    return value;
+}
+
+// Block encoders
+// ---------------------------
+static uint16_t BcPack565(const float c[4], float expanded[4]) {
+    uint32_t r = (uint32_t)(c[0] * (31.0f / 255.0f) + 0.5f);
+    uint32_t g = (uint32_t)(c[1] * (63.0f / 255.0f) + 0.5f);
+    uint32_t b = (uint32_t)(c[2] * (31.0f / 255.0f) + 0.5f);
+    expanded[0] = (float)((r << 3) | (r >> 2));
+    expanded[1] = (float)((g << 2) | (g >> 4));
+    expanded[2] = (float)((b << 3) | (b >> 2));
+    expanded[3] = 0.0f; // keeps alpha out of the index search
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// BC1 color block, always in four color mode
+static void BcEncodeColorBlock(const BcBlock &b, const BcKernels &k, uint8_t out[8]) {
+    float e0[4], e1[4];
+    BcAxisEndpoints(b, k, 3, e0, e1);
+
+    uint8_t positions[16];
+    uint16_t c0 = 0, c1 = 0;
+    for (uint32_t round = 0; round < 2; ++round) {
+        float q0[4], q1[4];
+        c0 = BcPack565(e0, q0);
+        c1 = BcPack565(e1, q1);
+        k.assign(b, q0, q1, 4, positions);
+        if (round == 0) {
+            BcRefitSums s;
+            k.refit(b, positions, 4, s);
+            BcRefitSolve(s, 4, e0, e1);
+        }
+    }
+
+    // Four color mode needs c0 > c1; equal endpoints decode index 0 as
+    // that color in either mode
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (uint32_t i = 0; i < 16; ++i) {
+            positions[i] = (uint8_t)(3 - positions[i]);
+        }
+    }
+    static const uint8_t indexOf[4] = { 0, 2, 3, 1 };
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        indices |= (uint32_t)(c0 == c1 ? 0 : indexOf[positions[i]]) << (i * 2);
+    }
+    BcStore(out, c0, 2);
+    BcStore(out + 2, c1, 2);
+    BcStore(out + 4, indices, 4);
+}
+
+// BC3 alpha block, eight value mode from the block's own min and max
+static void BcEncodeAlphaBlock(const BcBlock &b, const BcKernels &k, uint8_t out[8]) {
+    const float origin[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float alphaAxis[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float low, high;
+    k.axisRange(b, origin, alphaAxis, low, high);
+
+    const float e0[4] = { 0.0f, 0.0f, 0.0f, high };
+    const float e1[4] = { 0.0f, 0.0f, 0.0f, low };
+    uint8_t positions[16];
+    k.assign(b, e0, e1, 8, positions);
+
+    static const uint8_t indexOf[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+    uint64_t indices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        indices |= (uint64_t)(high == low ? 0 : indexOf[positions[i]]) << (i * 3);
+    }
+    out[0] = (uint8_t)high;
+    out[1] = (uint8_t)low;
+    BcStore(out + 2, indices, 6);
+}
+
+// 7 bit endpoint plus the shared low bit, whichever bit lands closer
+static void BcQuantize7(const float e[4], uint8_t q[4], uint32_t &pbit, float expanded[4]) {
+    float bestError = FLT_MAX;
+    for (uint32_t p = 0; p < 2; ++p) {
+        uint8_t candidate[4];
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 4; ++c) {
+            int v = std::min((int)((e[c] - (float)p) * 0.5f + 0.5f), 127);
+            candidate[c] = (uint8_t)std::max(v, 0);
+            float d = (float)(candidate[c] * 2 + p) - e[c];
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pbit = p;
+            std::copy(candidate, candidate + 4, q);
+        }
+    }
+    for (uint32_t c = 0; c < 4; ++c) {
+        expanded[c] = (float)(q[c] * 2 + pbit);
+    }
+}
+
+static void BcEncodeBc7Block(const BcBlock &b, const BcKernels &k, uint8_t out[16]) {
+    float e0[4], e1[4];
+    BcAxisEndpoints(b, k, 4, e0, e1);
+
+    uint8_t positions[16], q0[4], q1[4];
+    uint32_t p0 = 0, p1 = 0;
+    for (uint32_t round = 0; round < 2; ++round) {
+        float f0[4], f1[4];
+        BcQuantize7(e0, q0, p0, f0);
+        BcQuantize7(e1, q1, p1, f1);
+        k.assign(b, f0, f1, 16, positions);
+        if (round == 0) {
+            BcRefitSums s;
+            k.refit(b, positions, 16, s);
+            BcRefitSolve(s, 16, e0, e1);
+        }
+    }
+
+    // The first index is stored without its top bit, which must be zero
+    if (positions[0] >= 8) {
+        std::swap_ranges(q0, q0 + 4, q1);
+        std::swap(p0, p1);
+        for (uint32_t i = 0; i < 16; ++i) {
+            positions[i] = (uint8_t)(15 - positions[i]);
+        }
+    }
+
+    BcBits bits{};
+    BcBitsPut(bits, 1u << 6, 7); // mode 6
+    for (uint32_t c = 0; c < 4; ++c) {
+        BcBitsPut(bits, q0[c], 7);
+        BcBitsPut(bits, q1[c], 7);
+    }
+    BcBitsPut(bits, p0, 1);
+    BcBitsPut(bits, p1, 1);
+    BcBitsPut(bits, positions[0], 3);
+    for (uint32_t i = 1; i < 16; ++i) {
+        BcBitsPut(bits, positions[i], 4);
+    }
+    BcStore(out, bits.lo, 8);
+    BcStore(out + 8, bits.hi, 8);
+}
+
+void BcEncode(BcFormat f, const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t channels,
+              uint8_t *blocks, JobPool *pool, BcPath path) {
+    if (path == BC_PATH_AUTO) {
+        path = BcBestPath();
+    }
+    const BcKernels &k = path == BC_PATH_AVX2 ? bcKernelsAvx2 : bcKernelsScalar;
+    uint32_t blocksX = (width + BC_BLOCK_DIM - 1) / BC_BLOCK_DIM;
+    uint32_t blocksY = (height + BC_BLOCK_DIM - 1) / BC_BLOCK_DIM;
+    uint32_t blockBytes = BcBlockBytes(f);
+
+    auto encodeRow = [&](uint32_t blockY) {
+        uint8_t *out = blocks + (size_t)blockY * blocksX * blockBytes;
+        BcBlock b;
+        for (uint32_t blockX = 0; blockX < blocksX; ++blockX, out += blockBytes) {
+            BcFetchBlock(pixels, width, height, channels, blockX, blockY, b);
+            if (f == BC_FORMAT_BC1) {
+                BcEncodeColorBlock(b, k, out);
+            } else if (f == BC_FORMAT_BC3) {
+                BcEncodeAlphaBlock(b, k, out);
+                BcEncodeColorBlock(b, k, out + 8);
+            } else {
+                BcEncodeBc7Block(b, k, out);
+            }
+        }
+    };
+    if (pool) {
+        JobPoolParallelFor(*pool, blocksY, encodeRow);
+    } else {
+        for (uint32_t blockY = 0; blockY < blocksY; ++blockY) {
+            encodeRow(blockY);
+        }
+    }
+}
+
+// Block decoders
+// ---------------------------
+static void BcDecodeColorBlock(const uint8_t *in, bool fourColorOnly, uint8_t out[16][4]) {
+    uint32_t c0 = (uint32_t)BcLoad(in, 2);
+    uint32_t c1 = (uint32_t)BcLoad(in + 2, 2);
+    uint32_t indices = (uint32_t)BcLoad(in + 4, 4);
+
+    uint8_t palette[4][4];
+    const uint32_t colors[2] = { c0, c1 };
+    for (uint32_t e = 0; e < 2; ++e) {
+        uint32_t r = colors[e] >> 11, g = (colors[e] >> 5) & 63, b = colors[e] & 31;
+        palette[e][0] = (uint8_t)((r << 3) | (r >> 2));
+        palette[e][1] = (uint8_t)((g << 2) | (g >> 4));
+        palette[e][2] = (uint8_t)((b << 3) | (b >> 2));
+        palette[e][3] = 255;
+    }
+    for (uint32_t c = 0; c < 3; ++c) {
+        if (c0 > c1 || fourColorOnly) {
+            palette[2][c] = (uint8_t)((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = (uint8_t)((palette[0][c] + 2 * palette[1][c]) / 3);
+        } else {
+            palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = (c0 > c1 || fourColorOnly) ? 255 : 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        std::copy(palette[(indices >> (i * 2)) & 3], palette[(indices >> (i * 2)) & 3] + 4, out[i]);
+    }
+}
+
+static void BcDecodeAlphaBlock(const uint8_t *in, uint8_t out[16][4]) {
+    uint32_t a0 = in[0], a1 = in[1];
+    uint64_t indices = BcLoad(in + 2, 6);
+    uint8_t palette[8] = { (uint8_t)a0, (uint8_t)a1 };
+    if (a0 > a1) {
+        for (uint32_t k = 2; k < 8; ++k) {
+            palette[k] = (uint8_t)(((8 - k) * a0 + (k - 1) * a1) / 7);
+        }
+    } else {
+        for (uint32_t k = 2; k < 6; ++k) {
+            palette[k] = (uint8_t)(((6 - k) * a0 + (k - 1) * a1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        out[i][3] = palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+static void BcDecodeBc7Block(const uint8_t *in, uint8_t out[16][4]) {
+    static const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    BcBits bits{ BcLoad(in, 8), BcLoad(in + 8, 8), 0 };
+    if (BcBitsGet(bits, 7) != 1u << 6) {
+        // Another mode, never written by the encoder: show it in magenta
+        for (uint32_t i = 0; i < 16; ++i) {
+            out[i][0] = 255; out[i][1] = 0; out[i][2] = 255; out[i][3] = 255;
+        }
+        return;
+    }
+    uint32_t e[2][4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        e[0][c] = BcBitsGet(bits, 7);
+        e[1][c] = BcBitsGet(bits, 7);
+    }
+    uint32_t p0 = BcBitsGet(bits, 1);
+    uint32_t p1 = BcBitsGet(bits, 1);
+    for (uint32_t c = 0; c < 4; ++c) {
+        e[0][c] = (e[0][c] << 1) | p0;
+        e[1][c] = (e[1][c] << 1) | p1;
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t w = weights[BcBitsGet(bits, i == 0 ? 3 : 4)];
+        for (uint32_t c = 0; c < 4; ++c) {
+            out[i][c] = (uint8_t)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+        }
+    }
+}
+
+void BcDecode(BcFormat f, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba) {
+    uint32_t blocksX = (width + BC_BLOCK_DIM - 1) / BC_BLOCK_DIM;
+    uint32_t blocksY = (height + BC_BLOCK_DIM - 1) / BC_BLOCK_DIM;
+    uint32_t blockBytes = BcBlockBytes(f);
+    for (uint32_t blockY = 0; blockY < blocksY; ++blockY) {
+        for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+            const uint8_t *in = blocks + ((size_t)blockY * blocksX + blockX) * blockBytes;
+            uint8_t texels[16][4];
+            if (f == BC_FORMAT_BC1) {
+                BcDecodeColorBlock(in, false, texels);
+            } else if (f == BC_FORMAT_BC3) {
+                BcDecodeColorBlock(in + 8, true, texels);
+                BcDecodeAlphaBlock(in, texels);
+            } else {
+                BcDecodeBc7Block(in, texels);
+            }
+            for (uint32_t i = 0; i < 16; ++i) {
+                uint32_t x = blockX * BC_BLOCK_DIM + (i & 3);
+                uint32_t y = blockY * BC_BLOCK_DIM + (i >> 2);
+                if (x < width && y < height) {
+                    std::copy(texels[i], texels[i] + 4, rgba + ((size_t)y * width + x) * 4);
+                }
+            }
+        }
+    }
+}
+
+// GL
+// ---------------------------
+uint32_t BcGLInternalFormat(BcFormat f) {
+    switch (f) {
+    case BC_FORMAT_BC1: return BC_GL_COMPRESSED_RGB_S3TC_DXT1;
+    case BC_FORMAT_BC3: return BC_GL_COMPRESSED_RGBA_S3TC_DXT5;
+    case BC_FORMAT_BC7: return BC_GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return GL_RGBA8;
+    }
+}
+
+bool BcGLSupported(BcFormat f) {
+    if (f == BC_FORMAT_NONE) {
+        return true;
+    }
+    // BPTC is core from 4.2, S3TC has only ever been an extension
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (f == BC_FORMAT_BC7 && (major > 4 || (major == 4 && minor >= 2))) {
+        return true;
+    }
+    const char *wanted = f == BC_FORMAT_BC7 ? "GL_ARB_texture_compression_bptc" : "GL_EXT_texture_compression_s3tc";
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (name && strcmp(name, wanted) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Benchmark
+// ---------------------------
+// Over RGB, plus alpha when the format keeps it and the source has it
+static double BcPsnr(const uint8_t *pixels, uint32_t channels, const uint8_t *rgba, size_t count, uint32_t compared) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t source[4];
+        BcSourcePixel(pixels + i * channels, channels, source);
+        for (uint32_t c = 0; c < compared; ++c) {
+            double d = (double)source[c] - (double)rgba[i * 4 + c];
+            sum += d * d;
+        }
+    }
+    double mse = sum / (double)(count * compared);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+void BcBenchmark(JobPool &pool) {
+    const char *paths[] = { "./assets/container2.png", "./assets/container2_specular.png", "./assets/awesomeface.png" };
+    const BcFormat formats[] = { BC_FORMAT_BC1, BC_FORMAT_BC3, BC_FORMAT_BC7 };
+    const uint32_t iterations = 5;
+    const CpuFeatures &cpu = CpuGetFeatures();
+
+    for (const char *path : paths) {
+        int width, height, channels;
+        uint8_t *pixels = stbi_load(path, &width, &height, &channels, 0);
+        if (!pixels) {
+            std::cerr << "Cannot load " << path << " : " << stbi_failure_reason() << std::endl;
+            continue;
+        }
+        uint32_t w = (uint32_t)width, h = (uint32_t)height, ch = (uint32_t)channels;
+        double megapixels = (double)w * h * 1.0e-6;
+        std::cout << "bc " << path << " " << w << "x" << h << "x" << ch << std::endl;
+
+        std::vector<uint8_t> decoded((size_t)w * h * 4);
+        for (BcFormat f : formats) {
+            uint64_t size = BcImageSize(f, w, h);
+            std::vector<uint8_t> reference(size), blocks(size);
+            BcEncode(f, pixels, w, h, ch, reference.data(), nullptr, BC_PATH_SCALAR);
+            BcDecode(f, reference.data(), w, h, decoded.data());
+            uint32_t compared = (ch == 4 || ch == 2) && f != BC_FORMAT_BC1 ? 4 : 3;
+            std::cout << "bc " << BcFormatName(f) << ": " << size << " bytes (" << (double)w * h * ch / (double)size
+                      << ":1), PSNR " << BcPsnr(pixels, ch, decoded.data(), (size_t)w * h, compared) << " dB"
+                      << (compared == 4 ? " rgba" : " rgb") << std::endl;
+
+            const BcPath benchPaths[] = { BC_PATH_SCALAR, BC_PATH_AVX2 };
+            for (BcPath path : benchPaths) {
+                if (path == BC_PATH_AVX2 && !cpu.avx2) {
+                    continue;
+                }
+                for (int threaded = 0; threaded < 2; ++threaded) {
+                    double best = 1e30;
+                    for (uint32_t it = 0; it < iterations; ++it) {
+                        auto start = std::chrono::steady_clock::now();
+                        BcEncode(f, pixels, w, h, ch, blocks.data(), threaded ? &pool : nullptr, path);
+                        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                    }
+                    std::cout << "bc " << BcFormatName(f) << " " << BcPathName(path) << (threaded ? " pool:   " : " single: ")
+                              << best << " ms, " << megapixels / (best * 1.0e-3) << " MP/s"
+                              << (blocks == reference ? "" : ", MISMATCH vs scalar") << std::endl;
+                }
+            }
+        }
+        stbi_image_free(pixels);
+    }
+}
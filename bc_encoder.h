@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include "jobs.h"
+
+// Block compression
+// Encodes 8 bit images into the 4x4 block formats desktop GPUs sample
+// natively, so textures take a fraction of the memory and bandwidth:
+//   BC1  8 bytes a block, RGB (4 bits a pixel)
+//   BC3  16 bytes, BC1 color plus an interpolated 8 bit alpha block
+//   BC7  16 bytes, RGBA; only mode 6 is written (one subset, 7 bit
+//        endpoints plus a shared bit, 16 index levels)
+// Endpoints start at the ends of the block's principal axis and get one
+// least squares refit over the chosen indices. The per pixel loops have an
+// AVX2 path over all 16 pixels at once; their reductions only ever add
+// integers small enough to be exact in floats, so both paths write the
+// same bytes. Block rows are spread over the job pool.
+// The decoder is for drivers without the formats and for measuring
+// quality, and only understands what the encoder writes.
+// -------------------------------------
+#define BC_BLOCK_DIM 4
+
+enum BcFormat {
+    BC_FORMAT_NONE, // uncompressed
+    BC_FORMAT_BC1,
+    BC_FORMAT_BC3,
+    BC_FORMAT_BC7,
+    BC_FORMAT_AUTO  // cooking only: BC1 for RGB, BC7 for RGBA, none otherwise
+};
+
+enum BcPath {
+    BC_PATH_SCALAR,
+    BC_PATH_AVX2,
+    BC_PATH_AUTO
+};
+
+const char *BcFormatName(BcFormat f);
+// "none", "bc1", "bc3", "bc7" or "auto"
+bool BcFormatParse(const char *name, BcFormat &f);
+const char *BcPathName(BcPath path);
+
+uint32_t BcBlockBytes(BcFormat f);
+uint64_t BcImageSize(BcFormat f, uint32_t width, uint32_t height);
+
+// `pixels` holds width * height pixels of 1-4 channels. One and two channel
+// images are read as grey (and alpha), missing alpha is opaque. Partial
+// blocks at the right and bottom edge repeat the last column and row.
+void BcEncode(BcFormat f, const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t channels,
+              uint8_t *blocks, JobPool *pool, BcPath path = BC_PATH_AUTO);
+// Writes width * height RGBA8 pixels
+void BcDecode(BcFormat f, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba);
+
+// GL internal format of `f`
+uint32_t BcGLInternalFormat(BcFormat f);
+// Whether the current context can sample `f`, from its extensions and
+// version. Needs a current GL context.
+bool BcGLSupported(BcFormat f);
+
+// Megapixels per second and PSNR of every format and path on the assets
+void BcBenchmark(JobPool &pool);
@@ -1,6 +1,10 @@
 @echo off
 
-cl /c /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glm-1.0.2" /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glfw-3.4.bin.WIN64\include" /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glad\include" /ZI /JMC /nologo /W3 /WX- /diagnostics:column /sdl /Od /D _DEBUG /D _CONSOLE /D _UNICODE /D UNICODE /Gm- /EHsc /RTC1 /MDd /GS /fp:precise /Zc:wchar_t /Zc:forScope /Zc:inline /std:c++20 /permissive- /Fo"LearnOpenGL\x64\Debug\\" /Fd"LearnOpenGL\x64\Debug\vc145.pdb" /external:W3 /Gd /TP /FC /errorReport:prompt main.cpp
+REM "build.bat nullgl" builds against the null GL driver (see null_gl.h)
+set DEFINES=
+IF "%1"=="nullgl" set DEFINES=/D LEARNOPENGL_NULL_GL
+
+cl /c /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glm-1.0.2" /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glfw-3.4.bin.WIN64\include" /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glad\include" /ZI /JMC /nologo /W3 /WX- /diagnostics:column /sdl /Od /D _DEBUG /D _CONSOLE %DEFINES% /D _UNICODE /D UNICODE /Gm- /EHsc /RTC1 /MDd /GS /fp:precise /Zc:wchar_t /Zc:forScope /Zc:inline /std:c++20 /permissive- /Fo"LearnOpenGL\x64\Debug\\" /Fd"LearnOpenGL\x64\Debug\vc145.pdb" /external:W3 /Gd /TP /FC /errorReport:prompt main.cpp culling.cpp jobs.cpp texture_streamer.cpp cooked_texture.cpp mapped_file.cpp null_gl.cpp scene.cpp swr.cpp gl_state.cpp render_queue.cpp transforms.cpp occlusion.cpp bvh.cpp light_clusters.cpp deferred.cpp profiler.cpp frame_clock.cpp bc_encoder.cpp material_pack.cpp sampler_cache.cpp image_cache.cpp png_decode.cpp
 
 REM cl /c /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glm-1.0.2" /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glfw-3.4.bin.WIN64\include" /I"C:\Users\agusw\Documents\Visual Studio\Libraries\glad\include" /ZI /JMC /nologo /W3 /WX- /diagnostics:column /sdl /Od /D _DEBUG /D _CONSOLE /D _UNICODE /D UNICODE /Gm- /EHsc /RTC1 /MDd /GS /fp:precise /Zc:wchar_t /Zc:forScope /Zc:inline /std:c++20 /permissive- /Fo"LearnOpenGL\x64\Debug\\" /Fd"LearnOpenGL\x64\Debug\vc145.pdb" /external:W3 /Gd /TP /FC /errorReport:prompt glad.cpp
 
@@ -9,7 +13,7 @@ IF ERRORLEVEL 1 (
     exit /b 1
 )
 
-link /ERRORREPORT:PROMPT /OUT:"C:\Users\agusw\Desktop\Projects\LearnOpenGL\x64\Debug\LearnOpenGL.exe" /INCREMENTAL /ILK:"LearnOpenGL\x64\Debug\LearnOpenGL.ilk" /NOLOGO /LIBPATH:"C:\Users\agusw\Documents\Visual Studio\Libraries\glm-1.0.2" /LIBPATH:"C:\Users\agusw\Documents\Visual Studio\Libraries\glfw-3.4.bin.WIN64\lib-vc2015" opengl32.lib glfw3.lib kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /MANIFEST /MANIFESTUAC:"level='asInvoker' uiAccess='false'" /manifest:embed /DEBUG /PDB:"C:\Users\agusw\Desktop\Projects\LearnOpenGL\x64\Debug\LearnOpenGL.pdb" /SUBSYSTEM:CONSOLE /TLBID:1 /DYNAMICBASE /NXCOMPAT /IMPLIB:"C:\Users\agusw\Desktop\Projects\LearnOpenGL\x64\Debug\LearnOpenGL.lib" /MACHINE:X64 LearnOpenGL\x64\Debug\main.obj LearnOpenGL\x64\Debug\glad.obj
+link /ERRORREPORT:PROMPT /OUT:"C:\Users\agusw\Desktop\Projects\LearnOpenGL\x64\Debug\LearnOpenGL.exe" /INCREMENTAL /ILK:"LearnOpenGL\x64\Debug\LearnOpenGL.ilk" /NOLOGO /LIBPATH:"C:\Users\agusw\Documents\Visual Studio\Libraries\glm-1.0.2" /LIBPATH:"C:\Users\agusw\Documents\Visual Studio\Libraries\glfw-3.4.bin.WIN64\lib-vc2015" opengl32.lib glfw3.lib kernel32.lib user32.lib gdi32.lib winspool.lib comdlg32.lib advapi32.lib shell32.lib ole32.lib oleaut32.lib uuid.lib odbc32.lib odbccp32.lib /MANIFEST /MANIFESTUAC:"level='asInvoker' uiAccess='false'" /manifest:embed /DEBUG /PDB:"C:\Users\agusw\Desktop\Projects\LearnOpenGL\x64\Debug\LearnOpenGL.pdb" /SUBSYSTEM:CONSOLE /TLBID:1 /DYNAMICBASE /NXCOMPAT /IMPLIB:"C:\Users\agusw\Desktop\Projects\LearnOpenGL\x64\Debug\LearnOpenGL.lib" /MACHINE:X64 LearnOpenGL\x64\Debug\main.obj LearnOpenGL\x64\Debug\culling.obj LearnOpenGL\x64\Debug\jobs.obj LearnOpenGL\x64\Debug\texture_streamer.obj LearnOpenGL\x64\Debug\cooked_texture.obj LearnOpenGL\x64\Debug\mapped_file.obj LearnOpenGL\x64\Debug\null_gl.obj LearnOpenGL\x64\Debug\scene.obj LearnOpenGL\x64\Debug\swr.obj LearnOpenGL\x64\Debug\gl_state.obj LearnOpenGL\x64\Debug\render_queue.obj LearnOpenGL\x64\Debug\transforms.obj LearnOpenGL\x64\Debug\occlusion.obj LearnOpenGL\x64\Debug\bvh.obj LearnOpenGL\x64\Debug\light_clusters.obj LearnOpenGL\x64\Debug\deferred.obj LearnOpenGL\x64\Debug\profiler.obj LearnOpenGL\x64\Debug\frame_clock.obj LearnOpenGL\x64\Debug\bc_encoder.obj LearnOpenGL\x64\Debug\material_pack.obj LearnOpenGL\x64\Debug\sampler_cache.obj LearnOpenGL\x64\Debug\image_cache.obj LearnOpenGL\x64\Debug\png_decode.obj LearnOpenGL\x64\Debug\glad.obj
 
 IF ERRORLEVEL 1 (
     echo Linking failed
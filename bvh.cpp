@@ -0,0 +1,506 @@
+#include "bvh.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+static float BvhArea(glm::vec3 min, glm::vec3 max) {
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// Build
+// ---------------------------
+// Spheres are copied into one array that gets partitioned in place, so
+// every pass over a node reads contiguous memory
+struct BvhPrimitive {
+    glm::vec3 center;
+    float radius;
+    uint32_t object;
+};
+
+struct BvhBin {
+    glm::vec3 min;
+    glm::vec3 max;
+    uint32_t count;
+};
+
+static uint32_t BvhBinIndex(float centroid, float origin, float scale) {
+    int32_t bin = (int32_t)((centroid - origin) * scale);
+    return (uint32_t)std::min(std::max(bin, 0), BVH_SAH_BINS - 1);
+}
+
+void BvhBuild(Bvh &bvh, const CullSpheres &spheres) {
+    const uint32_t count = CullSpheresCount(spheres);
+    std::vector<BvhPrimitive> primitives(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        primitives[i].center = glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+        primitives[i].radius = spheres.radius[i];
+        primitives[i].object = i;
+    }
+    bvh.nodes.clear();
+    bvh.nodes.reserve(2 * (count / BVH_LEAF_SIZE) + 1);
+
+    BvhNode root{};
+    root.count = count;
+    bvh.nodes.push_back(root);
+
+    // Nodes waiting for their split, with their depth so the query stacks
+    // can never overflow
+    std::vector<std::pair<uint32_t, uint32_t>> pending;
+    if (count > 0) {
+        pending.push_back({ 0, 0 });
+    }
+    while (!pending.empty()) {
+        uint32_t nodeIndex = pending.back().first;
+        uint32_t depth = pending.back().second;
+        pending.pop_back();
+
+        const uint32_t first = bvh.nodes[nodeIndex].first;
+        const uint32_t n = bvh.nodes[nodeIndex].count;
+        BvhPrimitive *begin = primitives.data() + first;
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        glm::vec3 centroidMin(INFINITY), centroidMax(-INFINITY);
+        for (uint32_t i = 0; i < n; ++i) {
+            glm::vec3 r(begin[i].radius);
+            min = glm::min(min, begin[i].center - r);
+            max = glm::max(max, begin[i].center + r);
+            centroidMin = glm::min(centroidMin, begin[i].center);
+            centroidMax = glm::max(centroidMax, begin[i].center);
+        }
+        bvh.nodes[nodeIndex].min = min;
+        bvh.nodes[nodeIndex].max = max;
+        bvh.nodes[nodeIndex].left = 0;
+        if (n <= BVH_LEAF_SIZE || depth + 2 >= BVH_STACK_SIZE) {
+            continue;
+        }
+
+        // Binned SAH on all three axes in one pass, cost counted in sphere
+        // tests with one node visit costing as much as one test
+        float scale[3];
+        BvhBin bins[3][BVH_SAH_BINS];
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            scale[axis] = extent > 1.0e-6f ? (float)BVH_SAH_BINS / extent : 0.0f;
+            for (BvhBin &bin : bins[axis]) {
+                bin.min = glm::vec3(INFINITY);
+                bin.max = glm::vec3(-INFINITY);
+                bin.count = 0;
+            }
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            glm::vec3 r(begin[i].radius);
+            glm::vec3 objectMin = begin[i].center - r;
+            glm::vec3 objectMax = begin[i].center + r;
+            for (int axis = 0; axis < 3; ++axis) {
+                BvhBin &bin = bins[axis][BvhBinIndex(begin[i].center[axis], centroidMin[axis], scale[axis])];
+                bin.min = glm::min(bin.min, objectMin);
+                bin.max = glm::max(bin.max, objectMax);
+                bin.count++;
+            }
+        }
+
+        float bestCost = INFINITY;
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (scale[axis] == 0.0f) {
+                continue;
+            }
+            // Right hand sides first, then sweep the left hand side over them
+            float rightCost[BVH_SAH_BINS];
+            glm::vec3 sweepMin(INFINITY), sweepMax(-INFINITY);
+            uint32_t sweepCount = 0;
+            for (int split = BVH_SAH_BINS - 1; split > 0; --split) {
+                sweepMin = glm::min(sweepMin, bins[axis][split].min);
+                sweepMax = glm::max(sweepMax, bins[axis][split].max);
+                sweepCount += bins[axis][split].count;
+                rightCost[split] = sweepCount ? sweepCount * BvhArea(sweepMin, sweepMax) : INFINITY;
+            }
+            sweepMin = glm::vec3(INFINITY);
+            sweepMax = glm::vec3(-INFINITY);
+            sweepCount = 0;
+            for (int split = 1; split < BVH_SAH_BINS; ++split) {
+                sweepMin = glm::min(sweepMin, bins[axis][split - 1].min);
+                sweepMax = glm::max(sweepMax, bins[axis][split - 1].max);
+                sweepCount += bins[axis][split - 1].count;
+                if (sweepCount == 0 || sweepCount == n) {
+                    continue;
+                }
+                float cost = sweepCount * BvhArea(sweepMin, sweepMax) + rightCost[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = (uint32_t)split;
+                }
+            }
+        }
+
+        uint32_t leftCount;
+        if (bestAxis < 0) {
+            // Every centroid in the same spot, any split is as good
+            if (n <= BVH_MAX_LEAF_SIZE) {
+                continue;
+            }
+            leftCount = n / 2;
+        } else {
+            if (bestCost / BvhArea(min, max) + 1.0f >= (float)n && n <= BVH_MAX_LEAF_SIZE) {
+                continue;
+            }
+            float origin = centroidMin[bestAxis];
+            float axisScale = scale[bestAxis];
+            BvhPrimitive *middle = std::partition(begin, begin + n, [&](const BvhPrimitive &p) {
+                return BvhBinIndex(p.center[bestAxis], origin, axisScale) < bestSplit;
+            });
+            leftCount = (uint32_t)(middle - begin);
+        }
+
+        uint32_t left = (uint32_t)bvh.nodes.size();
+        BvhNode child{};
+        child.first = first;
+        child.count = leftCount;
+        bvh.nodes.push_back(child);
+        child.first = first + leftCount;
+        child.count = n - leftCount;
+        bvh.nodes.push_back(child);
+        bvh.nodes[nodeIndex].left = left;
+        pending.push_back({ left, depth + 1 });
+        pending.push_back({ left + 1, depth + 1 });
+    }
+
+    bvh.objects.resize(count);
+    bvh.spheres.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        bvh.objects[i] = primitives[i].object;
+        bvh.spheres[i] = glm::vec4(primitives[i].center, primitives[i].radius);
+    }
+}
+
+void BvhRefit(Bvh &bvh, const CullSpheres &spheres) {
+    for (size_t i = bvh.nodes.size(); i-- > 0;) {
+        BvhNode &node = bvh.nodes[i];
+        if (node.left != 0) {
+            const BvhNode &a = bvh.nodes[node.left];
+            const BvhNode &b = bvh.nodes[node.left + 1];
+            node.min = glm::min(a.min, b.min);
+            node.max = glm::max(a.max, b.max);
+            continue;
+        }
+        node.min = glm::vec3(INFINITY);
+        node.max = glm::vec3(-INFINITY);
+        for (uint32_t slot = node.first; slot < node.first + node.count; ++slot) {
+            uint32_t o = bvh.objects[slot];
+            glm::vec3 center(spheres.x[o], spheres.y[o], spheres.z[o]);
+            glm::vec3 r(spheres.radius[o]);
+            bvh.spheres[slot] = glm::vec4(center, spheres.radius[o]);
+            node.min = glm::min(node.min, center - r);
+            node.max = glm::max(node.max, center + r);
+        }
+    }
+}
+
+// Queries
+// ---------------------------
+enum BvhOverlap {
+    BVH_OUTSIDE,
+    BVH_PARTIAL,
+    BVH_INSIDE
+};
+
+static BvhOverlap BvhBoxFrustum(const Frustum &f, glm::vec3 min, glm::vec3 max) {
+    glm::vec3 center = (min + max) * 0.5f;
+    glm::vec3 extent = (max - min) * 0.5f;
+    BvhOverlap overlap = BVH_INSIDE;
+    for (int p = 0; p < 6; ++p) {
+        glm::vec3 n(f.planes[p]);
+        float d = glm::dot(n, center) + f.planes[p].w;
+        float r = glm::dot(glm::abs(n), extent);
+        if (d < -r) {
+            return BVH_OUTSIDE;
+        }
+        if (d < r) {
+            overlap = BVH_PARTIAL;
+        }
+    }
+    return overlap;
+}
+
+// Same test as the linear culler, so both agree on every sphere
+static bool BvhSphereFrustum(const Frustum &f, const glm::vec4 &sphere) {
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4 &pl = f.planes[p];
+        if (!(pl.x * sphere.x + pl.y * sphere.y + pl.z * sphere.z + pl.w > -sphere.w)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t BvhQueryFrustum(const Bvh &bvh, const Frustum &f, uint32_t *out) {
+    if (bvh.nodes.empty() || bvh.nodes[0].count == 0) {
+        return 0;
+    }
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t top = 0;
+    uint32_t n = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode &node = bvh.nodes[stack[--top]];
+        BvhOverlap overlap = BvhBoxFrustum(f, node.min, node.max);
+        if (overlap == BVH_OUTSIDE) {
+            continue;
+        }
+        if (overlap == BVH_INSIDE) {
+            memcpy(out + n, bvh.objects.data() + node.first, node.count * sizeof(uint32_t));
+            n += node.count;
+        } else if (node.left == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                out[n] = bvh.objects[i];
+                n += BvhSphereFrustum(f, bvh.spheres[i]) ? 1 : 0;
+            }
+        } else {
+            stack[top++] = node.left + 1;
+            stack[top++] = node.left;
+        }
+    }
+    return n;
+}
+
+uint32_t BvhQuerySphere(const Bvh &bvh, glm::vec3 center, float radius, uint32_t *out) {
+    if (bvh.nodes.empty() || bvh.nodes[0].count == 0) {
+        return 0;
+    }
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t top = 0;
+    uint32_t n = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode &node = bvh.nodes[stack[--top]];
+        glm::vec3 closest = glm::clamp(center, node.min, node.max);
+        glm::vec3 d = closest - center;
+        if (glm::dot(d, d) > radius * radius) {
+            continue;
+        }
+        if (node.left != 0) {
+            stack[top++] = node.left + 1;
+            stack[top++] = node.left;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const glm::vec4 &sphere = bvh.spheres[i];
+            glm::vec3 offset = glm::vec3(sphere) - center;
+            float reach = radius + sphere.w;
+            out[n] = bvh.objects[i];
+            n += glm::dot(offset, offset) <= reach * reach ? 1 : 0;
+        }
+    }
+    return n;
+}
+
+// Entry distance of the ray into the box, or INFINITY when it misses
+// within [0, maxT]
+static float BvhRayBox(glm::vec3 origin, glm::vec3 invDirection, float maxT, glm::vec3 min, glm::vec3 max) {
+    glm::vec3 t0 = (min - origin) * invDirection;
+    glm::vec3 t1 = (max - origin) * invDirection;
+    glm::vec3 near = glm::min(t0, t1);
+    glm::vec3 far = glm::max(t0, t1);
+    float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxT));
+    return enter <= exit ? enter : INFINITY;
+}
+
+bool BvhRaycast(const Bvh &bvh, glm::vec3 origin, glm::vec3 direction, float maxT, BvhRayHit &hit) {
+    if (bvh.nodes.empty() || bvh.nodes[0].count == 0) {
+        return false;
+    }
+    glm::vec3 invDirection = 1.0f / direction;
+    float a = glm::dot(direction, direction);
+    hit.t = maxT;
+    hit.object = UINT32_MAX;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t top = 0;
+    if (BvhRayBox(origin, invDirection, hit.t, bvh.nodes[0].min, bvh.nodes[0].max) < INFINITY) {
+        stack[top++] = 0;
+    }
+    while (top > 0) {
+        const BvhNode &node = bvh.nodes[stack[--top]];
+        if (node.left == 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const glm::vec4 &sphere = bvh.spheres[i];
+                glm::vec3 oc = origin - glm::vec3(sphere);
+                float b = glm::dot(oc, direction);
+                float c = glm::dot(oc, oc) - sphere.w * sphere.w;
+                float discriminant = b * b - a * c;
+                if (discriminant < 0.0f) {
+                    continue;
+                }
+                float root = std::sqrt(discriminant);
+                float t = (-b - root) / a;
+                if (t < 0.0f) {
+                    t = (-b + root) / a; // origin inside the sphere
+                }
+                if (t >= 0.0f && t < hit.t) {
+                    hit.t = t;
+                    hit.object = bvh.objects[i];
+                }
+            }
+            continue;
+        }
+
+        // Nearer child on top so it can shorten the ray for the other one
+        float tLeft = BvhRayBox(origin, invDirection, hit.t, bvh.nodes[node.left].min, bvh.nodes[node.left].max);
+        float tRight = BvhRayBox(origin, invDirection, hit.t, bvh.nodes[node.left + 1].min, bvh.nodes[node.left + 1].max);
+        uint32_t nearChild = tLeft <= tRight ? node.left : node.left + 1;
+        uint32_t farChild = tLeft <= tRight ? node.left + 1 : node.left;
+        if (std::max(tLeft, tRight) < INFINITY) {
+            stack[top++] = farChild;
+        }
+        if (std::min(tLeft, tRight) < INFINITY) {
+            stack[top++] = nearChild;
+        }
+    }
+    return hit.object != UINT32_MAX;
+}
+
+// Benchmark
+// ---------------------------
+static float BvhRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return (float)(state >> 8) / 16777216.0f;
+}
+
+static double BvhElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BvhBenchmark() {
+    const uint32_t counts[] = { 100000, 1000000, 4000000 };
+    for (uint32_t count : counts) {
+        // Constant density, roughly one sphere per 8 cubic units
+        float side = 2.0f * std::cbrt((float)count);
+        uint32_t seed = 1234;
+        CullSpheres spheres;
+        CullSpheresResize(spheres, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            glm::vec3 center((BvhRandom(seed) - 0.5f) * side, (BvhRandom(seed) - 0.5f) * side, (BvhRandom(seed) - 0.5f) * side);
+            CullSpheresSet(spheres, i, center, 0.25f + 0.5f * BvhRandom(seed));
+        }
+
+        Bvh bvh;
+        auto start = std::chrono::steady_clock::now();
+        BvhBuild(bvh, spheres);
+        double buildMs = BvhElapsedMs(start);
+
+        // Nudge everything, then refit instead of rebuilding
+        for (uint32_t i = 0; i < count; ++i) {
+            spheres.x[i] += (BvhRandom(seed) - 0.5f) * 0.5f;
+            spheres.y[i] += (BvhRandom(seed) - 0.5f) * 0.5f;
+            spheres.z[i] += (BvhRandom(seed) - 0.5f) * 0.5f;
+        }
+        start = std::chrono::steady_clock::now();
+        BvhRefit(bvh, spheres);
+        double refitMs = BvhElapsedMs(start);
+        std::cout << "bvh " << count << " spheres: build " << buildMs << " ms (" << bvh.nodes.size() << " nodes), refit "
+                  << refitMs << " ms" << std::endl;
+
+        // Frustum from the center of the cloud, against the linear culler
+        float t = std::tan(glm::radians(45.0f) * 0.5f);
+        float aspect = 800.0f / 600.0f;
+        float nearPlane = 0.1f;
+        float farPlane = side * 0.5f;
+        glm::mat4 projection(0.0f);
+        projection[0][0] = 1.0f / (aspect * t);
+        projection[1][1] = 1.0f / t;
+        projection[2][2] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        projection[2][3] = -1.0f;
+        projection[3][2] = -(2.0f * farPlane * nearPlane) / (farPlane - nearPlane);
+        Frustum frustum;
+        FrustumFromMatrix(frustum, projection);
+
+        std::vector<uint32_t> found(count), reference(count);
+        const uint32_t frustumRuns = 10;
+        uint32_t foundCount = 0, referenceCount = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t run = 0; run < frustumRuns; ++run) {
+            foundCount = BvhQueryFrustum(bvh, frustum, found.data());
+        }
+        double bvhFrustumMs = BvhElapsedMs(start) / frustumRuns;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t run = 0; run < frustumRuns; ++run) {
+            referenceCount = CullSpheresFrustum(frustum, spheres, reference.data());
+        }
+        double linearFrustumMs = BvhElapsedMs(start) / frustumRuns;
+        std::sort(found.begin(), found.begin() + foundCount);
+        bool frustumMatch = foundCount == referenceCount && std::equal(found.begin(), found.begin() + foundCount, reference.begin());
+        std::cout << "  frustum: " << bvhFrustumMs << " ms vs " << linearFrustumMs << " ms linear "
+                  << CullPathName(CullBestPath()) << ", " << foundCount << " visible"
+                  << (frustumMatch ? "" : " (MISMATCH)") << std::endl;
+
+        // Sphere queries, the first few checked by brute force
+        const uint32_t sphereQueries = 10000;
+        const uint32_t checks = 10;
+        std::vector<glm::vec3> centers(sphereQueries);
+        for (glm::vec3 &c : centers) {
+            c = glm::vec3((BvhRandom(seed) - 0.5f) * side, (BvhRandom(seed) - 0.5f) * side, (BvhRandom(seed) - 0.5f) * side);
+        }
+        const float queryRadius = 4.0f;
+        uint64_t sphereHits = 0;
+        bool sphereMatch = true;
+        start = std::chrono::steady_clock::now();
+        for (const glm::vec3 &c : centers) {
+            sphereHits += BvhQuerySphere(bvh, c, queryRadius, found.data());
+        }
+        double sphereMs = BvhElapsedMs(start);
+        for (uint32_t q = 0; q < checks; ++q) {
+            uint32_t n = BvhQuerySphere(bvh, centers[q], queryRadius, found.data());
+            uint32_t expected = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                glm::vec3 d = glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]) - centers[q];
+                float reach = queryRadius + spheres.radius[i];
+                expected += glm::dot(d, d) <= reach * reach ? 1 : 0;
+            }
+            sphereMatch = sphereMatch && n == expected;
+        }
+        std::cout << "  sphere r=" << queryRadius << ": " << sphereQueries / sphereMs / 1000.0 << " M queries/s, "
+                  << (double)sphereHits / sphereQueries << " hits each" << (sphereMatch ? "" : " (MISMATCH)") << std::endl;
+
+        // Rays from random points in random directions
+        const uint32_t rayCount = 100000;
+        std::vector<glm::vec3> origins(rayCount), directions(rayCount);
+        for (uint32_t r = 0; r < rayCount; ++r) {
+            origins[r] = glm::vec3((BvhRandom(seed) - 0.5f) * side, (BvhRandom(seed) - 0.5f) * side, (BvhRandom(seed) - 0.5f) * side);
+            directions[r] = glm::normalize(glm::vec3(BvhRandom(seed) - 0.5f, BvhRandom(seed) - 0.5f, BvhRandom(seed) - 0.5f));
+        }
+        uint32_t rayHits = 0;
+        bool rayMatch = true;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < rayCount; ++r) {
+            BvhRayHit hit;
+            rayHits += BvhRaycast(bvh, origins[r], directions[r], side, hit) ? 1 : 0;
+        }
+        double rayMs = BvhElapsedMs(start);
+        for (uint32_t r = 0; r < checks; ++r) {
+            BvhRayHit hit;
+            bool any = BvhRaycast(bvh, origins[r], directions[r], side, hit);
+            float nearest = side;
+            for (uint32_t i = 0; i < count; ++i) {
+                glm::vec3 oc = origins[r] - glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]);
+                float b = glm::dot(oc, directions[r]);
+                float c = glm::dot(oc, oc) - spheres.radius[i] * spheres.radius[i];
+                float discriminant = b * b - c;
+                if (discriminant >= 0.0f) {
+                    float t = -b - std::sqrt(discriminant);
+                    t = t < 0.0f ? -b + std::sqrt(discriminant) : t;
+                    nearest = t >= 0.0f ? std::min(nearest, t) : nearest;
+                }
+            }
+            rayMatch = rayMatch && any == (nearest < side) && (!any || std::abs(hit.t - nearest) < 1.0e-3f);
+        }
+        std::cout << "  rays: " << rayCount / rayMs / 1000.0 << " M rays/s, " << rayHits << " hits"
+                  << (rayMatch ? "" : " (MISMATCH)") << std::endl;
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+
+// Bounding volume hierarchy
+// Binary tree over the bounding spheres of a CullSpheres set, built top
+// down with a binned surface area heuristic. Nodes live in one array with
+// both children of a node next to each other and always after their
+// parent, so a refit after objects moved is a single backwards sweep.
+// Every node covers a contiguous range of `objects`, which lets a query
+// take a subtree that is entirely inside without visiting it. The spheres
+// are copied in the same order, so leaves read them sequentially.
+// -------------------------------------
+#define BVH_LEAF_SIZE 4      // ranges this small are never split
+#define BVH_MAX_LEAF_SIZE 16 // SAH may keep up to this many in a leaf
+#define BVH_SAH_BINS 16
+#define BVH_STACK_SIZE 64
+
+struct BvhNode {
+    glm::vec3 min;
+    uint32_t first; // first slot in Bvh::objects
+    glm::vec3 max;
+    uint32_t count; // objects in the subtree
+    uint32_t left;  // first child, the second one follows it; 0 for leaves
+};
+
+struct Bvh {
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> objects;  // sphere indices, grouped by node
+    std::vector<glm::vec4> spheres; // center and radius of objects[i]
+};
+
+struct BvhRayHit {
+    uint32_t object;
+    float t;
+};
+
+void BvhBuild(Bvh &bvh, const CullSpheres &spheres);
+// Copies the current spheres and recomputes every box without changing
+// the tree. Quality drops as objects drift from where they were built.
+void BvhRefit(Bvh &bvh, const CullSpheres &spheres);
+
+// Each writes the matching sphere indices to `out`, which needs room for
+// every object, and returns how many were written. Order follows the tree.
+uint32_t BvhQueryFrustum(const Bvh &bvh, const Frustum &f, uint32_t *out);
+uint32_t BvhQuerySphere(const Bvh &bvh, glm::vec3 center, float radius, uint32_t *out);
+// Nearest sphere along origin + t * direction for t in [0, maxT]
+bool BvhRaycast(const Bvh &bvh, glm::vec3 origin, glm::vec3 direction, float maxT, BvhRayHit &hit);
+
+// Build, refit and query throughput at 100k, 1M and 4M spheres, checked
+// against brute force
+void BvhBenchmark();
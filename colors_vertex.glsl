@@ -3,21 +3,27 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aModel;        // per instance, locations 3-6
+layout (location = 7) in mat3 aNormalMatrix; // per instance, locations 7-9
 
 out vec3 Normal;
 out vec3 FragmentPosition;
 out vec2 TexCoords;
+out vec4 ClipPosition; // picks the light cluster in the fragment shader
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 perspective;
-uniform mat3 normalMatrix;
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPosition;
+};
 
 void main()
 {
-   FragmentPosition = vec3(model * vec4(aPos, 1.0f));
-   Normal = normalMatrix * aNormal;
+   FragmentPosition = vec3(aModel * vec4(aPos, 1.0f));
+   Normal = aNormalMatrix * aNormal;
    TexCoords = aTexCoords;
 
-   gl_Position = perspective * view * vec4(FragmentPosition, 1.0f);
+   gl_Position = viewProjection * vec4(FragmentPosition, 1.0f);
+   ClipPosition = gl_Position;
 };
@@ -0,0 +1,223 @@
+#include "cooked_texture.h"
+#include "material_pack.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <cstring>
+
+std::string CookedTexturePath(const char *sourcePath) {
+    std::filesystem::path source(sourcePath);
+    return std::string(COOKED_TEXTURE_DIR) + "/" + source.filename().string() + ".ctex";
+}
+
+std::string CookedTexturePackedPath(const char *diffusePath, const char *specularPath) {
+    return std::string(COOKED_TEXTURE_DIR) + "/" + MaterialPackName(diffusePath, specularPath) + ".ctex";
+}
+
+// 2x2 box filter, edges clamp so odd sizes keep their last row/column
+// ---------------------------
+static void CookDownsample(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight,
+                           uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t channels) {
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        uint32_t y0 = y * 2 < srcHeight ? y * 2 : srcHeight - 1;
+        uint32_t y1 = y * 2 + 1 < srcHeight ? y * 2 + 1 : srcHeight - 1;
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            uint32_t x0 = x * 2 < srcWidth ? x * 2 : srcWidth - 1;
+            uint32_t x1 = x * 2 + 1 < srcWidth ? x * 2 + 1 : srcWidth - 1;
+            for (uint32_t c = 0; c < channels; ++c) {
+                uint32_t sum = src[(y0 * srcWidth + x0) * channels + c] +
+                               src[(y0 * srcWidth + x1) * channels + c] +
+                               src[(y1 * srcWidth + x0) * channels + c] +
+                               src[(y1 * srcWidth + x1) * channels + c];
+                dst[(y * dstWidth + x) * channels + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static uint64_t CookAlign(uint64_t value) {
+    return (value + 15) & ~(uint64_t)15;
+}
+
+static BcFormat CookFormat(BcFormat requested, uint32_t channels) {
+    if (requested != BC_FORMAT_AUTO) {
+        return requested;
+    }
+    return channels == 3 ? BC_FORMAT_BC1 : channels == 4 ? BC_FORMAT_BC7 : BC_FORMAT_NONE;
+}
+
+// Writes the mip chain of `pixels`, which it frees
+static bool CookPixels(uint8_t *pixels, int width, int height, int channels, const char *sourceName,
+                       const char *cookedPath, BcFormat format, JobPool *pool) {
+    CookedTextureHeader header{};
+    header.magic = COOKED_TEXTURE_MAGIC;
+    header.version = COOKED_TEXTURE_VERSION;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.channels = (uint32_t)channels;
+    header.format = CookFormat(format, header.channels);
+
+    // Full chain down to 1x1, same levels glGenerateMipmap would produce.
+    // Each level is filtered from the uncompressed one above it.
+    std::vector<std::vector<uint8_t>> levels;
+    std::vector<uint8_t> source(pixels, pixels + (size_t)width * height * channels);
+    stbi_image_free(pixels);
+
+    uint64_t offset = CookAlign(sizeof(CookedTextureHeader));
+    uint32_t w = header.width;
+    uint32_t h = header.height;
+    for (uint32_t level = 0; level < COOKED_TEXTURE_MAX_MIPS; ++level) {
+        if (level > 0) {
+            uint32_t nw = w > 1 ? w / 2 : 1;
+            uint32_t nh = h > 1 ? h / 2 : 1;
+            std::vector<uint8_t> next((size_t)nw * nh * channels);
+            CookDownsample(source.data(), w, h, next.data(), nw, nh, header.channels);
+            source.swap(next);
+            w = nw;
+            h = nh;
+        }
+        if (header.format == BC_FORMAT_NONE) {
+            levels.push_back(source);
+        } else {
+            levels.emplace_back(BcImageSize((BcFormat)header.format, w, h));
+            BcEncode((BcFormat)header.format, source.data(), w, h, header.channels, levels.back().data(), pool);
+        }
+        CookedTextureMip &mip = header.mips[level];
+        mip.width = w;
+        mip.height = h;
+        mip.size = levels.back().size();
+        mip.offset = offset;
+        offset = CookAlign(offset + mip.size);
+        header.mipCount = level + 1;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path(), ec);
+    std::ofstream file(cookedPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Cannot write " << cookedPath << std::endl;
+        return false;
+    }
+    file.write((const char *)&header, sizeof(header));
+    uint64_t written = sizeof(header);
+    const char zeros[16] = {};
+    for (uint32_t level = 0; level < header.mipCount; ++level) {
+        const CookedTextureMip &mip = header.mips[level];
+        file.write(zeros, (std::streamsize)(mip.offset - written));
+        file.write((const char *)levels[level].data(), (std::streamsize)mip.size);
+        written = mip.offset + mip.size;
+    }
+    if (!file) {
+        std::cerr << "Cannot write " << cookedPath << std::endl;
+        return false;
+    }
+    std::cout << "Cooked " << sourceName << " -> " << cookedPath << " (" << header.width << "x"
+              << header.height << "x" << header.channels << " " << BcFormatName((BcFormat)header.format) << ", " << header.mipCount << " mips, "
+              << written << " bytes)" << std::endl;
+    return true;
+}
+
+bool CookTexture(const char *sourcePath, const char *cookedPath, BcFormat format, JobPool *pool) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(true);
+    uint8_t *pixels = stbi_load(sourcePath, &width, &height, &channels, 0);
+    if (!pixels) {
+        std::cerr << "Cannot cook " << sourcePath << " : " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    return CookPixels(pixels, width, height, channels, sourcePath, cookedPath, format, pool);
+}
+
+bool CookPackedTexture(const char *diffusePath, const char *specularPath, const char *cookedPath,
+                       BcFormat format, JobPool *pool) {
+    int width, height;
+    uint8_t *pixels = MaterialPackLoad(diffusePath, specularPath, width, height);
+    if (!pixels) {
+        return false;
+    }
+    std::string name = MaterialPackName(diffusePath, specularPath);
+    return CookPixels(pixels, width, height, 4, name.c_str(), cookedPath, format, pool);
+}
+
+int CookAllTextures(const char *assetDir, BcFormat format, JobPool *pool) {
+    int failures = 0;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(assetDir, ec)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        std::string extension = entry.path().extension().string();
+        if (extension != ".png" && extension != ".jpg" && extension != ".jpeg") {
+            continue;
+        }
+        std::string source = entry.path().string();
+        if (!CookTexture(source.c_str(), CookedTexturePath(source.c_str()).c_str(), format, pool)) {
+            failures++;
+        }
+    }
+    if (ec) {
+        std::cerr << "Cannot list " << assetDir << " : " << ec.message() << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+bool CookedTextureOpen(CookedTexture &t, const char *cookedPath, const char *sourcePath, const char *secondSourcePath) {
+    t = {};
+    std::error_code ec;
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, ec);
+    if (ec) {
+        return false;
+    }
+    const char *sources[] = { sourcePath, secondSourcePath };
+    for (const char *source : sources) {
+        if (!source) {
+            continue;
+        }
+        auto sourceTime = std::filesystem::last_write_time(source, ec);
+        if (!ec && sourceTime > cookedTime) {
+            std::cerr << cookedPath << " is older than " << source << ", run --cook again" << std::endl;
+            return false;
+        }
+    }
+    if (!MappedFileOpen(t.file, cookedPath)) {
+        return false;
+    }
+
+    const CookedTextureHeader *header = (const CookedTextureHeader *)t.file.data;
+    bool valid = t.file.size >= sizeof(CookedTextureHeader) &&
+                 header->magic == COOKED_TEXTURE_MAGIC &&
+                 header->version == COOKED_TEXTURE_VERSION &&
+                 header->mipCount >= 1 && header->mipCount <= COOKED_TEXTURE_MAX_MIPS &&
+                 header->channels >= 1 && header->channels <= 4 &&
+                 header->format <= BC_FORMAT_BC7;
+    for (uint32_t level = 0; valid && level < header->mipCount; ++level) {
+        const CookedTextureMip &mip = header->mips[level];
+        uint64_t expected = header->format == BC_FORMAT_NONE
+            ? (uint64_t)mip.width * mip.height * header->channels
+            : BcImageSize((BcFormat)header->format, mip.width, mip.height);
+        valid = mip.offset + mip.size <= t.file.size && mip.size == expected;
+    }
+    if (!valid) {
+        std::cerr << cookedPath << " is not a valid cooked texture" << std::endl;
+        MappedFileClose(t.file);
+        return false;
+    }
+    t.header = header;
+    return true;
+}
+
+const uint8_t *CookedTextureMipData(const CookedTexture &t, uint32_t level) {
+    return t.file.data + t.header->mips[level].offset;
+}
+
+void CookedTextureClose(CookedTexture &t) {
+    MappedFileClose(t.file);
+    t.header = nullptr;
+}
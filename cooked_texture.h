@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+#include "bc_encoder.h"
+#include "jobs.h"
+
+// Cooked textures
+// `--cook` converts ./assets/*.png|jpg into ./assets/cooked/<file>.ctex:
+// a header followed by every mip level, already flipped for GL and tightly
+// packed, so the runtime can upload straight out of a memory mapping.
+// Levels are block compressed (bc_encoder.h) unless `--cook-format none`.
+// -------------------------------------
+#define COOKED_TEXTURE_MAGIC 0x58455443u // "CTEX"
+#define COOKED_TEXTURE_VERSION 2
+#define COOKED_TEXTURE_MAX_MIPS 16
+#define COOKED_TEXTURE_DIR "./assets/cooked"
+
+struct CookedTextureMip {
+    uint64_t offset; // from the start of the file, 16 byte aligned
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CookedTextureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels; // of the source image
+    uint32_t format;   // BcFormat, BC_FORMAT_NONE for plain pixels
+    uint32_t mipCount;
+    CookedTextureMip mips[COOKED_TEXTURE_MAX_MIPS];
+};
+
+struct CookedTexture {
+    MappedFile file;
+    const CookedTextureHeader *header;
+};
+
+// "./assets/container2.png" -> "./assets/cooked/container2.png.ctex"
+std::string CookedTexturePath(const char *sourcePath);
+// Of a diffuse map with the specular map in alpha (material_pack.h):
+// "./assets/cooked/container2.png+container2_specular.png.ctex"
+std::string CookedTexturePackedPath(const char *diffusePath, const char *specularPath);
+
+// BC_FORMAT_AUTO picks BC1 for RGB, BC7 for RGBA and no compression for
+// grey images
+bool CookTexture(const char *sourcePath, const char *cookedPath, BcFormat format, JobPool *pool);
+bool CookPackedTexture(const char *diffusePath, const char *specularPath, const char *cookedPath,
+                       BcFormat format, JobPool *pool);
+// Cooks every png/jpg in `assetDir`, returns the number of failures
+int CookAllTextures(const char *assetDir, BcFormat format, JobPool *pool);
+
+// Maps `cookedPath` if it exists, is valid and isn't older than its sources
+bool CookedTextureOpen(CookedTexture &t, const char *cookedPath, const char *sourcePath,
+                       const char *secondSourcePath = nullptr);
+const uint8_t *CookedTextureMipData(const CookedTexture &t, uint32_t level);
+void CookedTextureClose(CookedTexture &t);
@@ -0,0 +1,73 @@
+#pragma once
+
+// Runtime CPU feature detection, used to pick SIMD code paths
+// -------------------------------------
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET_AVX
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+struct CpuFeatures {
+    bool sse2;
+    bool sse41;
+    bool avx;
+    bool avx2;
+    bool fma;
+};
+
+inline void CpuId(int regs[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+    __cpuidex(regs, leaf, subleaf);
+#else
+    __asm__ __volatile__("cpuid"
+        : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+        : "a"(leaf), "c"(subleaf));
+#endif
+}
+
+inline unsigned long long CpuXGetBV() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+inline CpuFeatures CpuDetectFeatures() {
+    CpuFeatures f{};
+    int regs[4];
+    CpuId(regs, 0, 0);
+    int maxLeaf = regs[0];
+
+    CpuId(regs, 1, 0);
+    f.sse2 = (regs[3] & (1 << 26)) != 0;
+    f.sse41 = (regs[2] & (1 << 19)) != 0;
+    f.fma = (regs[2] & (1 << 12)) != 0;
+
+    // AVX also needs the OS to save the YMM registers on context switch
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avxBit = (regs[2] & (1 << 28)) != 0;
+    bool ymmSaved = osxsave && (CpuXGetBV() & 0x6) == 0x6;
+    f.avx = avxBit && ymmSaved;
+
+    if (maxLeaf >= 7) {
+        CpuId(regs, 7, 0);
+        f.avx2 = f.avx && (regs[1] & (1 << 5)) != 0;
+    }
+    f.fma = f.fma && f.avx;
+    return f;
+}
+
+inline const CpuFeatures &CpuGetFeatures() {
+    static const CpuFeatures features = CpuDetectFeatures();
+    return features;
+}
@@ -0,0 +1,285 @@
+#include "culling.h"
+#include "cpu_features.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// Gribb/Hartmann plane extraction, rows of the clip matrix combined so
+// that a point is inside when dot(plane.xyz, p) + plane.w >= 0
+// ---------------------------
+void FrustumFromMatrix(Frustum &f, const glm::mat4 &m) {
+    // glm::mat[column][row]
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    f.planes[0] = row3 + row0; // left
+    f.planes[1] = row3 - row0; // right
+    f.planes[2] = row3 + row1; // bottom
+    f.planes[3] = row3 - row1; // top
+    f.planes[4] = row3 + row2; // near
+    f.planes[5] = row3 - row2; // far
+
+    // Normalize so plane distances can be compared against radii
+    for (int i = 0; i < 6; ++i) {
+        glm::vec3 n(f.planes[i]);
+        f.planes[i] = f.planes[i] / glm::length(n);
+    }
+}
+
+void CullSpheresResize(CullSpheres &s, uint32_t count) {
+    s.x.resize(count);
+    s.y.resize(count);
+    s.z.resize(count);
+    s.radius.resize(count);
+}
+
+void CullSpheresSet(CullSpheres &s, uint32_t index, glm::vec3 center, float radius) {
+    s.x[index] = center.x;
+    s.y[index] = center.y;
+    s.z[index] = center.z;
+    s.radius[index] = radius;
+}
+
+uint32_t CullSpheresCount(const CullSpheres &s) {
+    return (uint32_t)s.x.size();
+}
+
+// Scalar
+// ---------------------------
+static uint32_t CullScalar(const Frustum &f, const CullSpheres &s, uint32_t begin, uint32_t end, uint32_t *visible, uint32_t n) {
+    for (uint32_t i = begin; i < end; ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4 &pl = f.planes[p];
+            float d = pl.x * s.x[i] + pl.y * s.y[i] + pl.z * s.z[i] + pl.w;
+            inside = inside && d > -s.radius[i];
+        }
+        visible[n] = i;
+        n += inside ? 1 : 0;
+    }
+    return n;
+}
+
+// SSE2, 4 spheres per iteration
+// ---------------------------
+static uint32_t CullSSE(const Frustum &f, const CullSpheres &s, uint32_t begin, uint32_t end, uint32_t *visible) {
+    const float *xs = s.x.data();
+    const float *ys = s.y.data();
+    const float *zs = s.z.data();
+    const float *rs = s.radius.data();
+
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm_set1_ps(f.planes[p].x);
+        py[p] = _mm_set1_ps(f.planes[p].y);
+        pz[p] = _mm_set1_ps(f.planes[p].z);
+        pw[p] = _mm_set1_ps(f.planes[p].w);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(rs + i));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                                  _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(d, negR));
+        }
+
+        // Branch free compaction: always write, only advance on a hit
+        uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            visible[n] = i + lane;
+            n += (mask >> lane) & 1;
+        }
+    }
+    return CullScalar(f, s, i, end, visible, n);
+}
+
+// AVX, 8 spheres per iteration
+// ---------------------------
+SIMD_TARGET_AVX
+static uint32_t CullAVX(const Frustum &f, const CullSpheres &s, uint32_t begin, uint32_t end, uint32_t *visible) {
+    const float *xs = s.x.data();
+    const float *ys = s.y.data();
+    const float *zs = s.z.data();
+    const float *rs = s.radius.data();
+
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; ++p) {
+        px[p] = _mm256_set1_ps(f.planes[p].x);
+        py[p] = _mm256_set1_ps(f.planes[p].y);
+        pz[p] = _mm256_set1_ps(f.planes[p].z);
+        pw[p] = _mm256_set1_ps(f.planes[p].w);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t n = 0;
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 negR = _mm256_sub_ps(zero, _mm256_loadu_ps(rs + i));
+
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[0], x), _mm256_mul_ps(py[0], y)),
+                                 _mm256_add_ps(_mm256_mul_ps(pz[0], z), pw[0]));
+        __m256 inside = _mm256_cmp_ps(d, negR, _CMP_GT_OQ);
+        for (int p = 1; p < 6; ++p) {
+            d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+                              _mm256_add_ps(_mm256_mul_ps(pz[p], z), pw[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GT_OQ));
+        }
+
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 8; ++lane) {
+            visible[n] = i + lane;
+            n += (mask >> lane) & 1;
+        }
+    }
+    _mm256_zeroupper();
+    return CullScalar(f, s, i, end, visible, n);
+}
+
+const char *CullPathName(CullPath path) {
+    switch (path) {
+    case CULL_PATH_SCALAR: return "scalar";
+    case CULL_PATH_SSE: return "sse2";
+    case CULL_PATH_AVX: return "avx";
+    default: return "auto";
+    }
+}
+
+CullPath CullBestPath() {
+    const CpuFeatures &cpu = CpuGetFeatures();
+    if (cpu.avx) {
+        return CULL_PATH_AVX;
+    }
+    if (cpu.sse2) {
+        return CULL_PATH_SSE;
+    }
+    return CULL_PATH_SCALAR;
+}
+
+static uint32_t CullRange(const Frustum &f, const CullSpheres &s, uint32_t begin, uint32_t end, uint32_t *visible, CullPath path) {
+    switch (path) {
+    case CULL_PATH_AVX: return CullAVX(f, s, begin, end, visible);
+    case CULL_PATH_SSE: return CullSSE(f, s, begin, end, visible);
+    default: return CullScalar(f, s, begin, end, visible, 0);
+    }
+}
+
+uint32_t CullSpheresFrustum(const Frustum &f, const CullSpheres &s, uint32_t *visible, CullPath path) {
+    if (path == CULL_PATH_AUTO) {
+        path = CullBestPath();
+    }
+    return CullRange(f, s, 0, CullSpheresCount(s), visible, path);
+}
+
+// Every job culls its range into the matching slice of `visible`, which
+// can hold the whole range, then the slices are packed down in order
+uint32_t CullSpheresFrustumParallel(const Frustum &f, const CullSpheres &s, uint32_t *visible, JobPool &pool, CullPath path) {
+    if (path == CULL_PATH_AUTO) {
+        path = CullBestPath();
+    }
+    const uint32_t count = CullSpheresCount(s);
+    const uint32_t jobCount = (count + CULL_JOB_SPHERES - 1) / CULL_JOB_SPHERES;
+    if (jobCount <= 1 || pool.workers.empty()) {
+        return CullRange(f, s, 0, count, visible, path);
+    }
+
+    std::vector<uint32_t> jobVisible(jobCount);
+    JobPoolParallelFor(pool, jobCount, [&](uint32_t job) {
+        uint32_t begin = job * CULL_JOB_SPHERES;
+        uint32_t end = std::min(begin + CULL_JOB_SPHERES, count);
+        jobVisible[job] = CullRange(f, s, begin, end, visible + begin, path);
+    });
+
+    uint32_t n = jobVisible[0];
+    for (uint32_t job = 1; job < jobCount; ++job) {
+        memmove(visible + n, visible + job * CULL_JOB_SPHERES, jobVisible[job] * sizeof(uint32_t));
+        n += jobVisible[job];
+    }
+    return n;
+}
+
+// Benchmark
+// ---------------------------
+static float CullRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return (float)(state >> 8) / 16777216.0f;
+}
+
+void CullBenchmark() {
+    // Same projection as CameraGetPerspective, camera at the origin looking down -z
+    float fov = glm::radians(45.0f);
+    float aspect = 800.0f / 600.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    float t = std::tan(fov * 0.5f);
+    glm::mat4 projection(0.0f);
+    projection[0][0] = 1.0f / (aspect * t);
+    projection[1][1] = 1.0f / t;
+    projection[2][2] = -(farPlane + nearPlane) / (farPlane - nearPlane);
+    projection[2][3] = -1.0f;
+    projection[3][2] = -(2.0f * farPlane * nearPlane) / (farPlane - nearPlane);
+
+    Frustum frustum;
+    FrustumFromMatrix(frustum, projection);
+
+    const CpuFeatures &cpu = CpuGetFeatures();
+    const uint32_t counts[] = { 10000, 100000, 1000000 };
+    for (uint32_t count : counts) {
+        CullSpheres spheres;
+        CullSpheresResize(spheres, count);
+        uint32_t seed = 1234;
+        for (uint32_t i = 0; i < count; ++i) {
+            glm::vec3 center(
+                (CullRandom(seed) - 0.5f) * 200.0f,
+                (CullRandom(seed) - 0.5f) * 200.0f,
+                (CullRandom(seed) - 0.5f) * 200.0f);
+            CullSpheresSet(spheres, i, center, 0.5f + CullRandom(seed));
+        }
+        std::vector<uint32_t> visible(count);
+        std::vector<uint32_t> reference(count);
+        uint32_t referenceCount = CullSpheresFrustum(frustum, spheres, reference.data(), CULL_PATH_SCALAR);
+
+        const CullPath paths[] = { CULL_PATH_SCALAR, CULL_PATH_SSE, CULL_PATH_AVX };
+        for (CullPath path : paths) {
+            if ((path == CULL_PATH_SSE && !cpu.sse2) || (path == CULL_PATH_AVX && !cpu.avx)) {
+                continue;
+            }
+
+            // Enough iterations for roughly 50M sphere tests per measurement
+            uint32_t iterations = 50000000 / count;
+            uint32_t visibleCount = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t it = 0; it < iterations; ++it) {
+                visibleCount = CullSpheresFrustum(frustum, spheres, visible.data(), path);
+            }
+            auto end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(end - start).count();
+
+            bool match = visibleCount == referenceCount &&
+                std::equal(visible.begin(), visible.begin() + visibleCount, reference.begin());
+            double perSecond = (double)count * iterations / seconds;
+            std::cout << "cull " << CullPathName(path) << " " << count << " spheres: "
+                      << perSecond / 1.0e6 << " M objects/s, "
+                      << (count - visibleCount) << " culled"
+                      << (match ? "" : " (MISMATCH vs scalar)") << std::endl;
+        }
+    }
+}
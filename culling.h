@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+
+// Frustum culling
+// Bounding spheres are stored as structure of arrays so the SSE/AVX paths
+// can test 4/8 of them against a plane with a handful of instructions.
+// -------------------------------------
+#define CULL_JOB_SPHERES 16384 // spheres per job, a multiple of 8
+
+struct Frustum {
+    glm::vec4 planes[6]; // xyz = normal pointing inside, w = distance
+};
+
+struct CullSpheres {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+};
+
+enum CullPath {
+    CULL_PATH_SCALAR,
+    CULL_PATH_SSE,
+    CULL_PATH_AVX,
+    CULL_PATH_AUTO
+};
+
+void FrustumFromMatrix(Frustum &f, const glm::mat4 &viewProjection);
+
+void CullSpheresResize(CullSpheres &s, uint32_t count);
+void CullSpheresSet(CullSpheres &s, uint32_t index, glm::vec3 center, float radius);
+uint32_t CullSpheresCount(const CullSpheres &s);
+
+// Writes the indices of the spheres touching the frustum to `visible`,
+// which must have room for CullSpheresCount(s) entries, and returns how
+// many were written. Indices come out in ascending order.
+uint32_t CullSpheresFrustum(const Frustum &f, const CullSpheres &s, uint32_t *visible, CullPath path = CULL_PATH_AUTO);
+
+// Same result as CullSpheresFrustum, ranges of CULL_JOB_SPHERES culled on `pool`
+uint32_t CullSpheresFrustumParallel(const Frustum &f, const CullSpheres &s, uint32_t *visible, JobPool &pool, CullPath path = CULL_PATH_AUTO);
+
+const char *CullPathName(CullPath path);
+CullPath CullBestPath();
+
+// CPU only benchmark of every available path at 10k/100k/1M spheres
+void CullBenchmark();
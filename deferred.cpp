@@ -0,0 +1,125 @@
+#include "deferred.h"
+#include "gl_state.h"
+
+#include <iostream>
+
+static uint32_t GBufferCreateTarget(GLenum internalFormat, GLenum format, GLenum type, uint32_t width, uint32_t height) {
+    uint32_t texture;
+    glGenTextures(1, &texture);
+    GLStateBindTextureForEdit(GBUFFER_UNIT_ALBEDO, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, (GLsizei)width, (GLsizei)height, 0, format, type, nullptr);
+    return texture;
+}
+
+void GBufferInit(GBuffer &g, uint32_t width, uint32_t height) {
+    if (g.framebuffer != 0) {
+        if (g.width == width && g.height == height) {
+            return;
+        }
+        GBufferShutdown(g);
+    }
+    g.width = width;
+    g.height = height;
+
+    g.albedoSpecular = GBufferCreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    g.normal = GBufferCreateTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+    g.depth = GBufferCreateTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+
+    glGenFramebuffers(1, &g.framebuffer);
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, g.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g.albedoSpecular, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, g.normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, g.depth, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::GBUFFER::INCOMPLETE " << width << "x" << height << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (g.emptyVertexArray == 0) {
+        glGenVertexArrays(1, &g.emptyVertexArray);
+    }
+}
+
+void GBufferShutdown(GBuffer &g) {
+    if (g.framebuffer == 0) {
+        return;
+    }
+    uint32_t textures[] = { g.albedoSpecular, g.normal, g.depth };
+    GLStateDeleteFramebuffers(1, &g.framebuffer);
+    GLStateDeleteTextures(3, textures);
+    g.framebuffer = 0;
+}
+
+void GBufferBeginGeometry(const GBuffer &g) {
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, g.framebuffer);
+    glViewport(0, 0, (GLsizei)g.width, (GLsizei)g.height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBufferBindTextures(const GBuffer &g, uint32_t sampler) {
+    GLStateBindTexture(GBUFFER_UNIT_ALBEDO, GL_TEXTURE_2D, g.albedoSpecular);
+    GLStateBindTexture(GBUFFER_UNIT_NORMAL, GL_TEXTURE_2D, g.normal);
+    GLStateBindTexture(GBUFFER_UNIT_DEPTH, GL_TEXTURE_2D, g.depth);
+    GLStateBindSampler(GBUFFER_UNIT_ALBEDO, sampler);
+    GLStateBindSampler(GBUFFER_UNIT_NORMAL, sampler);
+    GLStateBindSampler(GBUFFER_UNIT_DEPTH, sampler);
+}
+
+void GBufferCopyDepth(const GBuffer &g, uint32_t framebuffer) {
+    GLStateBindFramebuffer(GL_READ_FRAMEBUFFER, g.framebuffer);
+    GLStateBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(0, 0, (GLint)g.width, (GLint)g.height, 0, 0, (GLint)g.width, (GLint)g.height,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void GBufferDrawFullscreen(const GBuffer &g) {
+    GLStateBindVertexArray(g.emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// GPU timer
+// ---------------------------
+void GpuTimerInit(GpuTimer &t) {
+    glGenQueries(GPU_TIMER_LATENCY * 2, &t.queries[0][0]);
+    for (uint32_t i = 0; i < GPU_TIMER_LATENCY; ++i) {
+        t.pending[i] = false;
+    }
+    t.frame = 0;
+    GpuTimerReset(t);
+}
+
+void GpuTimerShutdown(GpuTimer &t) {
+    glDeleteQueries(GPU_TIMER_LATENCY * 2, &t.queries[0][0]);
+}
+
+void GpuTimerBegin(GpuTimer &t) {
+    // The pair about to be reused was issued GPU_TIMER_LATENCY frames ago
+    uint32_t slot = t.frame % GPU_TIMER_LATENCY;
+    if (t.pending[slot]) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(t.queries[slot][0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(t.queries[slot][1], GL_QUERY_RESULT, &end);
+        t.totalMs += (double)(end - begin) * 1.0e-6;
+        t.samples++;
+    }
+    glQueryCounter(t.queries[slot][0], GL_TIMESTAMP);
+}
+
+void GpuTimerEnd(GpuTimer &t) {
+    glQueryCounter(t.queries[t.frame % GPU_TIMER_LATENCY][1], GL_TIMESTAMP);
+    t.pending[t.frame % GPU_TIMER_LATENCY] = true;
+    t.frame++;
+}
+
+double GpuTimerAverageMs(const GpuTimer &t) {
+    return t.samples > 0 ? t.totalMs / t.samples : 0.0;
+}
+
+void GpuTimerReset(GpuTimer &t) {
+    t.totalMs = 0.0;
+    t.samples = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+// Deferred shading
+// The geometry pass writes every visible surface once into a G-buffer of
+// two small color targets and a depth texture:
+//   albedo rgb + specular   RGBA8
+//   normal                  RG16, octahedral encoded
+//   depth                   DEPTH24_STENCIL8, positions are rebuilt from it
+// A full screen triangle then runs the same lighting as the forward path
+// (lighting.glsl) once per pixel, so overdraw no longer multiplies the
+// cost of the clustered lights. Depth is copied to the output afterwards
+// so forward draws like the light cube still depth test against the scene.
+// -------------------------------------
+#define GBUFFER_UNIT_ALBEDO 0 // texture units of the lighting pass; 2-4 hold the light clusters
+#define GBUFFER_UNIT_NORMAL 1
+#define GBUFFER_UNIT_DEPTH 5
+
+#define GPU_TIMER_LATENCY 4 // frames a timer query may stay in flight
+
+struct GBuffer {
+    uint32_t framebuffer;
+    uint32_t albedoSpecular;
+    uint32_t normal;
+    uint32_t depth;
+    uint32_t width;
+    uint32_t height;
+    uint32_t emptyVertexArray; // core profile draws need one bound
+};
+
+// Creates or, when the size changed, recreates the targets
+void GBufferInit(GBuffer &g, uint32_t width, uint32_t height);
+void GBufferShutdown(GBuffer &g);
+// Binds the G-buffer as the draw target and clears it
+void GBufferBeginGeometry(const GBuffer &g);
+// Binds the G-buffer textures for the lighting pass. The targets have no
+// mips and are read at exact texel centers, `sampler` should be nearest
+// without mipmapping and clamp to the edge.
+void GBufferBindTextures(const GBuffer &g, uint32_t sampler);
+// Copies the G-buffer depth into `framebuffer`, which must have the same size
+void GBufferCopyDepth(const GBuffer &g, uint32_t framebuffer);
+void GBufferDrawFullscreen(const GBuffer &g);
+
+// GPU time between Begin and End, read back GPU_TIMER_LATENCY frames later
+// so the CPU never waits on the result. Timestamps rather than an elapsed
+// time query, so the profiler's per pass queries can run in between.
+struct GpuTimer {
+    uint32_t queries[GPU_TIMER_LATENCY][2]; // begin and end timestamp
+    bool pending[GPU_TIMER_LATENCY];
+    uint32_t frame;
+    double totalMs; // of the results read back since the last reset
+    uint32_t samples;
+};
+
+void GpuTimerInit(GpuTimer &t);
+void GpuTimerShutdown(GpuTimer &t);
+void GpuTimerBegin(GpuTimer &t);
+void GpuTimerEnd(GpuTimer &t);
+// Mean of the results read back since the last reset, 0 without any
+double GpuTimerAverageMs(const GpuTimer &t);
+void GpuTimerReset(GpuTimer &t);
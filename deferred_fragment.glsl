@@ -0,0 +1,51 @@
+#version 330 core
+
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPosition;
+};
+
+in vec2 ScreenCoords;
+
+out vec4 FragColor;
+
+#include "lighting.glsl"
+
+// Written by gbuffer_fragment.glsl
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+vec3 OctahedralDecode(vec2 f)
+{
+    vec3 n = vec3(f.x, f.y, 1.0f - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0f, 1.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    float depth = texture(gDepth, ScreenCoords).r;
+    if (depth == 1.0f) {
+        FragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f); // nothing drawn, the clear color
+        return;
+    }
+
+    vec4 world = inverseViewProjection * vec4(vec3(ScreenCoords, depth) * 2.0f - 1.0f, 1.0f);
+    vec3 position = world.xyz / world.w;
+    vec4 albedoSpecular = texture(gAlbedoSpecular, ScreenCoords);
+    vec3 norm = OctahedralDecode(texture(gNormal, ScreenCoords).rg * 2.0f - 1.0f);
+    vec3 cameraDir = normalize(cameraPosition - position);
+    vec3 diffuseColor = albedoSpecular.rgb;
+    vec3 specularColor = vec3(albedoSpecular.a);
+
+    vec3 color = SpotLighting(position, norm, cameraDir, diffuseColor, specularColor);
+    color += ClusterLighting(position, viewProjection * vec4(position, 1.0f), norm, cameraDir, diffuseColor, specularColor);
+
+    FragColor = vec4(color, 1.0f);
+};
@@ -0,0 +1,12 @@
+#version 330 core
+
+// One triangle covering the screen, corners taken from the vertex id so no
+// vertex buffer is needed
+out vec2 ScreenCoords;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    ScreenCoords = corner;
+    gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+};
@@ -0,0 +1,96 @@
+#include "frame_clock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+uint64_t FrameClockNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameClockInit(FrameClock &c) {
+    c.startNs = FrameClockNowNs();
+    c.lastNs = c.startNs;
+    c.frameNs = 0;
+    c.accumulatorNs = 0;
+    c.frames = 0;
+    c.steps = 0;
+    c.droppedNs = 0;
+}
+
+uint32_t FrameClockAdvance(FrameClock &c) {
+    uint64_t now = FrameClockNowNs();
+    c.frameNs = now - c.lastNs;
+    c.lastNs = now;
+    c.frames++;
+
+    c.accumulatorNs += c.frameNs;
+    uint64_t steps = c.accumulatorNs / FRAME_CLOCK_STEP_NS;
+    if (steps > FRAME_CLOCK_MAX_STEPS) {
+        c.droppedNs += (steps - FRAME_CLOCK_MAX_STEPS) * FRAME_CLOCK_STEP_NS;
+        steps = FRAME_CLOCK_MAX_STEPS;
+    }
+    c.accumulatorNs %= FRAME_CLOCK_STEP_NS;
+    c.steps += steps;
+    return (uint32_t)steps;
+}
+
+double FrameClockAlpha(const FrameClock &c) {
+    return (double)c.accumulatorNs / (double)FRAME_CLOCK_STEP_NS;
+}
+
+double FrameClockStepSeconds() {
+    return (double)FRAME_CLOCK_STEP_NS * 1.0e-9;
+}
+
+double FrameClockSeconds(const FrameClock &c) {
+    return (double)(c.lastNs - c.startNs) * 1.0e-9;
+}
+
+// Frame time histogram
+// ---------------------------
+void FrameHistogramReset(FrameHistogram &h) {
+    std::fill(h.counts, h.counts + FRAME_HISTOGRAM_BUCKETS, 0);
+    h.count = 0;
+    h.totalMs = 0.0;
+    h.minMs = 0.0;
+    h.maxMs = 0.0;
+}
+
+static uint32_t FrameHistogramBucket(double ms) {
+    if (ms <= FRAME_HISTOGRAM_MIN_MS) {
+        return 0;
+    }
+    double bucket = std::floor(std::log2(ms / FRAME_HISTOGRAM_MIN_MS) * FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE);
+    return (uint32_t)std::min(bucket, (double)(FRAME_HISTOGRAM_BUCKETS - 1));
+}
+
+void FrameHistogramAdd(FrameHistogram &h, double ms) {
+    h.counts[FrameHistogramBucket(ms)]++;
+    h.minMs = h.count == 0 ? ms : std::min(h.minMs, ms);
+    h.maxMs = h.count == 0 ? ms : std::max(h.maxMs, ms);
+    h.count++;
+    h.totalMs += ms;
+}
+
+double FrameHistogramPercentile(const FrameHistogram &h, double p) {
+    if (h.count == 0) {
+        return 0.0;
+    }
+    // Nearest rank, like BenchPercentile
+    uint64_t rank = std::max((uint64_t)std::ceil(p * (double)h.count), (uint64_t)1);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < FRAME_HISTOGRAM_BUCKETS; ++i) {
+        seen += h.counts[i];
+        if (seen >= rank) {
+            double upper = FRAME_HISTOGRAM_MIN_MS * std::exp2((double)(i + 1) / FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE);
+            return std::min(std::max(upper, h.minMs), h.maxMs);
+        }
+    }
+    return h.maxMs;
+}
+
+double FrameHistogramMean(const FrameHistogram &h) {
+    return h.count > 0 ? h.totalMs / (double)h.count : 0.0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+// Frame clock
+// Time is kept as integer nanoseconds of a monotonic clock, so it doesn't
+// lose precision however long the session runs. Simulation advances in
+// fixed steps of FRAME_CLOCK_STEP_NS: every frame adds its length to an
+// accumulator and runs as many whole steps as fit, and rendering blends
+// the last two simulated states by what is left over. A frame that took
+// very long (a breakpoint, a hitch) runs at most FRAME_CLOCK_MAX_STEPS and
+// drops the rest instead of trying to catch up.
+// -------------------------------------
+#define FRAME_CLOCK_STEP_NS 8333333ull // 120 Hz
+#define FRAME_CLOCK_MAX_STEPS 8
+
+struct FrameClock {
+    uint64_t startNs;
+    uint64_t lastNs;
+    uint64_t frameNs;       // length of the last frame
+    uint64_t accumulatorNs; // not yet simulated, below one step after Advance
+    uint64_t frames;
+    uint64_t steps;
+    uint64_t droppedNs; // thrown away by the catch-up limit
+};
+
+// Nanoseconds of the monotonic clock, from an arbitrary origin
+uint64_t FrameClockNowNs();
+
+void FrameClockInit(FrameClock &c);
+// Starts a frame and returns how many fixed steps to simulate before it is
+// drawn
+uint32_t FrameClockAdvance(FrameClock &c);
+// How far the frame lies between the last two steps, 0..1
+double FrameClockAlpha(const FrameClock &c);
+double FrameClockStepSeconds();
+double FrameClockSeconds(const FrameClock &c); // since Init
+
+// Frame time histogram
+// Log-spaced buckets, FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE per doubling from
+// FRAME_HISTOGRAM_MIN_MS, so percentiles are within about 4% at any frame
+// time while memory and cost stay fixed however many frames are added.
+// Min, max and the mean are exact.
+// -------------------------------------
+#define FRAME_HISTOGRAM_MIN_MS 0.01
+#define FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE 16
+#define FRAME_HISTOGRAM_BUCKETS (FRAME_HISTOGRAM_BUCKETS_PER_OCTAVE * 24) // up to ~168 s (0.01 ms * 2^24)
+
+struct FrameHistogram {
+    uint64_t counts[FRAME_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    double totalMs;
+    double minMs;
+    double maxMs;
+};
+
+void FrameHistogramReset(FrameHistogram &h);
+void FrameHistogramAdd(FrameHistogram &h, double ms);
+// Upper edge of the bucket holding the p-th frame, clamped to the exact max
+double FrameHistogramPercentile(const FrameHistogram &h, double p);
+double FrameHistogramMean(const FrameHistogram &h);
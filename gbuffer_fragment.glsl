@@ -0,0 +1,36 @@
+#version 330 core
+
+// Geometry pass of the deferred path, fed by colors_vertex.glsl. The
+// material texture already has the G-buffer's layout: albedo in rgb,
+// specular in alpha.
+in vec3 Normal;
+in vec3 FragmentPosition;
+in vec2 TexCoords;
+
+layout (location = 0) out vec4 AlbedoSpecular; // RGBA8: albedo, specular
+layout (location = 1) out vec2 PackedNormal;   // RG16: octahedral normal in 0..1
+
+struct Material {
+    sampler2D diffuseMap; // rgb diffuse, a specular (material_pack.h)
+    float shininess;
+};
+
+uniform Material material;
+
+// Folds the unit sphere onto an octahedron and that onto the [-1, 1]
+// square, lower half mirrored over the diagonals
+vec2 OctahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0f) {
+        vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        n.xy = (1.0f - abs(n.yx)) * signs;
+    }
+    return n.xy;
+}
+
+void main()
+{
+    AlbedoSpecular = texture(material.diffuseMap, TexCoords);
+    PackedNormal = OctahedralEncode(normalize(Normal)) * 0.5f + 0.5f;
+};
@@ -0,0 +1,298 @@
+#include "gl_state.h"
+
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+enum GLStateBufferSlot {
+    GL_STATE_BUFFER_ARRAY,
+    GL_STATE_BUFFER_UNIFORM,
+    GL_STATE_BUFFER_PIXEL_UNPACK,
+    GL_STATE_BUFFER_PIXEL_PACK,
+    GL_STATE_BUFFER_COPY_READ,
+    GL_STATE_BUFFER_COPY_WRITE,
+    GL_STATE_BUFFER_TEXTURE,
+    GL_STATE_BUFFER_SLOT_COUNT
+};
+
+enum GLStateTextureSlot {
+    GL_STATE_TEXTURE_2D,
+    GL_STATE_TEXTURE_2D_ARRAY,
+    GL_STATE_TEXTURE_3D,
+    GL_STATE_TEXTURE_CUBE_MAP,
+    GL_STATE_TEXTURE_BUFFER,
+    GL_STATE_TEXTURE_SLOT_COUNT
+};
+
+struct GLState {
+    uint32_t program;
+    uint32_t vertexArray;
+    uint32_t drawFramebuffer;
+    uint32_t readFramebuffer;
+    uint32_t buffers[GL_STATE_BUFFER_SLOT_COUNT];
+    uint32_t activeUnit;
+    uint32_t textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_SLOT_COUNT];
+    uint32_t samplers[GL_STATE_TEXTURE_UNITS];
+    uint32_t capsKnown; // bit per cap in GLStateCapBit
+    uint32_t capsEnabled;
+    GLStateCounters counters;
+};
+
+// Zeroed state is what a freshly created context starts with, apart from
+// the enable bits which start out unknown
+static GLState glState;
+
+static int GLStateBufferSlotOf(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER: return GL_STATE_BUFFER_ARRAY;
+    case GL_UNIFORM_BUFFER: return GL_STATE_BUFFER_UNIFORM;
+    case GL_PIXEL_UNPACK_BUFFER: return GL_STATE_BUFFER_PIXEL_UNPACK;
+    case GL_PIXEL_PACK_BUFFER: return GL_STATE_BUFFER_PIXEL_PACK;
+    case GL_COPY_READ_BUFFER: return GL_STATE_BUFFER_COPY_READ;
+    case GL_COPY_WRITE_BUFFER: return GL_STATE_BUFFER_COPY_WRITE;
+    case GL_TEXTURE_BUFFER: return GL_STATE_BUFFER_TEXTURE;
+    default: return -1; // GL_ELEMENT_ARRAY_BUFFER is vertex array state
+    }
+}
+
+static int GLStateTextureSlotOf(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return GL_STATE_TEXTURE_2D;
+    case GL_TEXTURE_2D_ARRAY: return GL_STATE_TEXTURE_2D_ARRAY;
+    case GL_TEXTURE_3D: return GL_STATE_TEXTURE_3D;
+    case GL_TEXTURE_CUBE_MAP: return GL_STATE_TEXTURE_CUBE_MAP;
+    case GL_TEXTURE_BUFFER: return GL_STATE_TEXTURE_BUFFER;
+    default: return -1;
+    }
+}
+
+static uint32_t GLStateCapBit(GLenum cap) {
+    switch (cap) {
+    case GL_DEPTH_TEST: return 1u << 0;
+    case GL_CULL_FACE: return 1u << 1;
+    case GL_BLEND: return 1u << 2;
+    case GL_SCISSOR_TEST: return 1u << 3;
+    case GL_STENCIL_TEST: return 1u << 4;
+    case GL_POLYGON_OFFSET_FILL: return 1u << 5;
+    case GL_FRAMEBUFFER_SRGB: return 1u << 6;
+    case GL_MULTISAMPLE: return 1u << 7;
+    default: return 0;
+    }
+}
+
+// Returns true when the caller has to forward the call
+static bool GLStateUpdate(uint32_t &cached, uint32_t value) {
+    if (cached == value) {
+        glState.counters.elided++;
+        return false;
+    }
+    cached = value;
+    glState.counters.issued++;
+    return true;
+}
+
+void GLStateInvalidate() {
+    glState.program = GL_STATE_UNKNOWN;
+    glState.vertexArray = GL_STATE_UNKNOWN;
+    glState.drawFramebuffer = GL_STATE_UNKNOWN;
+    glState.readFramebuffer = GL_STATE_UNKNOWN;
+    for (uint32_t &buffer : glState.buffers) {
+        buffer = GL_STATE_UNKNOWN;
+    }
+    glState.activeUnit = GL_STATE_UNKNOWN;
+    for (auto &unit : glState.textures) {
+        for (uint32_t &texture : unit) {
+            texture = GL_STATE_UNKNOWN;
+        }
+    }
+    for (uint32_t &sampler : glState.samplers) {
+        sampler = GL_STATE_UNKNOWN;
+    }
+    glState.capsKnown = 0;
+    glState.capsEnabled = 0;
+}
+
+void GLStateResetCounters() {
+    glState.counters = {};
+}
+
+GLStateCounters GLStateGetCounters() {
+    return glState.counters;
+}
+
+void GLStateUseProgram(uint32_t program) {
+    if (GLStateUpdate(glState.program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLStateBindVertexArray(uint32_t vertexArray) {
+    if (GLStateUpdate(glState.vertexArray, vertexArray)) {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void GLStateBindFramebuffer(GLenum target, uint32_t framebuffer) {
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    if ((!draw || glState.drawFramebuffer == framebuffer) && (!read || glState.readFramebuffer == framebuffer)) {
+        glState.counters.elided++;
+        return;
+    }
+    if (draw) {
+        glState.drawFramebuffer = framebuffer;
+    }
+    if (read) {
+        glState.readFramebuffer = framebuffer;
+    }
+    glState.counters.issued++;
+    glBindFramebuffer(target, framebuffer);
+}
+
+void GLStateBindBuffer(GLenum target, uint32_t buffer) {
+    int slot = GLStateBufferSlotOf(target);
+    if (slot < 0) {
+        glState.counters.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (GLStateUpdate(glState.buffers[slot], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+// Indexed binds are always forwarded, but they also replace the generic
+// binding point, which the cache has to follow
+void GLStateBindBufferBase(GLenum target, uint32_t index, uint32_t buffer) {
+    int slot = GLStateBufferSlotOf(target);
+    if (slot >= 0) {
+        glState.buffers[slot] = buffer;
+    }
+    glState.counters.issued++;
+    glBindBufferBase(target, index, buffer);
+}
+
+static void GLStateActiveTexture(uint32_t unit) {
+    if (glState.activeUnit != unit) {
+        glState.activeUnit = unit;
+        glState.counters.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void GLStateBindTexture(uint32_t unit, GLenum target, uint32_t texture) {
+    int slot = GLStateTextureSlotOf(target);
+    if (slot >= 0 && unit < GL_STATE_TEXTURE_UNITS && glState.textures[unit][slot] == texture) {
+        glState.counters.elided++;
+        return;
+    }
+
+    GLStateActiveTexture(unit);
+    if (slot >= 0 && unit < GL_STATE_TEXTURE_UNITS) {
+        glState.textures[unit][slot] = texture;
+    }
+    glState.counters.issued++;
+    glBindTexture(target, texture);
+}
+
+// glTex* calls act on the active unit, so it is selected even when the bind
+// itself is elided
+void GLStateBindTextureForEdit(uint32_t unit, GLenum target, uint32_t texture) {
+    GLStateActiveTexture(unit);
+    GLStateBindTexture(unit, target, texture);
+}
+
+void GLStateBindSampler(uint32_t unit, uint32_t sampler) {
+    if (unit >= GL_STATE_TEXTURE_UNITS) {
+        glState.counters.issued++;
+        glBindSampler(unit, sampler);
+        return;
+    }
+    if (GLStateUpdate(glState.samplers[unit], sampler)) {
+        glBindSampler(unit, sampler);
+    }
+}
+
+void GLStateEnable(GLenum cap) {
+    uint32_t bit = GLStateCapBit(cap);
+    if (bit && (glState.capsKnown & bit) && (glState.capsEnabled & bit)) {
+        glState.counters.elided++;
+        return;
+    }
+    glState.capsKnown |= bit;
+    glState.capsEnabled |= bit;
+    glState.counters.issued++;
+    glEnable(cap);
+}
+
+void GLStateDisable(GLenum cap) {
+    uint32_t bit = GLStateCapBit(cap);
+    if (bit && (glState.capsKnown & bit) && !(glState.capsEnabled & bit)) {
+        glState.counters.elided++;
+        return;
+    }
+    glState.capsKnown |= bit;
+    glState.capsEnabled &= ~bit;
+    glState.counters.issued++;
+    glDisable(cap);
+}
+
+void GLStateDeleteProgram(uint32_t program) {
+    // A program that is in use stays alive until it is replaced, so the
+    // binding remains valid and the cache can keep it
+    glDeleteProgram(program);
+}
+
+void GLStateDeleteVertexArrays(GLsizei count, const uint32_t *vertexArrays) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (glState.vertexArray == vertexArrays[i]) {
+            glState.vertexArray = 0;
+        }
+    }
+    glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLStateDeleteFramebuffers(GLsizei count, const uint32_t *framebuffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (glState.drawFramebuffer == framebuffers[i]) {
+            glState.drawFramebuffer = 0;
+        }
+        if (glState.readFramebuffer == framebuffers[i]) {
+            glState.readFramebuffer = 0;
+        }
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+void GLStateDeleteBuffers(GLsizei count, const uint32_t *buffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (uint32_t &buffer : glState.buffers) {
+            if (buffer == buffers[i]) {
+                buffer = 0;
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void GLStateDeleteTextures(GLsizei count, const uint32_t *textures) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (auto &unit : glState.textures) {
+            for (uint32_t &texture : unit) {
+                if (texture == textures[i]) {
+                    texture = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void GLStateDeleteSamplers(GLsizei count, const uint32_t *samplers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (uint32_t &sampler : glState.samplers) {
+            if (sampler == samplers[i]) {
+                sampler = 0;
+            }
+        }
+    }
+    glDeleteSamplers(count, samplers);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <glad/glad.h>
+
+// GL state cache
+// Sits between the renderer and the glad entry points, remembers the bound
+// program, vertex array, framebuffer, buffers, textures and samplers per
+// unit and enable bits, and only forwards calls that change something. Everything
+// starts out unknown, so the first call after GLStateInvalidate always
+// goes through. Code that binds behind the cache's back must call
+// GLStateInvalidate afterwards.
+// -------------------------------------
+#define GL_STATE_TEXTURE_UNITS 16
+
+struct GLStateCounters {
+    uint32_t issued; // calls forwarded to GL
+    uint32_t elided; // calls dropped because nothing changed
+};
+
+void GLStateInvalidate();
+void GLStateResetCounters();
+GLStateCounters GLStateGetCounters();
+
+void GLStateUseProgram(uint32_t program);
+void GLStateBindVertexArray(uint32_t vertexArray);
+void GLStateBindFramebuffer(GLenum target, uint32_t framebuffer);
+void GLStateBindBuffer(GLenum target, uint32_t buffer);
+void GLStateBindBufferBase(GLenum target, uint32_t index, uint32_t buffer);
+// Selects `unit` only if the bound texture actually has to change, a cache
+// hit leaves whichever unit was active selected. Only for binds to sample.
+void GLStateBindTexture(uint32_t unit, GLenum target, uint32_t texture);
+// For binds followed by glTex* calls, `unit` is always left active
+void GLStateBindTextureForEdit(uint32_t unit, GLenum target, uint32_t texture);
+// Sampler binds name their unit, no glActiveTexture needed
+void GLStateBindSampler(uint32_t unit, uint32_t sampler);
+void GLStateEnable(GLenum cap);
+void GLStateDisable(GLenum cap);
+
+// Deleting an object unbinds it in GL, so the cache has to forget it too
+void GLStateDeleteProgram(uint32_t program);
+void GLStateDeleteVertexArrays(GLsizei count, const uint32_t *vertexArrays);
+void GLStateDeleteFramebuffers(GLsizei count, const uint32_t *framebuffers);
+void GLStateDeleteBuffers(GLsizei count, const uint32_t *buffers);
+void GLStateDeleteTextures(GLsizei count, const uint32_t *textures);
+void GLStateDeleteSamplers(GLsizei count, const uint32_t *samplers);
@@ -0,0 +1,261 @@
+#include "image_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#define IMAGE_CACHE_INDEX IMAGE_CACHE_DIR "/index"
+
+static_assert(sizeof(ImageCacheHeader) <= IMAGE_CACHE_DATA_OFFSET, "the header fits in front of the pixels");
+
+static std::string ImageCacheBlobPath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.img", (unsigned long long)key);
+    return std::string(IMAGE_CACHE_DIR) + "/" + name;
+}
+
+static uint64_t ImageCacheHash(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void ImageCacheEvict(ImageCache &c);
+
+// Index
+// One line per source: hash, size, mtime, then the path up to the end of
+// the line
+// ---------------------------
+void ImageCacheInit(ImageCache &c, bool enabled, uint64_t budget) {
+    c.enabled = enabled;
+    c.budget = budget;
+    c.sources.clear();
+    c.indexDirty = false;
+    c.stats = {};
+    if (!enabled) {
+        return;
+    }
+    std::ifstream file(IMAGE_CACHE_INDEX);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        ImageCacheSource source;
+        std::string path;
+        fields >> std::hex >> source.hash >> std::dec >> source.size >> source.mtime;
+        fields.get();
+        std::getline(fields, path);
+        if (fields && !path.empty()) {
+            c.sources[path] = source;
+        }
+    }
+    // The budget may have shrunk since the last run
+    ImageCacheEvict(c);
+}
+
+void ImageCacheShutdown(ImageCache &c) {
+    if (!c.enabled || !c.indexDirty) {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(IMAGE_CACHE_DIR, ec);
+    std::ofstream file(IMAGE_CACHE_INDEX, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Cannot write " << IMAGE_CACHE_INDEX << std::endl;
+        return;
+    }
+    for (const auto &entry : c.sources) {
+        file << std::hex << entry.second.hash << std::dec << " " << entry.second.size << " "
+             << entry.second.mtime << " " << entry.first << "\n";
+    }
+    c.indexDirty = false;
+}
+
+// Content hash of `path`, read only when its size or mtime moved since the
+// index last saw it. Returns false when it can't be read.
+// ---------------------------
+static bool ImageCacheSourceHash(ImageCache &c, const char *path, uint64_t &hash) {
+    std::error_code ec;
+    uint64_t size = (uint64_t)std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    int64_t mtime = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(c.mutex);
+        auto found = c.sources.find(path);
+        if (found != c.sources.end() && found->second.size == size && found->second.mtime == mtime) {
+            hash = found->second.hash;
+            return true;
+        }
+    }
+
+    MappedFile file;
+    if (!MappedFileOpen(file, path)) {
+        return false;
+    }
+    hash = ImageCacheHash(14695981039346656037ull, file.data, file.size);
+    MappedFileClose(file);
+
+    std::lock_guard<std::mutex> lock(c.mutex);
+    c.sources[path] = { size, mtime, hash };
+    c.indexDirty = true;
+    c.stats.sourcesHashed++;
+    return true;
+}
+
+uint64_t ImageCacheKey(ImageCache &c, const char *const *sources, uint32_t sourceCount, const char *recipe) {
+    if (!c.enabled) {
+        return 0;
+    }
+    uint32_t version = IMAGE_CACHE_VERSION;
+    uint64_t key = ImageCacheHash(14695981039346656037ull, (const uint8_t *)&version, sizeof(version));
+    key = ImageCacheHash(key, (const uint8_t *)recipe, strlen(recipe) + 1);
+    for (uint32_t i = 0; i < sourceCount; ++i) {
+        uint64_t hash;
+        if (!ImageCacheSourceHash(c, sources[i], hash)) {
+            return 0;
+        }
+        key = ImageCacheHash(key, (const uint8_t *)&hash, sizeof(hash));
+    }
+    return key != 0 ? key : 1;
+}
+
+bool ImageCacheOpen(ImageCache &c, uint64_t key, ImageCacheImage &image) {
+    image = {};
+    if (key == 0) {
+        return false;
+    }
+    auto openStart = std::chrono::steady_clock::now();
+    std::string path = ImageCacheBlobPath(key);
+    bool valid = MappedFileOpen(image.file, path.c_str());
+    const ImageCacheHeader *header = (const ImageCacheHeader *)image.file.data;
+    valid = valid && image.file.size >= IMAGE_CACHE_DATA_OFFSET &&
+            header->magic == IMAGE_CACHE_MAGIC && header->version == IMAGE_CACHE_VERSION && header->key == key &&
+            header->channels >= 1 && header->channels <= 4 &&
+            image.file.size == IMAGE_CACHE_DATA_OFFSET + (uint64_t)header->width * header->height * header->channels;
+
+    std::lock_guard<std::mutex> lock(c.mutex);
+    if (!valid) {
+        MappedFileClose(image.file);
+        c.stats.misses++;
+        return false;
+    }
+    image.pixels = image.file.data + IMAGE_CACHE_DATA_OFFSET;
+    image.width = (int)header->width;
+    image.height = (int)header->height;
+    image.channels = (int)header->channels;
+
+    // Recently used as far as eviction is concerned
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+    double openMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - openStart).count();
+    c.stats.hits++;
+    c.stats.bytesMapped += image.file.size;
+    c.stats.savedMs += header->decodeMs - openMs;
+    return true;
+}
+
+void ImageCacheClose(ImageCacheImage &image) {
+    MappedFileClose(image.file);
+    image = {};
+}
+
+// Oldest blobs go first until the rest fit. Called with the lock held or
+// before any other thread can see the cache.
+// ---------------------------
+static void ImageCacheEvict(ImageCache &c) {
+    struct Blob {
+        std::filesystem::path path;
+        uint64_t size;
+        std::filesystem::file_time_type lastUse;
+    };
+    std::vector<Blob> blobs;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(IMAGE_CACHE_DIR, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".img") {
+            continue;
+        }
+        std::error_code entryError;
+        Blob blob{ entry.path(), (uint64_t)entry.file_size(entryError), entry.last_write_time(entryError) };
+        if (!entryError) {
+            blobs.push_back(blob);
+            total += blob.size;
+        }
+    }
+    if (total <= c.budget) {
+        return;
+    }
+    std::sort(blobs.begin(), blobs.end(), [](const Blob &a, const Blob &b) { return a.lastUse < b.lastUse; });
+    for (const Blob &blob : blobs) {
+        if (total <= c.budget) {
+            break;
+        }
+        // Fails on Windows while another thread still maps it, it goes next time
+        if (std::filesystem::remove(blob.path, ec)) {
+            total -= blob.size;
+            c.stats.evictions++;
+            c.stats.bytesEvicted += blob.size;
+        }
+    }
+}
+
+// Written under a temporary name and renamed, so a blob is never seen
+// half written
+// ---------------------------
+void ImageCacheStore(ImageCache &c, uint64_t key, const uint8_t *pixels, int width, int height, int channels,
+                     double decodeMs) {
+    if (key == 0 || !pixels) {
+        return;
+    }
+    std::string path = ImageCacheBlobPath(key);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::string temporary = path + suffix;
+
+    std::error_code ec;
+    std::filesystem::create_directories(IMAGE_CACHE_DIR, ec);
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        ImageCacheHeader header{ IMAGE_CACHE_MAGIC, IMAGE_CACHE_VERSION, key, (uint32_t)width, (uint32_t)height,
+                                 (uint32_t)channels, 0, decodeMs };
+        const char zeros[IMAGE_CACHE_DATA_OFFSET] = {};
+        file.write((const char *)&header, sizeof(header));
+        file.write(zeros, IMAGE_CACHE_DATA_OFFSET - sizeof(header));
+        file.write((const char *)pixels, (std::streamsize)((size_t)width * height * channels));
+        if (!file) {
+            std::cerr << "Cannot write " << temporary << std::endl;
+            file.close();
+            std::filesystem::remove(temporary, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(c.mutex);
+    c.stats.stores++;
+    ImageCacheEvict(c);
+}
+
+ImageCacheStats ImageCacheGetStats(ImageCache &c) {
+    std::lock_guard<std::mutex> lock(c.mutex);
+    return c.stats;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+
+#include "mapped_file.h"
+
+// Decoded image cache
+// Images the runtime has to decode (no cooked texture, see
+// cooked_texture.h) are kept in IMAGE_CACHE_DIR as raw pixel blobs, so the
+// next start maps them instead of running stb_image again. A blob is named
+// after its key: a 64 bit hash of the source files' contents and of how
+// they were decoded. Hashing a source means reading it, so the index file
+// remembers the hash of every source together with its size and mtime,
+// and a source whose size and mtime still match is not read again. A
+// source that changed gets a new key and misses; one that was only
+// touched hashes to the same key and still hits.
+// Blobs past the size budget are deleted least recently used first. Hits
+// refresh a blob's mtime, which is what the eviction goes by.
+// Safe to use from the decode jobs of several threads at once.
+// -------------------------------------
+#define IMAGE_CACHE_DIR "./image_cache"
+#define IMAGE_CACHE_MAGIC 0x474D4943u // "CIMG"
+#define IMAGE_CACHE_VERSION 1
+#define IMAGE_CACHE_BUDGET (256ull * 1024ull * 1024ull)
+#define IMAGE_CACHE_DATA_OFFSET 64 // pixels start here in a blob
+
+struct ImageCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t reserved;
+    double decodeMs; // what decoding cost when the blob was stored
+};
+
+// Size and mtime of a source when it was last hashed
+struct ImageCacheSource {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+};
+
+struct ImageCacheStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stores;
+    uint32_t evictions;
+    uint32_t sourcesHashed; // sources read because size or mtime changed
+    uint64_t bytesMapped;
+    uint64_t bytesEvicted;
+    double savedMs; // decode time the hits didn't spend, less mapping them
+};
+
+struct ImageCache {
+    std::mutex mutex;
+    bool enabled;
+    uint64_t budget;
+    std::unordered_map<std::string, ImageCacheSource> sources; // by path
+    bool indexDirty;
+    ImageCacheStats stats;
+};
+
+struct ImageCacheImage {
+    MappedFile file;
+    const uint8_t *pixels; // tightly packed rows, as they came out of the decoder
+    int width;
+    int height;
+    int channels;
+};
+
+// Reads the index of IMAGE_CACHE_DIR
+void ImageCacheInit(ImageCache &c, bool enabled, uint64_t budget = IMAGE_CACHE_BUDGET);
+// Writes the index back if it changed
+void ImageCacheShutdown(ImageCache &c);
+
+// Key of decoding `sourceCount` files the way `recipe` describes, any
+// string that changes whenever the decoded pixels would. 0 when a source
+// can't be read.
+uint64_t ImageCacheKey(ImageCache &c, const char *const *sources, uint32_t sourceCount, const char *recipe);
+// Maps the blob of `key`, counting a hit or a miss
+bool ImageCacheOpen(ImageCache &c, uint64_t key, ImageCacheImage &image);
+void ImageCacheClose(ImageCacheImage &image);
+// Writes a blob for `key`, then evicts down to the budget
+void ImageCacheStore(ImageCache &c, uint64_t key, const uint8_t *pixels, int width, int height, int channels,
+                     double decodeMs);
+
+ImageCacheStats ImageCacheGetStats(ImageCache &c);
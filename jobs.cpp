@@ -0,0 +1,371 @@
+#include "jobs.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Set on worker threads only, everyone else submits to the injection queue
+static thread_local JobPool *jobWorkerPool = nullptr;
+static thread_local uint32_t jobWorkerIndex = 0;
+
+static uint32_t JobQueueIndex(const JobPool &pool) {
+    return jobWorkerPool == &pool ? jobWorkerIndex : (uint32_t)pool.queues.size() - 1;
+}
+
+static void JobPush(JobPool &pool, Job job, bool background = false) {
+    // Counted before the push so `queued` never underflows. Pairs with the
+    // sleeping increment in JobPoolWorker: either the worker sees the job
+    // or we see the sleeper.
+    pool.queued.fetch_add(1);
+    JobQueue &q = background ? pool.background : *pool.queues[JobQueueIndex(pool)];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.jobs.push_back(std::move(job));
+    }
+    if (pool.sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(pool.sleepMutex);
+        pool.wake.notify_one();
+    }
+}
+
+static bool JobPopFrom(JobPool &pool, JobQueue &q, bool back, Job &job) {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.jobs.empty()) {
+        return false;
+    }
+    if (back) {
+        job = std::move(q.jobs.back());
+        q.jobs.pop_back();
+    } else {
+        job = std::move(q.jobs.front());
+        q.jobs.pop_front();
+    }
+    pool.queued.fetch_sub(1);
+    return true;
+}
+
+// Own deque newest first, then the injection queue and the other workers
+// oldest first, starting next to `self` so thieves spread out. The
+// background queue comes last, for callers that aren't waiting.
+static bool JobPop(JobPool &pool, uint32_t self, bool background, Job &job) {
+    if (pool.queued.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    const uint32_t queueCount = (uint32_t)pool.queues.size();
+    const uint32_t injection = queueCount - 1;
+    if (JobPopFrom(pool, *pool.queues[self], self != injection, job)) {
+        return true;
+    }
+    for (uint32_t k = 1; k < queueCount; ++k) {
+        uint32_t victim = (self + k) % queueCount;
+        if (JobPopFrom(pool, *pool.queues[victim], false, job)) {
+            if (victim != injection) {
+                pool.steals.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+    }
+    return background && JobPopFrom(pool, pool.background, false, job);
+}
+
+static void JobCounterDone(JobPool &pool, JobCounter &counter) {
+    // Counts above one drop without the lock. The final decrement happens
+    // under it, so a waiter that sees zero and then takes the lock knows
+    // the counter is no longer touched.
+    uint32_t n = counter.pending.load();
+    while (n > 1 && !counter.pending.compare_exchange_weak(n, n - 1)) {
+    }
+    if (n > 1) {
+        return;
+    }
+
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        if (counter.pending.fetch_sub(1) == 1) {
+            ready.swap(counter.continuations);
+        }
+    }
+    for (Job &job : ready) {
+        JobPush(pool, std::move(job));
+    }
+}
+
+static void JobRun(JobPool &pool, Job &job) {
+    job.fn();
+    if (job.counter) {
+        JobCounterDone(pool, *job.counter);
+    }
+}
+
+static void JobPoolWorker(JobPool *pool, uint32_t index) {
+    jobWorkerPool = pool;
+    jobWorkerIndex = index;
+    uint32_t idle = 0;
+    for (;;) {
+        Job job;
+        if (JobPop(*pool, index, true, job)) {
+            JobRun(*pool, job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOB_SPIN_TRIES) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        idle = 0;
+        std::unique_lock<std::mutex> lock(pool->sleepMutex);
+        if (pool->quit.load() && pool->queued.load() == 0) {
+            return;
+        }
+        pool->sleeping.fetch_add(1);
+        pool->wake.wait(lock, [pool] { return pool->quit.load() || pool->queued.load() > 0; });
+        pool->sleeping.fetch_sub(1);
+    }
+}
+
+static void JobPinThread(std::thread &thread, uint32_t cpu) {
+    cpu %= std::max(std::thread::hardware_concurrency(), 1u);
+#if defined(_WIN32)
+    SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << (cpu % 64));
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    (void)thread;
+#endif
+}
+
+void JobPoolInit(JobPool &pool, uint32_t threadCount, bool pinThreads) {
+    if (threadCount == 0) {
+        uint32_t hardware = std::thread::hardware_concurrency();
+        threadCount = hardware > 1 ? hardware - 1 : 1;
+    }
+    pool.quit = false;
+    pool.queues.clear();
+    for (uint32_t i = 0; i <= threadCount; ++i) {
+        pool.queues.push_back(std::make_unique<JobQueue>());
+    }
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        pool.workers.emplace_back(JobPoolWorker, &pool, i);
+        if (pinThreads) {
+            JobPinThread(pool.workers.back(), i + 1);
+        }
+    }
+}
+
+void JobPoolSubmit(JobPool &pool, std::function<void()> job, JobCounter *counter) {
+    if (pool.workers.empty()) {
+        job();
+        return;
+    }
+    if (counter) {
+        counter->pending.fetch_add(1);
+    }
+    JobPush(pool, Job{ std::move(job), counter });
+}
+
+void JobPoolSubmitBackground(JobPool &pool, std::function<void()> job, JobCounter *counter) {
+    if (pool.workers.empty()) {
+        job();
+        return;
+    }
+    if (counter) {
+        counter->pending.fetch_add(1);
+    }
+    JobPush(pool, Job{ std::move(job), counter }, true);
+}
+
+void JobPoolSubmitAfter(JobPool &pool, JobCounter &dependency, std::function<void()> job, JobCounter *counter) {
+    if (pool.workers.empty()) {
+        job(); // everything before it already ran inline
+        return;
+    }
+    if (counter) {
+        counter->pending.fetch_add(1);
+    }
+    Job j{ std::move(job), counter };
+    {
+        // The count only reaches zero under this lock, see JobCounterDone
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (dependency.pending.load() > 0) {
+            dependency.continuations.push_back(std::move(j));
+            return;
+        }
+    }
+    JobPush(pool, std::move(j));
+}
+
+void JobPoolWait(JobPool &pool, JobCounter &counter) {
+    if (pool.queues.empty()) {
+        return;
+    }
+    uint32_t self = JobQueueIndex(pool);
+    while (counter.pending.load() > 0) {
+        Job job;
+        if (JobPop(pool, self, false, job)) {
+            JobRun(pool, job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    // The job that took the count to zero may still hold the lock
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobPoolParallelFor(JobPool &pool, uint32_t count, const std::function<void(uint32_t)> &fn) {
+    std::atomic<uint32_t> next{0};
+    auto work = [&] {
+        for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            fn(i);
+        }
+    };
+
+    // Everyone claims indices from one counter, so uneven items balance
+    // out. The helpers reference this stack frame, hence the wait on all
+    // of them and not just on the last index.
+    JobCounter helpersDone;
+    uint32_t helpers = std::min<uint32_t>((uint32_t)pool.workers.size(), count > 0 ? count - 1 : 0);
+    for (uint32_t i = 0; i < helpers; ++i) {
+        JobPoolSubmit(pool, work, &helpersDone);
+    }
+    work();
+    JobPoolWait(pool, helpersDone);
+}
+
+void JobPoolShutdown(JobPool &pool) {
+    {
+        std::lock_guard<std::mutex> lock(pool.sleepMutex);
+        pool.quit = true;
+    }
+    pool.wake.notify_all();
+    for (std::thread &worker : pool.workers) {
+        worker.join();
+    }
+    pool.workers.clear();
+    pool.queues.clear();
+}
+
+// Benchmark
+// ---------------------------
+static double JobElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A few microseconds of arithmetic the compiler cannot drop
+static float JobBusyWork(uint32_t item) {
+    float x = (float)item * 0.001f;
+    for (int i = 0; i < 2000; ++i) {
+        x = x * 0.9999f + std::sqrt(x + 1.0f) * 0.0001f;
+    }
+    return x;
+}
+
+void JobBenchmark(bool pinThreads) {
+    const uint32_t hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    JobPool pool;
+    JobPoolInit(pool, 0, pinThreads);
+    std::cout << "jobs: " << pool.workers.size() << " workers + main thread"
+              << (pinThreads ? ", pinned" : "") << std::endl;
+
+    // Empty jobs submitted from the main thread through the injection queue
+    const uint32_t taskCount = 1000000;
+    {
+        JobCounter counter;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < taskCount; ++i) {
+            JobPoolSubmit(pool, [] {}, &counter);
+        }
+        JobPoolWait(pool, counter);
+        double ms = JobElapsedMs(start);
+        std::cout << "  " << taskCount << " empty jobs from main:    " << ms * 1.0e6 / taskCount << " ns/job" << std::endl;
+    }
+
+    // Jobs spawning jobs, which land on the workers' own deques and have to
+    // be stolen to spread out
+    {
+        const uint32_t roots = 64;
+        const uint32_t children = taskCount / roots;
+        JobCounter counter;
+        uint64_t stealsBefore = pool.steals.load();
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < roots; ++r) {
+            JobPoolSubmit(pool, [&pool, &counter, children] {
+                for (uint32_t c = 0; c < children; ++c) {
+                    JobPoolSubmit(pool, [] {}, &counter);
+                }
+            }, &counter);
+        }
+        JobPoolWait(pool, counter);
+        double ms = JobElapsedMs(start);
+        std::cout << "  " << roots * children << " empty jobs from jobs:    " << ms * 1.0e6 / (roots * children)
+                  << " ns/job, " << pool.steals.load() - stealsBefore << " steals" << std::endl;
+    }
+
+    // A chain where every job waits for the previous one, i.e. the latency
+    // from one job finishing to its dependent starting
+    {
+        const uint32_t links = 100000;
+        std::unique_ptr<JobCounter[]> counters(new JobCounter[links]);
+        uint32_t order = 0;
+        bool inOrder = true;
+        auto start = std::chrono::steady_clock::now();
+        JobPoolSubmit(pool, [&order] { order++; }, &counters[0]);
+        for (uint32_t i = 1; i < links; ++i) {
+            JobPoolSubmitAfter(pool, counters[i - 1], [&order, &inOrder, i] {
+                inOrder = inOrder && order == i;
+                order++;
+            }, &counters[i]);
+        }
+        JobPoolWait(pool, counters[links - 1]);
+        double ms = JobElapsedMs(start);
+        std::cout << "  " << links << " job dependency chain:  " << ms * 1.0e6 / links << " ns/link"
+                  << (inOrder ? "" : " (OUT OF ORDER)") << std::endl;
+    }
+    JobPoolShutdown(pool);
+
+    // Parallel for over a compute bound loop, 1 thread up to the hardware
+    const uint32_t items = 8192;
+    std::vector<float> results(items);
+    double baseMs = 0.0;
+    float reference = 0.0f;
+    for (uint32_t threads = 1; ; threads = std::min(threads * 2, hardware)) {
+        JobPool scaling;
+        if (threads > 1) {
+            JobPoolInit(scaling, threads - 1, pinThreads);
+        }
+        auto start = std::chrono::steady_clock::now();
+        JobPoolParallelFor(scaling, items, [&results](uint32_t i) {
+            results[i] = JobBusyWork(i);
+        });
+        double ms = JobElapsedMs(start);
+        JobPoolShutdown(scaling);
+
+        float sum = 0.0f;
+        for (float r : results) {
+            sum += r;
+        }
+        if (threads == 1) {
+            baseMs = ms;
+            reference = sum;
+        }
+        std::cout << "  parallel for, " << threads << " thread(s): " << ms << " ms, speedup "
+                  << baseMs / ms << "x" << (sum == reference ? "" : " (MISMATCH)") << std::endl;
+        if (threads == hardware) {
+            break;
+        }
+    }
+}
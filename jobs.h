@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Job pool
+// Work stealing scheduler. Every worker owns a deque: jobs it submits go
+// to the back and it pops them from the back again while they are still
+// in cache, idle workers steal from the front of the others. Threads that
+// are not workers submit to a shared injection queue. Waiting on a counter
+// runs queued jobs instead of blocking, so the main thread joins in while
+// it waits and a job can wait on jobs it spawned.
+// Long jobs nobody waits on (texture decodes) go to a background queue
+// instead. Only workers with nothing else to do take from it, a thread
+// that waits never does, so a frame waiting on a parallel for can't end up
+// running a whole decode.
+// Jobs must not touch GL, the context belongs to the main thread.
+// -------------------------------------
+#define JOB_SPIN_TRIES 64 // failed steal rounds before a worker sleeps
+
+struct JobCounter;
+
+struct Job {
+    std::function<void()> fn;
+    JobCounter *counter; // signalled once fn returns, may be null
+};
+
+// Counts the unfinished jobs submitted with it. Jobs submitted with
+// JobPoolSubmitAfter are held here until the count drops to zero.
+struct JobCounter {
+    std::atomic<uint32_t> pending{0};
+    std::mutex mutex;
+    std::vector<Job> continuations;
+};
+
+struct JobQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+};
+
+struct JobPool {
+    std::vector<std::thread> workers;
+    // One deque per worker, followed by the injection queue
+    std::vector<std::unique_ptr<JobQueue>> queues;
+    JobQueue background;
+    std::atomic<uint32_t> queued{0}; // jobs sitting in any of the queues, background included
+    std::atomic<uint32_t> sleeping{0};
+    std::atomic<bool> quit{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    std::atomic<uint64_t> steals{0};
+};
+
+// threadCount 0 picks one worker per hardware thread minus the main thread.
+// pinThreads binds worker i to logical CPU i + 1, leaving CPU 0 to the
+// main thread.
+void JobPoolInit(JobPool &pool, uint32_t threadCount = 0, bool pinThreads = false);
+// Queues `job`, counted on `counter` when given. A pool without workers
+// runs it inline.
+void JobPoolSubmit(JobPool &pool, std::function<void()> job, JobCounter *counter = nullptr);
+// Queues `job` on the background queue, run oldest first by idle workers
+void JobPoolSubmitBackground(JobPool &pool, std::function<void()> job, JobCounter *counter = nullptr);
+// Queues `job` once every job counted on `dependency` so far has finished
+void JobPoolSubmitAfter(JobPool &pool, JobCounter &dependency, std::function<void()> job, JobCounter *counter = nullptr);
+// Runs queued jobs on the calling thread until `counter` reaches zero,
+// never background ones
+void JobPoolWait(JobPool &pool, JobCounter &counter);
+// Runs fn(0..count-1) on the workers and the calling thread, returns once
+// every index has been processed. Safe to call with a pool that has no
+// workers, everything then runs inline.
+void JobPoolParallelFor(JobPool &pool, uint32_t count, const std::function<void(uint32_t)> &fn);
+// Finishes every queued job, then joins the workers
+void JobPoolShutdown(JobPool &pool);
+
+// Task overhead, dependency latency and parallel for scaling
+void JobBenchmark(bool pinThreads);
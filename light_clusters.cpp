@@ -0,0 +1,493 @@
+#include "light_clusters.h"
+#include "cpu_features.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <immintrin.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#define CLUSTER_TILES (CLUSTER_GRID_X * CLUSTER_GRID_Y)
+
+const char *ClusterPathName(ClusterPath path) {
+    switch (path) {
+    case CLUSTER_PATH_SCALAR: return "scalar";
+    case CLUSTER_PATH_AVX: return "avx";
+    default: return "auto";
+    }
+}
+
+ClusterPath ClusterBestPath() {
+    return CpuGetFeatures().avx ? CLUSTER_PATH_AVX : CLUSTER_PATH_SCALAR;
+}
+
+// Cluster bounds
+// ---------------------------
+void LightClustersSetProjection(LightClusters &c, const glm::mat4 &projection, float nearPlane, float farPlane) {
+    float projectionX = projection[0][0];
+    float projectionY = projection[1][1];
+    if (!c.minX.empty() && c.projectionX == projectionX && c.projectionY == projectionY &&
+        c.nearPlane == nearPlane && c.farPlane == farPlane) {
+        return;
+    }
+    c.projectionX = projectionX;
+    c.projectionY = projectionY;
+    c.nearPlane = nearPlane;
+    c.farPlane = farPlane;
+
+    float logRatio = std::log(farPlane / nearPlane);
+    c.depthScale = (float)CLUSTER_GRID_Z / logRatio;
+    c.depthBias = -(float)CLUSTER_GRID_Z * std::log(nearPlane) / logRatio;
+
+    std::vector<float> *arrays[] = { &c.minX, &c.minY, &c.minZ, &c.maxX, &c.maxY, &c.maxZ,
+                                     &c.sphereX, &c.sphereY, &c.sphereZ, &c.sphereRadius };
+    for (std::vector<float> *a : arrays) {
+        a->resize(CLUSTER_COUNT);
+    }
+    c.grid.assign(CLUSTER_COUNT * 2, 0);
+
+    // A view space point at depth d (looking down -z) lands on NDC x =
+    // projectionX * x / d, so the side planes of a tile are x = ndc * d /
+    // projectionX and the box spans them at both ends of the slice
+    for (uint32_t z = 0; z < CLUSTER_GRID_Z; ++z) {
+        float nearDepth = nearPlane * std::pow(farPlane / nearPlane, (float)z / CLUSTER_GRID_Z);
+        float farDepth = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / CLUSTER_GRID_Z);
+        for (uint32_t y = 0; y < CLUSTER_GRID_Y; ++y) {
+            float ndcY0 = -1.0f + 2.0f * (float)y / CLUSTER_GRID_Y;
+            float ndcY1 = -1.0f + 2.0f * (float)(y + 1) / CLUSTER_GRID_Y;
+            for (uint32_t x = 0; x < CLUSTER_GRID_X; ++x) {
+                float ndcX0 = -1.0f + 2.0f * (float)x / CLUSTER_GRID_X;
+                float ndcX1 = -1.0f + 2.0f * (float)(x + 1) / CLUSTER_GRID_X;
+                uint32_t i = x + CLUSTER_GRID_X * (y + CLUSTER_GRID_Y * z);
+
+                glm::vec3 min(std::min(ndcX0 * nearDepth, ndcX0 * farDepth) / projectionX,
+                              std::min(ndcY0 * nearDepth, ndcY0 * farDepth) / projectionY,
+                              -farDepth);
+                glm::vec3 max(std::max(ndcX1 * nearDepth, ndcX1 * farDepth) / projectionX,
+                              std::max(ndcY1 * nearDepth, ndcY1 * farDepth) / projectionY,
+                              -nearDepth);
+                c.minX[i] = min.x;
+                c.minY[i] = min.y;
+                c.minZ[i] = min.z;
+                c.maxX[i] = max.x;
+                c.maxY[i] = max.y;
+                c.maxZ[i] = max.z;
+                glm::vec3 center = (min + max) * 0.5f;
+                c.sphereX[i] = center.x;
+                c.sphereY[i] = center.y;
+                c.sphereZ[i] = center.z;
+                c.sphereRadius[i] = glm::length(max - center);
+            }
+        }
+    }
+}
+
+static uint32_t ClusterSliceOf(const LightClusters &c, float depth) {
+    float slice = std::floor(std::log(std::max(depth, c.nearPlane)) * c.depthScale + c.depthBias);
+    return (uint32_t)std::min(std::max(slice, 0.0f), (float)(CLUSTER_GRID_Z - 1));
+}
+
+// Light tests
+// ---------------------------
+// A light reaches a box when its range sphere touches the box and, for
+// spot lights, the cone of the outer angle touches the box's bounding
+// sphere. The cone test measures how far the sphere center lies outside
+// the cone's side along the direction perpendicular to it; point lights
+// carry cos -1 and no direction, which always passes.
+struct ClusterBox {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius;
+};
+
+static ClusterBox ClusterBoxOf(const LightClusters &c, uint32_t i) {
+    ClusterBox b;
+    b.min = glm::vec3(c.minX[i], c.minY[i], c.minZ[i]);
+    b.max = glm::vec3(c.maxX[i], c.maxY[i], c.maxZ[i]);
+    b.center = glm::vec3(c.sphereX[i], c.sphereY[i], c.sphereZ[i]);
+    b.radius = c.sphereRadius[i];
+    return b;
+}
+
+// Box around a whole row of tiles in one slice
+static ClusterBox ClusterRowBox(const LightClusters &c, uint32_t first) {
+    ClusterBox b = ClusterBoxOf(c, first);
+    for (uint32_t i = first + 1; i < first + CLUSTER_GRID_X; ++i) {
+        b.min = glm::min(b.min, glm::vec3(c.minX[i], c.minY[i], c.minZ[i]));
+        b.max = glm::max(b.max, glm::vec3(c.maxX[i], c.maxY[i], c.maxZ[i]));
+    }
+    b.center = (b.min + b.max) * 0.5f;
+    b.radius = glm::length(b.max - b.center);
+    return b;
+}
+
+// Copies the view space lights named by `lights` into the set's arrays
+static void ClusterGather(const LightClusters &c, ClusterLightSet &set) {
+    uint32_t count = (uint32_t)set.lights.size();
+    uint32_t padded = (count + 7) & ~7u;
+    // Padding lanes have zero range at the camera, outside every cluster
+    std::vector<float> *arrays[] = { &set.x, &set.y, &set.z, &set.range, &set.dirX, &set.dirY, &set.dirZ, &set.coneCos, &set.coneSin };
+    for (std::vector<float> *a : arrays) {
+        a->assign(padded, 0.0f);
+    }
+    for (uint32_t j = 0; j < count; ++j) {
+        const glm::vec4 &light = c.viewLights[set.lights[j]];
+        const glm::vec4 &cone = c.viewCones[set.lights[j]];
+        set.x[j] = light.x;
+        set.y[j] = light.y;
+        set.z[j] = light.z;
+        set.range[j] = light.w;
+        set.dirX[j] = cone.x;
+        set.dirY[j] = cone.y;
+        set.dirZ[j] = cone.z;
+        set.coneCos[j] = cone.w;
+        set.coneSin[j] = std::sqrt(std::max(1.0f - cone.w * cone.w, 0.0f));
+    }
+}
+
+// Appends the lights of `set` reaching `b` to `out`
+static void ClusterTestScalar(const ClusterBox &b, const ClusterLightSet &set, std::vector<uint32_t> &out) {
+    uint32_t count = (uint32_t)set.lights.size();
+    for (uint32_t j = 0; j < count; ++j) {
+        float dx = std::max(std::max(b.min.x - set.x[j], set.x[j] - b.max.x), 0.0f);
+        float dy = std::max(std::max(b.min.y - set.y[j], set.y[j] - b.max.y), 0.0f);
+        float dz = std::max(std::max(b.min.z - set.z[j], set.z[j] - b.max.z), 0.0f);
+        if (dx * dx + dy * dy + dz * dz > set.range[j] * set.range[j]) {
+            continue;
+        }
+
+        float vx = b.center.x - set.x[j];
+        float vy = b.center.y - set.y[j];
+        float vz = b.center.z - set.z[j];
+        float along = vx * set.dirX[j] + vy * set.dirY[j] + vz * set.dirZ[j];
+        float across = std::sqrt(std::max(vx * vx + vy * vy + vz * vz - along * along, 0.0f));
+        float outside = set.coneCos[j] * across - along * set.coneSin[j];
+        if (outside > b.radius || along > b.radius + set.range[j] || along < -b.radius) {
+            continue;
+        }
+        out.push_back(set.lights[j]);
+    }
+}
+
+SIMD_TARGET_AVX
+static void ClusterTestAVX(const ClusterBox &b, const ClusterLightSet &set, std::vector<uint32_t> &out) {
+    uint32_t count = (uint32_t)set.lights.size();
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 minX = _mm256_set1_ps(b.min.x);
+    const __m256 minY = _mm256_set1_ps(b.min.y);
+    const __m256 minZ = _mm256_set1_ps(b.min.z);
+    const __m256 maxX = _mm256_set1_ps(b.max.x);
+    const __m256 maxY = _mm256_set1_ps(b.max.y);
+    const __m256 maxZ = _mm256_set1_ps(b.max.z);
+    const __m256 centerX = _mm256_set1_ps(b.center.x);
+    const __m256 centerY = _mm256_set1_ps(b.center.y);
+    const __m256 centerZ = _mm256_set1_ps(b.center.z);
+    const __m256 radius = _mm256_set1_ps(b.radius);
+    const __m256 minusRadius = _mm256_set1_ps(-b.radius);
+
+    for (uint32_t j = 0; j < count; j += 8) {
+        __m256 x = _mm256_loadu_ps(&set.x[j]);
+        __m256 y = _mm256_loadu_ps(&set.y[j]);
+        __m256 z = _mm256_loadu_ps(&set.z[j]);
+        __m256 range = _mm256_loadu_ps(&set.range[j]);
+
+        __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minX, x), _mm256_sub_ps(x, maxX)), zero);
+        __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minY, y), _mm256_sub_ps(y, maxY)), zero);
+        __m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minZ, z), _mm256_sub_ps(z, maxZ)), zero);
+        __m256 distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        __m256 hit = _mm256_cmp_ps(distance2, _mm256_mul_ps(range, range), _CMP_LE_OQ);
+        if (_mm256_movemask_ps(hit) == 0) {
+            continue;
+        }
+
+        __m256 vx = _mm256_sub_ps(centerX, x);
+        __m256 vy = _mm256_sub_ps(centerY, y);
+        __m256 vz = _mm256_sub_ps(centerZ, z);
+        __m256 along = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, _mm256_loadu_ps(&set.dirX[j])),
+                                                   _mm256_mul_ps(vy, _mm256_loadu_ps(&set.dirY[j]))),
+                                     _mm256_mul_ps(vz, _mm256_loadu_ps(&set.dirZ[j])));
+        __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+        __m256 across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(length2, _mm256_mul_ps(along, along)), zero));
+        __m256 outside = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(&set.coneCos[j]), across),
+                                       _mm256_mul_ps(along, _mm256_loadu_ps(&set.coneSin[j])));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(outside, radius, _CMP_LE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(along, _mm256_add_ps(radius, range), _CMP_LE_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(along, minusRadius, _CMP_GE_OQ));
+
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(hit);
+        for (uint32_t lane = 0; mask != 0; ++lane, mask >>= 1) {
+            if (mask & 1) {
+                out.push_back(set.lights[j + lane]);
+            }
+        }
+    }
+}
+
+static void ClusterTest(const ClusterBox &b, const ClusterLightSet &set, std::vector<uint32_t> &out, ClusterPath path) {
+    if (path == CLUSTER_PATH_AVX) {
+        ClusterTestAVX(b, set, out);
+    } else {
+        ClusterTestScalar(b, set, out);
+    }
+}
+
+// Gathers the lights reaching slice `z`
+static void ClusterGatherSlice(LightClusters &c, uint32_t z) {
+    ClusterLightSet &slice = c.slices[z];
+    slice.lights.clear();
+    uint32_t lightCount = (uint32_t)c.viewLights.size();
+    for (uint32_t i = 0; i < lightCount; ++i) {
+        if (c.firstSlice[i] <= z && z <= c.lastSlice[i]) {
+            slice.lights.push_back(i);
+        }
+    }
+    ClusterGather(c, slice);
+}
+
+// Narrows the slice's lights down to one row of tiles, then tests each
+// tile of the row. Offsets in the grid are relative to the row.
+static void ClusterAssignRow(LightClusters &c, uint32_t row, ClusterPath path) {
+    ClusterRow &r = c.rows[row];
+    const ClusterLightSet &slice = c.slices[row / CLUSTER_GRID_Y];
+    uint32_t first = row * CLUSTER_GRID_X;
+    uint32_t *grid = c.grid.data();
+    r.lights.lights.clear();
+    r.indices.clear();
+    if (!slice.lights.empty()) {
+        ClusterTest(ClusterRowBox(c, first), slice, r.lights.lights, path);
+    }
+    if (r.lights.lights.empty()) {
+        std::fill(grid + first * 2, grid + (first + CLUSTER_GRID_X) * 2, 0);
+        return;
+    }
+
+    ClusterGather(c, r.lights);
+    for (uint32_t i = first; i < first + CLUSTER_GRID_X; ++i) {
+        uint32_t offset = (uint32_t)r.indices.size();
+        ClusterTest(ClusterBoxOf(c, i), r.lights, r.indices, path);
+        grid[i * 2] = offset;
+        grid[i * 2 + 1] = (uint32_t)r.indices.size() - offset;
+    }
+}
+
+uint32_t LightClustersAssign(LightClusters &c, const std::vector<ClusterLight> &lights, const glm::mat4 &view,
+                             JobPool *pool, ClusterPath path) {
+    if (path == CLUSTER_PATH_AUTO) {
+        path = ClusterBestPath();
+    }
+
+    uint32_t lightCount = (uint32_t)lights.size();
+    c.viewLights.resize(lightCount);
+    c.viewCones.resize(lightCount);
+    c.firstSlice.resize(lightCount);
+    c.lastSlice.resize(lightCount);
+    glm::mat3 rotation(view);
+    for (uint32_t i = 0; i < lightCount; ++i) {
+        const ClusterLight &light = lights[i];
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        c.viewLights[i] = glm::vec4(center, light.range);
+        if (light.cosOuter < -1.0f) {
+            c.viewCones[i] = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+        } else {
+            c.viewCones[i] = glm::vec4(rotation * light.direction, light.cosOuter);
+        }
+
+        // Lights entirely in front of the near or behind the far plane get
+        // an empty slice range
+        float nearDepth = -center.z - light.range;
+        float farDepth = -center.z + light.range;
+        if (farDepth < c.nearPlane || nearDepth > c.farPlane) {
+            c.firstSlice[i] = 1;
+            c.lastSlice[i] = 0;
+            continue;
+        }
+        c.firstSlice[i] = ClusterSliceOf(c, nearDepth);
+        c.lastSlice[i] = ClusterSliceOf(c, farDepth);
+    }
+
+    // Far slices hold most of the lights, so the tests are spread per row
+    // rather than per slice
+    const uint32_t rowCount = CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+    if (pool) {
+        JobPoolParallelFor(*pool, CLUSTER_GRID_Z, [&](uint32_t z) {
+            ClusterGatherSlice(c, z);
+        });
+        JobPoolParallelFor(*pool, rowCount, [&](uint32_t row) {
+            ClusterAssignRow(c, row, path);
+        });
+    } else {
+        for (uint32_t z = 0; z < CLUSTER_GRID_Z; ++z) {
+            ClusterGatherSlice(c, z);
+        }
+        for (uint32_t row = 0; row < rowCount; ++row) {
+            ClusterAssignRow(c, row, path);
+        }
+    }
+
+    // Stitch the row lists together and make the offsets absolute
+    c.indices.clear();
+    for (uint32_t row = 0; row < rowCount; ++row) {
+        uint32_t base = (uint32_t)c.indices.size();
+        const ClusterRow &r = c.rows[row];
+        for (uint32_t i = row * CLUSTER_GRID_X; i < (row + 1) * CLUSTER_GRID_X; ++i) {
+            c.grid[i * 2] += base;
+        }
+        c.indices.insert(c.indices.end(), r.indices.begin(), r.indices.end());
+    }
+    return (uint32_t)c.indices.size();
+}
+
+static float ClusterRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return (float)(state >> 8) / 16777216.0f;
+}
+
+void ClusterLightsScatter(std::vector<ClusterLight> &lights, uint32_t count, glm::vec3 min, glm::vec3 max, uint32_t seed) {
+    lights.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        ClusterLight &light = lights[i];
+        light.position = min + (max - min) * glm::vec3(ClusterRandom(seed), ClusterRandom(seed), ClusterRandom(seed));
+        light.range = 2.0f + 3.0f * ClusterRandom(seed);
+
+        // Saturated colors: one channel full, the others random
+        glm::vec3 color(ClusterRandom(seed), ClusterRandom(seed), ClusterRandom(seed));
+        color[i % 3] = 1.0f;
+        light.color = color * 0.8f;
+
+        if (i % 4 == 3) {
+            light.direction = glm::normalize(glm::vec3(ClusterRandom(seed) - 0.5f, -2.0f, ClusterRandom(seed) - 0.5f));
+            light.cosInner = std::cos(glm::radians(20.0f));
+            light.cosOuter = std::cos(glm::radians(30.0f));
+            light.range *= 2.0f;
+        } else {
+            light.direction = glm::vec3(0.0f);
+            light.cosInner = -1.0f;
+            light.cosOuter = -2.0f;
+        }
+    }
+}
+
+// GL buffers
+// ---------------------------
+static void ClusterCreateBuffer(uint32_t &buffer, uint32_t &texture, GLenum format, uint32_t unit) {
+    glGenBuffers(1, &buffer);
+    GLStateBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &texture);
+    GLStateBindTextureForEdit(unit, GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+// Orphans the old storage so the driver doesn't stall on frames still
+// reading it. Never uploads less than one texel.
+static void ClusterUpload(uint32_t buffer, const void *data, size_t size) {
+    GLStateBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (size == 0) {
+        const uint32_t empty[4] = {};
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(empty), empty, GL_STREAM_DRAW);
+        return;
+    }
+    glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+}
+
+void LightClustersGpuInit(LightClustersGpu &g) {
+    int32_t maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    g.maxTexels = (uint32_t)std::max(maxTexels, 65536); // the spec's minimum
+    g.truncated = false;
+    ClusterCreateBuffer(g.lightBuffer, g.lightTexture, GL_RGBA32F, CLUSTER_UNIT_LIGHTS);
+    ClusterCreateBuffer(g.gridBuffer, g.gridTexture, GL_RG32UI, CLUSTER_UNIT_GRID);
+    ClusterCreateBuffer(g.indexBuffer, g.indexTexture, GL_R32UI, CLUSTER_UNIT_INDICES);
+}
+
+void LightClustersGpuShutdown(LightClustersGpu &g) {
+    uint32_t buffers[] = { g.lightBuffer, g.gridBuffer, g.indexBuffer };
+    uint32_t textures[] = { g.lightTexture, g.gridTexture, g.indexTexture };
+    GLStateDeleteTextures(3, textures);
+    GLStateDeleteBuffers(3, buffers);
+}
+
+void LightClustersUploadLights(LightClustersGpu &g, const std::vector<ClusterLight> &lights) {
+    static_assert(sizeof(ClusterLight) == 3 * 4 * sizeof(float), "ClusterLight is three RGBA32F texels");
+    size_t count = std::min(lights.size(), (size_t)(g.maxTexels / 3));
+    if (count < lights.size()) {
+        std::cerr << "WARNING::CLUSTERS::TOO_MANY_LIGHTS " << lights.size() << " lights, texture buffers hold " << count << std::endl;
+    }
+    ClusterUpload(g.lightBuffer, lights.data(), count * sizeof(ClusterLight));
+}
+
+void LightClustersUpload(LightClustersGpu &g, const LightClusters &c) {
+    ClusterUpload(g.gridBuffer, c.grid.data(), c.grid.size() * sizeof(uint32_t));
+
+    // Lists past the texture buffer limit would read out of range; drop
+    // their tail instead. Only very dense scenes get here.
+    size_t indexCount = c.indices.size();
+    if (indexCount > g.maxTexels) {
+        if (!g.truncated) {
+            std::cerr << "WARNING::CLUSTERS::INDEX_LIST_TRUNCATED " << indexCount << " light indices, limit " << g.maxTexels << std::endl;
+            g.truncated = true;
+        }
+        std::vector<uint32_t> grid(c.grid);
+        for (size_t i = 0; i < grid.size(); i += 2) {
+            grid[i] = std::min(grid[i], g.maxTexels);
+            grid[i + 1] = std::min(grid[i + 1], g.maxTexels - grid[i]);
+        }
+        ClusterUpload(g.gridBuffer, grid.data(), grid.size() * sizeof(uint32_t));
+        indexCount = g.maxTexels;
+    }
+    ClusterUpload(g.indexBuffer, c.indices.data(), indexCount * sizeof(uint32_t));
+
+    GLStateBindTexture(CLUSTER_UNIT_LIGHTS, GL_TEXTURE_BUFFER, g.lightTexture);
+    GLStateBindTexture(CLUSTER_UNIT_GRID, GL_TEXTURE_BUFFER, g.gridTexture);
+    GLStateBindTexture(CLUSTER_UNIT_INDICES, GL_TEXTURE_BUFFER, g.indexTexture);
+}
+
+// Benchmark
+// ---------------------------
+void LightClustersBenchmark(JobPool &pool) {
+    const uint32_t iterations = 20;
+    const float nearPlane = 0.1f, farPlane = 100.0f;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, nearPlane, farPlane);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    LightClusters c;
+    LightClustersSetProjection(c, projection, nearPlane, farPlane);
+    const CpuFeatures &cpu = CpuGetFeatures();
+    const uint32_t lightCounts[] = { 1000, 10000 };
+    for (uint32_t lightCount : lightCounts) {
+        std::vector<ClusterLight> lights;
+        ClusterLightsScatter(lights, lightCount, glm::vec3(-40.0f, -15.0f, -90.0f), glm::vec3(40.0f, 15.0f, 0.0f), 1234);
+
+        LightClustersAssign(c, lights, view, nullptr, CLUSTER_PATH_SCALAR);
+        std::vector<uint32_t> referenceGrid = c.grid;
+        std::vector<uint32_t> referenceIndices = c.indices;
+        uint32_t occupied = 0, longest = 0;
+        for (uint32_t i = 0; i < CLUSTER_COUNT; ++i) {
+            occupied += c.grid[i * 2 + 1] != 0;
+            longest = std::max(longest, c.grid[i * 2 + 1]);
+        }
+        std::cout << "clusters " << lightCount << " lights: " << c.indices.size() << " indices, "
+                  << occupied << "/" << CLUSTER_COUNT << " clusters lit, longest list " << longest << std::endl;
+
+        const ClusterPath paths[] = { CLUSTER_PATH_SCALAR, CLUSTER_PATH_AVX };
+        for (ClusterPath path : paths) {
+            if (path == CLUSTER_PATH_AVX && !cpu.avx) {
+                continue;
+            }
+            for (int threaded = 0; threaded < 2; ++threaded) {
+                double best = 1e30;
+                for (uint32_t it = 0; it < iterations; ++it) {
+                    auto start = std::chrono::steady_clock::now();
+                    LightClustersAssign(c, lights, view, threaded ? &pool : nullptr, path);
+                    best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                }
+                bool match = c.grid == referenceGrid && c.indices == referenceIndices;
+                std::cout << "clusters " << lightCount << " " << ClusterPathName(path) << (threaded ? " pool:   " : " single: ")
+                          << best << " ms" << (match ? "" : ", MISMATCH vs scalar") << std::endl;
+            }
+        }
+    }
+}
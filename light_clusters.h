@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+
+// Clustered lighting
+// The view frustum is split into CLUSTER_GRID_X x CLUSTER_GRID_Y screen
+// tiles and CLUSTER_GRID_Z depth slices, spaced exponentially between the
+// near and far plane. Every frame the lights are moved to view space and
+// tested against the clusters of each slice they reach, first per row of
+// tiles and then per tile, 8 lights per step with AVX: range sphere
+// against the cluster box, spot cone against the box's bounding sphere.
+// The resulting per cluster index lists and the light data go to
+// colors_fragment.glsl through texture buffers, so a fragment only loops
+// over the lights of its own cluster.
+// -------------------------------------
+#define CLUSTER_GRID_X 16 // must match colors_fragment.glsl
+#define CLUSTER_GRID_Y 12
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+
+#define CLUSTER_UNIT_LIGHTS 2 // texture units of the three buffers
+#define CLUSTER_UNIT_GRID 3
+#define CLUSTER_UNIT_INDICES 4
+
+// World space, three RGBA32F texels in the light buffer. Contribution
+// fades to zero at `range`.
+struct ClusterLight {
+    glm::vec3 position;
+    float range;
+    glm::vec3 color;
+    float cosOuter; // below -1 for point lights
+    glm::vec3 direction;
+    float cosInner;
+};
+
+enum ClusterPath {
+    CLUSTER_PATH_SCALAR,
+    CLUSTER_PATH_AVX,
+    CLUSTER_PATH_AUTO
+};
+
+// Lights in view space, arrays padded to a multiple of 8
+struct ClusterLightSet {
+    std::vector<uint32_t> lights; // indices into the light list
+    std::vector<float> x, y, z, range;
+    std::vector<float> dirX, dirY, dirZ, coneCos, coneSin;
+};
+
+// Scratch of one row of tiles in one slice, so rows run in parallel
+struct ClusterRow {
+    ClusterLightSet lights;        // the slice's lights reaching the row
+    std::vector<uint32_t> indices; // lists of the row's tiles
+};
+
+struct LightClusters {
+    // Projection the cluster bounds were built for
+    float projectionX;
+    float projectionY;
+    float nearPlane;
+    float farPlane;
+    // slice = floor(log(view depth) * depthScale + depthBias)
+    float depthScale;
+    float depthBias;
+
+    // View space box and bounding sphere of every cluster, x fastest
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+
+    // Lights in view space with the slices they reach
+    std::vector<glm::vec4> viewLights; // center, range
+    std::vector<glm::vec4> viewCones;  // direction, cos of the outer angle
+    std::vector<uint32_t> firstSlice;
+    std::vector<uint32_t> lastSlice;
+    ClusterLightSet slices[CLUSTER_GRID_Z];
+    ClusterRow rows[CLUSTER_GRID_Y * CLUSTER_GRID_Z];
+
+    std::vector<uint32_t> grid;    // offset and count per cluster
+    std::vector<uint32_t> indices; // light indices, grouped by cluster
+};
+
+struct LightClustersGpu {
+    uint32_t lightBuffer;
+    uint32_t gridBuffer;
+    uint32_t indexBuffer;
+    uint32_t lightTexture;
+    uint32_t gridTexture;
+    uint32_t indexTexture;
+    uint32_t maxTexels; // GL_MAX_TEXTURE_BUFFER_SIZE
+    bool truncated;
+};
+
+// Rebuilds the cluster bounds when the projection differs from last time
+void LightClustersSetProjection(LightClusters &c, const glm::mat4 &projection, float nearPlane, float farPlane);
+// Fills grid and indices, slices run on `pool` when given. Returns the
+// number of light indices written.
+uint32_t LightClustersAssign(LightClusters &c, const std::vector<ClusterLight> &lights, const glm::mat4 &view,
+                             JobPool *pool, ClusterPath path = CLUSTER_PATH_AUTO);
+
+const char *ClusterPathName(ClusterPath path);
+ClusterPath ClusterBestPath();
+
+// `count` lights of random color spread over the box, every fourth one a
+// spot light pointing down
+void ClusterLightsScatter(std::vector<ClusterLight> &lights, uint32_t count, glm::vec3 min, glm::vec3 max, uint32_t seed);
+
+void LightClustersGpuInit(LightClustersGpu &g);
+void LightClustersGpuShutdown(LightClustersGpu &g);
+void LightClustersUploadLights(LightClustersGpu &g, const std::vector<ClusterLight> &lights);
+// Uploads grid and index lists, then binds the three buffer textures
+void LightClustersUpload(LightClustersGpu &g, const LightClusters &c);
+
+// CPU only assignment benchmark at 1k and 10k lights
+void LightClustersBenchmark(JobPool &pool);
@@ -4,11 +4,16 @@ layout (location = 0) in vec3 aPos;
 
 out vec2 ourTexPos;
 
+layout (std140) uniform FrameConstants {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPosition;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 perspective;
 
 void main()
 {
-   gl_Position = perspective * view * model * vec4(aPos, 1.0);
+   gl_Position = viewProjection * model * vec4(aPos, 1.0);
 };
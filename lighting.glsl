@@ -0,0 +1,106 @@
+// Lighting shared by the forward (colors_fragment.glsl) and deferred
+// (deferred_fragment.glsl) paths, pulled in with #include
+
+struct Material {
+    sampler2D diffuseMap; // rgb diffuse, a specular (material_pack.h)
+    float shininess;
+};
+
+struct Light {
+    vec3  position;
+    vec3  direction;
+    float cutOff;
+    float outerCutOff;
+
+    vec3  ambient;
+    vec3  diffuse;
+    vec3  specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+uniform Material material;
+uniform Light    light;
+
+// Clustered lights, see light_clusters.h. The grid has to match
+// CLUSTER_GRID_X/Y/Z there.
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 12
+#define CLUSTER_GRID_Z 24
+
+uniform samplerBuffer  clusterLights;  // 3 texels per light: position and range, color and cos outer, direction and cos inner
+uniform usamplerBuffer clusterGrid;    // offset and count per cluster
+uniform usamplerBuffer clusterIndices; // light indices, grouped by cluster
+uniform float clusterDepthScale;
+uniform float clusterDepthBias;
+
+// The camera's spot light: Phong with distance attenuation and a soft edge
+vec3 SpotLighting(vec3 position, vec3 norm, vec3 cameraDir, vec3 diffuseColor, vec3 specularColor)
+{
+    vec3 ambient = (light.ambient * diffuseColor);
+
+    vec3 lightDir = normalize(light.position - position);
+    float diff = max(dot(lightDir, norm), 0.0f);
+    vec3 diffuse = (diff * light.diffuse * diffuseColor);
+
+    vec3 reflectedDir = reflect(-lightDir, norm);
+
+    float spec = pow(max(dot(cameraDir, reflectedDir), 0.0f), material.shininess);
+    vec3 specular = (spec * light.specular * specularColor);
+
+    float distance = length(light.position - position);
+    float attenuation = 1.0f / (light.constant + (light.linear * distance) + (light.quadratic * pow(distance, 2)));
+
+    diffuse *= attenuation;
+    ambient *= attenuation;
+    specular *= attenuation;
+
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0f, 1.0f);
+
+    diffuse *= intensity;
+    specular *= intensity;
+
+    return diffuse + ambient + specular;
+}
+
+int ClusterIndex(vec4 clipPosition)
+{
+    vec2 ndc = clipPosition.xy / clipPosition.w;
+    ivec2 tile = clamp(ivec2((ndc * 0.5f + 0.5f) * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)),
+                       ivec2(0), ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+    // w is the view space depth under a perspective projection
+    int slice = clamp(int(floor(log(clipPosition.w) * clusterDepthScale + clusterDepthBias)), 0, CLUSTER_GRID_Z - 1);
+    return tile.x + CLUSTER_GRID_X * (tile.y + CLUSTER_GRID_Y * slice);
+}
+
+// Diffuse and specular of every light in the cluster of `clipPosition`.
+// Falloff is inverse square, windowed so it reaches zero at the light's
+// range.
+vec3 ClusterLighting(vec3 position, vec4 clipPosition, vec3 norm, vec3 cameraDir, vec3 diffuseColor, vec3 specularColor)
+{
+    vec3 result = vec3(0.0f);
+    uvec2 cluster = texelFetch(clusterGrid, ClusterIndex(clipPosition)).xy;
+    for (uint i = 0u; i < cluster.y; ++i) {
+        int texel = int(texelFetch(clusterIndices, int(cluster.x + i)).r) * 3;
+        vec4 positionRange = texelFetch(clusterLights, texel);
+        vec4 colorCosOuter = texelFetch(clusterLights, texel + 1);
+        vec4 directionCosInner = texelFetch(clusterLights, texel + 2);
+
+        vec3 toLight = positionRange.xyz - position;
+        float distance = length(toLight);
+        vec3 lightDir = toLight / max(distance, 1e-4f);
+        float window = clamp(1.0f - pow(distance / positionRange.w, 4.0f), 0.0f, 1.0f);
+        float attenuation = window * window / (1.0f + distance * distance);
+        float theta = dot(-lightDir, directionCosInner.xyz);
+        attenuation *= clamp((theta - colorCosOuter.w) / (directionCosInner.w - colorCosOuter.w), 0.0f, 1.0f);
+
+        float diff = max(dot(lightDir, norm), 0.0f);
+        float spec = pow(max(dot(cameraDir, reflect(-lightDir, norm)), 0.0f), material.shininess);
+        result += colorCosOuter.rgb * attenuation * (diff * diffuseColor + spec * specularColor);
+    }
+    return result;
+}
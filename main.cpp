@@ -7,15 +7,48 @@
 #include <cassert>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <filesystem>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "culling.h"
+#include "jobs.h"
+#include "texture_streamer.h"
+#include "cooked_texture.h"
+#include "null_gl.h"
+#include "scene.h"
+#include "swr.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "transforms.h"
+#include "occlusion.h"
+#include "bvh.h"
+#include "light_clusters.h"
+#include "deferred.h"
+#include "profiler.h"
+#include "frame_clock.h"
+#include "bc_encoder.h"
+#include "sampler_cache.h"
+#include "image_cache.h"
+#include "png_decode.h"
+#include "cpu_features.h"
+
 #define WIDTH 800
 #define HEIGHT 600
 
 // Camera
 // ---------------------
+#define CAMERA_NEAR_PLANE 0.1f
+#define CAMERA_FAR_PLANE 100.0f
+
 struct Camera {
     glm::vec3 position;
     glm::vec3 front;
@@ -130,43 +163,284 @@ glm::mat4 CameraGetPerspective(Camera &c) {
     return glm::perspective(
         glm::radians(c.fov),
         (float)WIDTH/(float)HEIGHT,
-        0.1f,
-        100.0f
+        CAMERA_NEAR_PLANE,
+        CAMERA_FAR_PLANE
     );
 }
 
+// Distance along the view direction mapped to 0..1 between the clip planes
+float CameraNormalizedDepth(float viewDepth) {
+    return (viewDepth - CAMERA_NEAR_PLANE) / (CAMERA_FAR_PLANE - CAMERA_NEAR_PLANE);
+}
+
 // Shader
 // -------------------------------------
+#define SHADER_MAX_UNIFORMS 64 // must be a power of two
+#define SHADER_UNIFORM_EMPTY 0xFFFFFFFFu
+
+// Active uniforms are reflected once after linking into a small open
+// addressing table keyed by the FNV-1a hash of the uniform name, so the
+// setters below never have to ask the driver for a location. The names are
+// kept and compared on a hash hit, so a name the program doesn't have
+// (optimized out, say) misses even when its hash collides with one it has.
+// ---------------------------
+struct ShaderUniform {
+    uint32_t hash;
+    uint32_t nameOffset; // into Shader::uniformNames, SHADER_UNIFORM_EMPTY marks an empty slot
+    int32_t location;
+};
+
 struct Shader {
     uint32_t ID;
+    uint32_t uniformCount;
+    ShaderUniform uniforms[SHADER_MAX_UNIFORMS];
+    std::string uniformNames; // reflected names, each followed by a '\0'
 };
 
-void ShaderInit(Shader &s, const char *vertexPath, const char *fragmentPath) {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+struct ShaderStats {
+    uint32_t driverLookups; // glGetUniformLocation calls
+    uint32_t tableLookups;  // lookups served by Shader::uniforms
+};
 
-    try {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream;
-        std::stringstream fShaderStream;
-
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        vShaderFile.close();
-        fShaderFile.close();
-
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    } catch(std::ifstream::failure &e) {
-        std::cerr << "Cannot create shader because : " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
+ShaderStats shaderStats;
+
+constexpr uint32_t ShaderHashName(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int32_t ShaderQueryLocation(uint32_t program, const char *name) {
+    shaderStats.driverLookups++;
+    return glGetUniformLocation(program, name);
+}
+
+void ShaderAddUniform(Shader &s, const char *name, int32_t location) {
+    uint32_t hash = ShaderHashName(name);
+    uint32_t mask = SHADER_MAX_UNIFORMS - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        ShaderUniform &slot = s.uniforms[i];
+        if (slot.nameOffset == SHADER_UNIFORM_EMPTY) {
+            // One slot always stays empty, it ends the probe of a miss
+            if (s.uniformCount == SHADER_MAX_UNIFORMS - 1) {
+                std::cerr << "Cannot reflect uniform " << name << " : more than " << SHADER_MAX_UNIFORMS - 1
+                          << " in one program" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            slot.hash = hash;
+            slot.nameOffset = (uint32_t)s.uniformNames.size();
+            slot.location = location;
+            s.uniformNames.append(name);
+            s.uniformNames.push_back('\0');
+            s.uniformCount++;
+            return;
+        }
+        if (slot.hash == hash && strcmp(s.uniformNames.c_str() + slot.nameOffset, name) == 0) {
+            return;
+        }
+    }
+}
+
+void ShaderReflectUniforms(Shader &s) {
+    s.uniformCount = 0;
+    s.uniformNames.clear();
+    for (ShaderUniform &slot : s.uniforms) {
+        slot = { 0, SHADER_UNIFORM_EMPTY, -1 };
+    }
+
+    int32_t count{};
+    int32_t maxLength{};
+    glGetProgramiv(s.ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(s.ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (int32_t i = 0; i < count; ++i) {
+        GLsizei length{};
+        GLint size{};
+        GLenum type{};
+        glGetActiveUniform(s.ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        name[length] = '\0';
+
+        // Uniforms living in a uniform block have no location
+        int32_t location = ShaderQueryLocation(s.ID, name.c_str());
+        if (location == -1) {
+            continue;
+        }
+        ShaderAddUniform(s, name.c_str(), location);
+
+        // Arrays are reported as "name[0]", but are usually set as "name"
+        if (length > 3 && strcmp(name.c_str() + length - 3, "[0]") == 0) {
+            name[length - 3] = '\0';
+            ShaderAddUniform(s, name.c_str(), location);
+        }
+    }
+}
+
+int32_t ShaderGetUniformLocation(const Shader &s, const char *name) {
+    shaderStats.tableLookups++;
+    uint32_t hash = ShaderHashName(name);
+    uint32_t mask = SHADER_MAX_UNIFORMS - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        const ShaderUniform &slot = s.uniforms[i];
+        if (slot.nameOffset == SHADER_UNIFORM_EMPTY) {
+            return -1;
+        }
+        if (slot.hash == hash && strcmp(s.uniformNames.c_str() + slot.nameOffset, name) == 0) {
+            return slot.location;
+        }
+    }
+}
+
+// Program binary cache
+// Linked programs are stored with glGetProgramBinary under ./shader_cache,
+// keyed by both sources and the driver strings, and reloaded with
+// glProgramBinary on the next launch. GL 3.3 core doesn't have these entry
+// points, so they are only used when the driver exposes them.
+// ---------------------------
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#define SHADER_CACHE_DIR "./shader_cache"
+#define SHADER_CACHE_MAGIC 0x42504C47u // "GLPB"
+#define SHADER_CACHE_VERSION 1
+
+typedef void (APIENTRYP ShaderGetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP ShaderProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP ShaderProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+struct ShaderCache {
+    bool enabled;
+    std::string driver; // vendor, renderer and version, part of every key
+    ShaderGetProgramBinaryProc glGetProgramBinary;
+    ShaderProgramBinaryProc glProgramBinary;
+    ShaderProgramParameteriProc glProgramParameteri;
+
+    uint32_t hits;
+    uint32_t misses;
+    double savedMs;
+};
+
+struct ShaderCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+    double compileMs; // what compiling from source cost when this was stored
+};
+
+ShaderCache shaderCache;
+
+void ShaderCacheInit() {
+    shaderCache = {};
+    shaderCache.driver += (const char *)glGetString(GL_VENDOR);
+    shaderCache.driver += '\n';
+    shaderCache.driver += (const char *)glGetString(GL_RENDERER);
+    shaderCache.driver += '\n';
+    shaderCache.driver += (const char *)glGetString(GL_VERSION);
+
+    // The null driver runs without a GLFW context, so there is nothing to query
+    if (!glfwGetCurrentContext()) {
+        return;
+    }
+    bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1) ||
+                     glfwExtensionSupported("GL_ARB_get_program_binary");
+    if (!supported) {
+        return;
+    }
+    shaderCache.glGetProgramBinary = (ShaderGetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+    shaderCache.glProgramBinary = (ShaderProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+    shaderCache.glProgramParameteri = (ShaderProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+
+    int32_t formats{};
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    shaderCache.enabled = formats > 0 &&
+        shaderCache.glGetProgramBinary && shaderCache.glProgramBinary && shaderCache.glProgramParameteri;
+}
+
+uint64_t ShaderCacheKey(const std::string &vertexCode, const std::string &fragmentCode) {
+    uint64_t hash = 14695981039346656037ull;
+    const std::string *parts[] = { &vertexCode, &fragmentCode, &shaderCache.driver };
+    for (const std::string *part : parts) {
+        for (char c : *part) {
+            hash ^= (uint8_t)c;
+            hash *= 1099511628211ull;
+        }
+        // Separator so moving text between the parts changes the key
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string ShaderCachePath(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return std::string(SHADER_CACHE_DIR) + "/" + name;
+}
+
+// Returns 0 when there's no usable entry or the driver rejects the binary
+// ---------------------------
+uint32_t ShaderCacheLoad(uint64_t key, double &compileMs) {
+    std::ifstream file(ShaderCachePath(key), std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+    ShaderCacheHeader header{};
+    file.read((char *)&header, sizeof(header));
+    if (!file || header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION || header.key != key) {
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    file.read(binary.data(), header.length);
+    if (!file) {
+        return 0;
     }
 
+    uint32_t program = glCreateProgram();
+    shaderCache.glProgramBinary(program, header.format, binary.data(), (GLsizei)header.length);
+    int32_t success{};
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        GLStateDeleteProgram(program);
+        return 0;
+    }
+    compileMs = header.compileMs;
+    return program;
+}
+
+void ShaderCacheStore(uint64_t key, uint32_t program, double compileMs) {
+    int32_t length{};
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format{};
+    shaderCache.glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    std::error_code ec;
+    std::filesystem::create_directories(SHADER_CACHE_DIR, ec);
+    std::ofstream file(ShaderCachePath(key), std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return;
+    }
+    ShaderCacheHeader header{ SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, key, format, (uint32_t)length, compileMs };
+    file.write((const char *)&header, sizeof(header));
+    file.write(binary.data(), length);
+}
+
+uint32_t ShaderCompileProgram(const std::string &vertexCode, const std::string &fragmentCode, bool retrievable) {
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     uint32_t vertexShader{};
@@ -200,6 +474,9 @@ void ShaderInit(Shader &s, const char *vertexPath, const char *fragmentPath) {
 
     uint32_t shaderProgram{};
     shaderProgram = glCreateProgram();
+    if (retrievable) {
+        shaderCache.glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
     glLinkProgram(shaderProgram);
@@ -215,59 +492,330 @@ void ShaderInit(Shader &s, const char *vertexPath, const char *fragmentPath) {
 
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
-    s.ID = shaderProgram;
+    return shaderProgram;
+}
+
+// Reads a shader source, replacing every `#include "file"` line with that
+// file, looked up next to the one including it. The expanded text is what
+// gets hashed for the program cache, so edits to included files count.
+std::string ShaderReadSource(const std::string &path, uint32_t depth = 0) {
+    if (depth > 8) {
+        std::cerr << "Cannot create shader because : includes nest too deep in " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string code;
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try {
+        file.open(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        file.close();
+        code = stream.str();
+    } catch(std::ifstream::failure &e) {
+        std::cerr << "Cannot create shader because : " << e.what() << " (" << path << ")" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    std::string expanded;
+    size_t lineStart = 0;
+    while (lineStart < code.size()) {
+        size_t lineEnd = code.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = code.size();
+        }
+        std::string line = code.substr(lineStart, lineEnd - lineStart);
+        size_t open = line.find('"');
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (line.compare(0, 8, "#include") == 0 && close != std::string::npos) {
+            expanded += ShaderReadSource(directory + line.substr(open + 1, close - open - 1), depth + 1);
+        } else {
+            expanded += line;
+        }
+        expanded += '\n';
+        lineStart = lineEnd + 1;
+    }
+    return expanded;
+}
+
+void ShaderInit(Shader &s, const char *vertexPath, const char *fragmentPath) {
+    std::string vertexCode = ShaderReadSource(vertexPath);
+    std::string fragmentCode = ShaderReadSource(fragmentPath);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t key = ShaderCacheKey(vertexCode, fragmentCode);
+    double compileMs = 0.0;
+    uint32_t program = shaderCache.enabled ? ShaderCacheLoad(key, compileMs) : 0;
+    bool hit = program != 0;
+    if (!hit) {
+        program = ShaderCompileProgram(vertexCode, fragmentCode, shaderCache.enabled);
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (hit) {
+        shaderCache.hits++;
+        shaderCache.savedMs += compileMs - elapsedMs;
+        std::cout << "Shader cache hit for " << vertexPath << " + " << fragmentPath << ": " << elapsedMs
+                  << " ms (" << compileMs - elapsedMs << " ms saved)" << std::endl;
+    } else {
+        shaderCache.misses++;
+        if (shaderCache.enabled) {
+            ShaderCacheStore(key, program, elapsedMs);
+        }
+        std::cout << "Shader cache " << (shaderCache.enabled ? "miss" : "unavailable") << " for " << vertexPath
+                  << " + " << fragmentPath << ": compiled in " << elapsedMs << " ms" << std::endl;
+    }
+
+    s.ID = program;
+    ShaderReflectUniforms(s);
 }
 
 void ShaderUse(const Shader &s){
-    glUseProgram(s.ID);
+    GLStateUseProgram(s.ID);
 }
 
 void ShaderSetFloat(const Shader &s, const char *name, float value) {
-    int vertexColorLocation = glGetUniformLocation(s.ID, name);
+    int vertexColorLocation = ShaderGetUniformLocation(s, name);
     assert(vertexColorLocation != -1);
     glUniform1f(vertexColorLocation, value);
 }
 
 void ShaderSetInt(const Shader &s, const char *name, int value) {
-    int vertexColorLocation = glGetUniformLocation(s.ID, name);
+    int vertexColorLocation = ShaderGetUniformLocation(s, name);
     assert(vertexColorLocation != -1);
     glUniform1i(vertexColorLocation, value);
 }
 
 void ShaderSetTransformation(const Shader &s, const char *name, const GLfloat* value) {
-    int transformLocation = glGetUniformLocation(s.ID, name);
+    int transformLocation = ShaderGetUniformLocation(s, name);
     assert(transformLocation != -1);
     glUniformMatrix4fv(transformLocation, 1, GL_FALSE, value);
 }
 
+void ShaderSetMat3(const Shader &s, const char *name, const GLfloat* value, bool transpose) {
+    int transformLocation = ShaderGetUniformLocation(s, name);
+    assert(transformLocation != -1);
+    glUniformMatrix3fv(transformLocation, 1, transpose ? GL_TRUE : GL_FALSE, value);
+}
+
 void ShaderSetBool(const Shader &s, const char *name, bool value) {
-    int vertexColorLocation = glGetUniformLocation(s.ID, name);
+    int vertexColorLocation = ShaderGetUniformLocation(s, name);
     assert(vertexColorLocation != -1);
     glUniform1i(vertexColorLocation, value);
 }
 
 void ShaderSetVec3(const Shader &s, const char *name, float x, float y, float z) {
-    int transformLocation = glGetUniformLocation(s.ID, name);
+    int transformLocation = ShaderGetUniformLocation(s, name);
     assert(transformLocation != -1);
     glUniform3f(transformLocation, x, y, z);
 }
 
 void ShaderSetVec3(const Shader &s, const char *name, glm::vec3 v) {
-    int transformLocation = glGetUniformLocation(s.ID, name);
+    int transformLocation = ShaderGetUniformLocation(s, name);
     assert(transformLocation != -1);
     glUniform3f(transformLocation, v.x, v.y, v.z);
 }
 
+void ShaderBindUniformBlock(const Shader &s, const char *blockName, uint32_t binding) {
+    uint32_t blockIndex = glGetUniformBlockIndex(s.ID, blockName);
+    assert(blockIndex != GL_INVALID_INDEX);
+    glUniformBlockBinding(s.ID, blockIndex, binding);
+}
+
+// Frame constants
+// Per-frame camera data shared by every program through one std140
+// uniform block. Must match `FrameConstants` in the vertex/fragment shaders.
+// -------------------------------------
+#define FRAME_CONSTANTS_BINDING 0
+
+struct FrameConstants {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    float _pad0;
+};
+
+// std140: mat4 is 4 vec4 columns (64 bytes), vec3 is aligned to 16 bytes
+static_assert(offsetof(FrameConstants, view) == 0, "std140 offset of view");
+static_assert(offsetof(FrameConstants, projection) == 64, "std140 offset of projection");
+static_assert(offsetof(FrameConstants, viewProjection) == 128, "std140 offset of viewProjection");
+static_assert(offsetof(FrameConstants, cameraPosition) == 192, "std140 offset of cameraPosition");
+static_assert(sizeof(FrameConstants) == 208, "std140 size of FrameConstants");
+
+uint32_t FrameConstantsCreateBuffer() {
+    uint32_t ubo;
+    glGenBuffers(1, &ubo);
+    GLStateBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), nullptr, GL_DYNAMIC_DRAW);
+    GLStateBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, ubo);
+    return ubo;
+}
+
+void FrameConstantsUpload(uint32_t ubo, const FrameConstants &fc) {
+    GLStateBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &fc);
+}
+
+// Check the layout the linker actually produced against the C++ mirror
+// ---------------------------
+void FrameConstantsValidate(const Shader &s) {
+    const char *names[] = { "view", "projection", "viewProjection", "cameraPosition" };
+    const int32_t expected[] = {
+        offsetof(FrameConstants, view),
+        offsetof(FrameConstants, projection),
+        offsetof(FrameConstants, viewProjection),
+        offsetof(FrameConstants, cameraPosition)
+    };
+    const int memberCount = sizeof(names) / sizeof(names[0]);
+
+    uint32_t indices[memberCount];
+    int32_t offsets[memberCount];
+    glGetUniformIndices(s.ID, memberCount, names, indices);
+    for (int i = 0; i < memberCount; ++i) {
+        // Members the program doesn't reference may be optimized away
+        if (indices[i] == GL_INVALID_INDEX) {
+            offsets[i] = expected[i];
+            continue;
+        }
+        glGetActiveUniformsiv(s.ID, 1, &indices[i], GL_UNIFORM_OFFSET, &offsets[i]);
+        if (offsets[i] != expected[i]) {
+            std::cerr << "FrameConstants." << names[i] << " is at offset " << offsets[i]
+                      << " in the shader but " << expected[i] << " on the CPU" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Command line
+// --------------------------------------
+struct AppOptions {
+    uint32_t instanceCount = 10;
+    bool benchCull = false;
+    bool benchQueue = false;
+    bool benchTransforms = false;
+    bool benchJobs = false;
+    bool benchOcclusion = false;
+    bool occlusion = true; // CPU occlusion culling after the frustum test
+    bool benchBvh = false;
+    bool cullBvh = false; // frustum culling through the BVH instead of the linear scan
+    bool pinJobs = false; // one logical CPU per job worker
+    uint32_t lightCount = 0; // clustered point and spot lights around the cubes
+    bool benchLights = false;
+    bool deferred = false;      // start in deferred shading, G toggles at runtime
+    bool benchDeferred = false; // --bench runs the path forward, then deferred
+    const char *tracePath = nullptr; // Chrome trace written at exit
+    bool cook = false;
+    BcFormat cookFormat = BC_FORMAT_AUTO; // block compression of cooked textures
+    bool benchBc = false;
+    SamplerQuality textureQuality = { SAMPLER_TIER_TRILINEAR, 1 }; // F cycles at runtime
+    bool benchFilters = false; // --bench runs the path once per filter tier
+    bool imageCache = true;    // decoded images kept across runs
+    uint64_t imageCacheBudget = IMAGE_CACHE_BUDGET;
+    bool benchPng = false;
+#ifdef LEARNOPENGL_NULL_GL
+    bool nullGL = true;
+#else
+    bool nullGL = false;
+#endif
+    uint32_t frames = 1000; // frames rendered by headless runs
+    bool bench = false;
+    const char *benchContext = "auto"; // osmesa, egl, hidden or auto
+    bool benchSwr = false;
+    const char *swrDump = nullptr; // PPM of the last software rendered frame
+};
+
+void AppOptionsPrintUsage(const char *exe) {
+    std::cerr << "Usage: " << exe << " [--instances N] [--bench-cull] [--bench-queue] [--bench-transforms] [--bench-jobs] [--pin-jobs] [--bench-occlusion] [--no-occlusion] [--bench-bvh] [--cull-bvh] [--lights N] [--bench-lights] [--deferred] [--bench-deferred] [--trace FILE] [--cook] [--cook-format none|bc1|bc3|bc7|auto] [--bench-bc] [--texture-filter nearest|bilinear|trilinear|anisoN] [--bench-filters] [--no-image-cache] [--image-cache-budget MB] [--bench-png] [--null-gl] [--frames N]"
+              << " [--bench] [--bench-context osmesa|egl|hidden|auto] [--bench-swr] [--swr-dump FILE]" << std::endl;
+}
+
+void AppOptionsParse(AppOptions &o, int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            o.instanceCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--bench-cull") == 0) {
+            o.benchCull = true;
+        } else if (strcmp(argv[i], "--bench-queue") == 0) {
+            o.benchQueue = true;
+        } else if (strcmp(argv[i], "--bench-transforms") == 0) {
+            o.benchTransforms = true;
+        } else if (strcmp(argv[i], "--bench-jobs") == 0) {
+            o.benchJobs = true;
+        } else if (strcmp(argv[i], "--pin-jobs") == 0) {
+            o.pinJobs = true;
+        } else if (strcmp(argv[i], "--bench-occlusion") == 0) {
+            o.benchOcclusion = true;
+        } else if (strcmp(argv[i], "--no-occlusion") == 0) {
+            o.occlusion = false;
+        } else if (strcmp(argv[i], "--bench-bvh") == 0) {
+            o.benchBvh = true;
+        } else if (strcmp(argv[i], "--cull-bvh") == 0) {
+            o.cullBvh = true;
+        } else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            o.lightCount = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--bench-lights") == 0) {
+            o.benchLights = true;
+        } else if (strcmp(argv[i], "--deferred") == 0) {
+            o.deferred = true;
+        } else if (strcmp(argv[i], "--bench-deferred") == 0) {
+            o.benchDeferred = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            o.tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--cook") == 0) {
+            o.cook = true;
+        } else if (strcmp(argv[i], "--cook-format") == 0 && i + 1 < argc && BcFormatParse(argv[i + 1], o.cookFormat)) {
+            i++;
+        } else if (strcmp(argv[i], "--bench-bc") == 0) {
+            o.benchBc = true;
+        } else if (strcmp(argv[i], "--texture-filter") == 0 && i + 1 < argc && SamplerQualityParse(argv[i + 1], o.textureQuality)) {
+            i++;
+        } else if (strcmp(argv[i], "--bench-filters") == 0) {
+            o.benchFilters = true;
+        } else if (strcmp(argv[i], "--no-image-cache") == 0) {
+            o.imageCache = false;
+        } else if (strcmp(argv[i], "--image-cache-budget") == 0 && i + 1 < argc) {
+            o.imageCacheBudget = strtoull(argv[++i], nullptr, 10) * 1024ull * 1024ull;
+        } else if (strcmp(argv[i], "--bench-png") == 0) {
+            o.benchPng = true;
+        } else if (strcmp(argv[i], "--null-gl") == 0) {
+            o.nullGL = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            o.frames = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            o.bench = true;
+        } else if (strcmp(argv[i], "--bench-context") == 0 && i + 1 < argc) {
+            o.benchContext = argv[++i];
+        } else if (strcmp(argv[i], "--bench-swr") == 0) {
+            o.benchSwr = true;
+        } else if (strcmp(argv[i], "--swr-dump") == 0 && i + 1 < argc) {
+            o.swrDump = argv[++i];
+        } else {
+            AppOptionsPrintUsage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (o.instanceCount == 0) {
+        o.instanceCount = 1;
+    }
+    if (o.frames == 0) {
+        o.frames = 1;
+    }
+}
+
 // Globals
 // --------------------------------------
 Camera camera;
-
-float prevTime = (float)glfwGetTime();
-float deltaTime = 0.0f;
+glm::vec3 prevCameraPosition; // before the last fixed step, for interpolation
 
 float lastX = WIDTH/2;
 float lastY = HEIGHT/2;
 bool firstRender = true;
+bool toggleShadingPath = false; // set by G, picked up by the render loop
+bool dumpTrace = false;         // set by P
+bool cycleTextureFilter = false; // set by F
 
 glm::vec3 lightPosition(1.2f, 1.0f, 2.0f);
 
@@ -303,11 +851,24 @@ void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
     CameraZoom(camera, (float)yoffset);
 }
 
+void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        toggleShadingPath = true;
+    }
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        dumpTrace = true;
+    }
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        cycleTextureFilter = true;
+    }
+}
+
 void frameBufferSizeCallback(GLFWwindow *window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-void processInput(GLFWwindow *window) {
+// Runs once per fixed simulation step of `deltaTime` seconds
+void processInput(GLFWwindow *window, float deltaTime) {
 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
@@ -341,167 +902,222 @@ void renderElement(const Shader &s, uint32_t VAO, glm::mat4 trans) {
 
     // Draw
     // ---------------------------
-    glBindVertexArray(VAO);
+    GLStateBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
-uint32_t loadTexture(const char *path) {
-    uint32_t texture1;
-    glGenTextures(1, &texture1);
-
-    // Bind texture1 with params
-    // ---------------------------
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_set_flip_vertically_on_load(true);
-
-    // Read image and bind to texture1
-    // --------------------------------------------
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-
-    if (data) {
-        GLenum format;
-        if (nrChannels == 1) {
-            format = GL_RED;
-        }  else if (nrChannels == 3) {
-            format = GL_RGB;
-        } else if (nrChannels == 4) {
-            format = GL_RGBA;
-        }
-        glTexImage2D(GL_TEXTURE_2D,
-           	0,
-           	format,
-           	width,
-           	height,
-           	0,
-           	format,
-           	GL_UNSIGNED_BYTE,
-           	data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cerr << "Failed to load image texture1" << std::endl;
-        exit(EXIT_FAILURE);
+// Cube instances
+// Per-instance vertex attributes for the lit cubes, consumed by
+// colors_vertex.glsl as `aModel` (locations 3-6) and `aNormalMatrix` (7-9).
+// -------------------------------------
+#define INSTANCE_ATTRIB_MODEL 3
+#define INSTANCE_ATTRIB_NORMAL_MATRIX 7
+#define CUBE_BOUNDING_RADIUS 0.8660254f // half the diagonal of a unit cube
+
+// The first cubes are the hand placed cubePositions, the rest are laid out
+// on a cube shaped grid starting at z = -20 behind them. The grid ignores
+// the frustum: large counts spread past its sides, and beyond about 60k
+// cubes the back layers lie past CAMERA_FAR_PLANE, which is what gives the
+// culling passes something to reject.
+// Matrices are built by TransformsUpdate, on `pool` when given.
+// ---------------------------
+void CubeInstancesBuild(std::vector<CubeInstance> &instances, CullSpheres &bounds, Transforms &transforms,
+                        uint32_t count, JobPool *pool) {
+    const uint32_t fixedCount = sizeof(cubePositions) / sizeof(cubePositions[0]);
+    uint32_t side = 1;
+    while (side * side * side < count) {
+        side++;
     }
-    stbi_image_free(data);
+    const float spacing = 2.0f;
+
+    instances.resize(count);
+    CullSpheresResize(bounds, count);
+    TransformsResize(transforms, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        glm::vec3 position;
+        if (i < fixedCount) {
+            position = cubePositions[i];
+        } else {
+            uint32_t g = i - fixedCount;
+            position.x = ((float)(g % side) - (float)side * 0.5f) * spacing;
+            position.y = ((float)((g / side) % side) - (float)side * 0.5f) * spacing;
+            position.z = -20.0f - (float)(g / (side * side)) * spacing;
+        }
 
-    return texture1;
+        TransformsSet(transforms, i, position, glm::vec3(0.0, -0.69f, 1.0), glm::radians(90.0f)*(float)i, 1.0f);
+        CullSpheresSet(bounds, i, position, CUBE_BOUNDING_RADIUS);
+    }
+    TransformsUpdate(transforms, instances.data(), pool);
 }
 
-int main()
-{
-// Initialize app
+// visible[] must be sorted front to back. Every cube has the same size,
+// so the nearest ones cover the most screen and make the occluders.
 // ---------------------------
-CameraInit(
-    camera,
-    glm::vec3(0.0f, 0.0f, 4.0f), // position
-    glm::vec3(0.0f, 1.0f, 0.0f), // up
-    -64.0f,                      // yaw
-    16.0f,                        // pitch
-    45.0f                        // fov
-);
+uint32_t CubesOcclusionCull(OcclusionBuffer &b, const glm::mat4 &viewProjection, const std::vector<CubeInstance> &instances,
+                            const CullSpheres &bounds, uint32_t *visible, uint32_t count, JobPool *pool) {
+    // With only occluders in view there is nothing worth testing
+    if (count <= OCCLUSION_MAX_OCCLUDERS) {
+        return count;
+    }
+    OcclusionClear(b, viewProjection);
+    for (uint32_t i = 0; i < OCCLUSION_MAX_OCCLUDERS; ++i) {
+        OcclusionRasterizeCube(b, instances[visible[i]].model);
+    }
+    OcclusionBuildPyramid(b);
+    return OcclusionCullSpheres(b, bounds, visible, count, pool);
+}
 
-// Initialize OpenGL
+glm::mat4 LightCubeModel() {
+    glm::mat4 model(1.0f);
+    model = glm::translate(model, glm::vec3(lightPosition));
+    model = glm::scale(model, glm::vec3(0.2f));
+    return model;
+}
+
+// Attach the instance buffer to the currently bound VAO. Its contents are
+// streamed every frame with only the instances that survived culling.
 // ---------------------------
-glfwInit();
-glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+uint32_t CubeInstancesCreateBuffer(const std::vector<CubeInstance> &instances) {
+    uint32_t instanceVBO;
+    glGenBuffers(1, &instanceVBO);
+    GLStateBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CubeInstance), nullptr, GL_STREAM_DRAW);
+
+    const GLsizei stride = sizeof(CubeInstance);
+    for (uint32_t column = 0; column < 4; ++column) {
+        uint32_t location = INSTANCE_ATTRIB_MODEL + column;
+        size_t offset = offsetof(CubeInstance, model) + column * sizeof(glm::vec4);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid *)offset);
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    for (uint32_t column = 0; column < 3; ++column) {
+        uint32_t location = INSTANCE_ATTRIB_NORMAL_MATRIX + column;
+        size_t offset = offsetof(CubeInstance, normalMatrix) + column * sizeof(glm::vec3);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid *)offset);
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    return instanceVBO;
+}
 
-// Window Creation
-    // ---------------------------
-    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Hello from OpenGL", NULL, NULL);
-    if (window == NULL) {
-        std::cerr << "Failed to create a window" << std::endl;
-        glfwTerminate();
-        return -1;
+// Gather the visible instances and upload them, orphaning last frame's storage
+// ---------------------------
+void CubeInstancesUpload(uint32_t instanceVBO, const std::vector<CubeInstance> &instances,
+                         const uint32_t *visible, uint32_t visibleCount, std::vector<CubeInstance> &staging) {
+    staging.resize(visibleCount);
+    for (uint32_t i = 0; i < visibleCount; ++i) {
+        staging[i] = instances[visible[i]];
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
+    GLStateBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CubeInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(CubeInstance), staging.data());
+}
 
-    // Registering mouse callbacks
-    // ---------------------------
-    glfwSetCursorPosCallback(window, cursorPosCallback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetScrollCallback(window, scrollCallback);
+// Renderer
+// Everything needed to draw the lit-cube scene, independent of where the
+// GL context (or the null driver) came from.
+// -------------------------------------
+struct Renderer {
+    Shader lightingShader;
+    Shader lightCubeShader;
+    Shader gBufferShader;
+    Shader deferredLightingShader;
+    uint32_t frameConstantsUBO;
+
+    // Where frames end up, and its size
+    uint32_t outputFramebuffer;
+    uint32_t outputWidth;
+    uint32_t outputHeight;
+    bool deferred;
+    GBuffer gBuffer;
+    GpuTimer gpuTimers[2]; // forward, deferred
+
+    uint32_t cubeVAO;
+    uint32_t lightCubeVAO;
+    uint32_t VBO;
+
+    std::vector<CubeInstance> cubeInstances;
+    Transforms cubeTransforms;
+    CullSpheres cubeBounds;
+    Bvh cubeBvh;
+    bool cullBvh;
+    uint32_t instanceVBO;
+    std::vector<CubeInstance> visibleInstances;
+    std::vector<uint32_t> visibleIndices;
+    uint32_t visibleCount;
+    OcclusionBuffer occlusion;
+    bool occlusionCulling;
+    std::vector<uint64_t> depthKeys;
+    std::vector<uint64_t> depthScratchKeys;
+    std::vector<uint32_t> depthScratchIndices;
+    RenderQueue renderQueue;
+    std::vector<ClusterLight> lights;
+    LightClusters lightClusters;
+    LightClustersGpu lightClustersGpu;
+
+    JobPool jobPool;
+    ImageCache imageCache;
+    TextureStreamer textureStreamer;
+    uint32_t cubeMaterial; // diffuse and specular in one texture
+    bool texturesResident;
+
+    SamplerCache samplerCache;
+    SamplerQuality textureQuality;
+    uint32_t materialSampler;
+    uint32_t gBufferSampler;
+    std::chrono::steady_clock::time_point startupTime;
+};
 
-    // Load OpenGL functions
-    // ---------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initalize GLAD" << std::endl;
-        return -1;
+// Picks the sampler the material textures are read with
+void RendererSetTextureQuality(Renderer &r, SamplerQuality quality) {
+    r.textureQuality = quality;
+    r.materialSampler = SamplerCacheGet(r.samplerCache, SamplerStateForQuality(quality, GL_REPEAT));
+    std::cout << "Texture filter " << SamplerTierName(quality.tier);
+    if (quality.tier == SAMPLER_TIER_ANISOTROPIC && r.samplerCache.maxAnisotropy > 1.0f) {
+        std::cout << " " << std::min((float)quality.anisotropy, r.samplerCache.maxAnisotropy) << "x";
+    } else if (quality.tier == SAMPLER_TIER_ANISOTROPIC) {
+        std::cout << " (not supported, trilinear)";
     }
+    std::cout << ", " << r.samplerCache.samplers.size() << " sampler objects for "
+              << r.samplerCache.requests << " requests" << std::endl;
+}
+
+void RendererInit(Renderer &r, const AppOptions &options, std::chrono::steady_clock::time_point startupTime) {
+    r.startupTime = startupTime;
+    GLStateInvalidate();
 
-    // Build and compile shader
+    // Build and compile shader, reusing cached program binaries if possible
     // ---------------------------
-    Shader lightingShader{};
-    ShaderInit(lightingShader, "./colors_vertex.glsl",  "./colors_fragment.glsl");
+    auto shaderStart = std::chrono::steady_clock::now();
+    ShaderCacheInit();
 
-    Shader lightCubeShader{};
-    ShaderInit(lightCubeShader,  "./light_cube_vertex.glsl",  "./light_cube_fragment.glsl");
+    r.lightingShader = {};
+    ShaderInit(r.lightingShader, "./colors_vertex.glsl",  "./colors_fragment.glsl");
 
-    // Setup vertex data
-    // ---------------------------
-    float vertices[] = {
-        // positions          // normals           // texture coords
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-         0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-         0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-         0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
-    };
+    r.lightCubeShader = {};
+    ShaderInit(r.lightCubeShader,  "./light_cube_vertex.glsl",  "./light_cube_fragment.glsl");
 
-    glm::vec3 cubePositions[] = {
-        glm::vec3( 0.0f,  0.0f,  0.0f),
-        glm::vec3( 2.0f,  5.0f, -15.0f),
-        glm::vec3(-1.5f, -2.2f, -2.5f),
-        glm::vec3(-3.8f, -2.0f, -12.3f),
-        glm::vec3( 2.4f, -0.4f, -3.5f),
-        glm::vec3(-1.7f,  3.0f, -7.5f),
-        glm::vec3( 1.3f, -2.0f, -2.5f),
-        glm::vec3( 1.5f,  2.0f, -2.5f),
-        glm::vec3( 1.5f,  0.2f, -1.5f),
-        glm::vec3(-1.3f,  1.0f, -1.5f)
-    };
+    r.gBufferShader = {};
+    ShaderInit(r.gBufferShader, "./colors_vertex.glsl", "./gbuffer_fragment.glsl");
+
+    r.deferredLightingShader = {};
+    ShaderInit(r.deferredLightingShader, "./deferred_vertex.glsl", "./deferred_fragment.glsl");
+
+    double shaderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+    std::cout << "Shader startup: " << shaderMs << " ms, cache " << shaderCache.hits << " hit / "
+              << shaderCache.misses << " miss, " << shaderCache.savedMs << " ms saved" << std::endl;
+
+    // Both programs read view/projection from the same uniform buffer
+    // ---------------------------
+    ShaderBindUniformBlock(r.lightingShader, "FrameConstants", FRAME_CONSTANTS_BINDING);
+    ShaderBindUniformBlock(r.lightCubeShader, "FrameConstants", FRAME_CONSTANTS_BINDING);
+    ShaderBindUniformBlock(r.gBufferShader, "FrameConstants", FRAME_CONSTANTS_BINDING);
+    ShaderBindUniformBlock(r.deferredLightingShader, "FrameConstants", FRAME_CONSTANTS_BINDING);
+    FrameConstantsValidate(r.lightingShader);
+    FrameConstantsValidate(r.lightCubeShader);
+    FrameConstantsValidate(r.gBufferShader);
+    FrameConstantsValidate(r.deferredLightingShader);
+    r.frameConstantsUBO = FrameConstantsCreateBuffer();
 
     // Setup indices
     // ---------------------------
@@ -512,18 +1128,17 @@ glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     // Initialization
     // ---------------------------
-    uint32_t cubeVAO, VBO;
     // uint32_t EBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &VBO);
+    glGenVertexArrays(1, &r.cubeVAO);
+    glGenBuffers(1, &r.VBO);
     // glGenBuffers(1, &EBO);
 
     // 1) Bind vertex buffer object with vertex
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    GLStateBindBuffer(GL_ARRAY_BUFFER, r.VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
 
     // 2) Bind vertex array object first
-    glBindVertexArray(cubeVAO);
+    GLStateBindVertexArray(r.cubeVAO);
 
     // 3) Bind element buffer object with indices
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
@@ -542,132 +1157,985 @@ glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GL_FLOAT), (GLvoid *) (6*sizeof(GL_FLOAT)));
     glEnableVertexAttribArray(2);
 
-    uint32_t lightCubeVAO;
-    glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
+    // 5) Per-instance model and normal matrices
+    // layout (location = 3) in mat4 aModel;
+    // layout (location = 7) in mat3 aNormalMatrix;
+    // Matrices are built and culled on the job pool, which the texture
+    // streamer below shares
+    JobPoolInit(r.jobPool, 0, options.pinJobs);
+    CubeInstancesBuild(r.cubeInstances, r.cubeBounds, r.cubeTransforms, options.instanceCount, &r.jobPool);
+    r.instanceVBO = CubeInstancesCreateBuffer(r.cubeInstances);
+    r.visibleIndices.resize(r.cubeInstances.size());
+    r.visibleCount = 0;
+    r.occlusionCulling = options.occlusion;
+    r.cullBvh = options.cullBvh;
+    if (r.cullBvh) {
+        BvhBuild(r.cubeBvh, r.cubeBounds);
+    }
+    std::cout << "Drawing " << options.instanceCount << " cube instances, culling with "
+              << (r.cullBvh ? "bvh" : CullPathName(CullBestPath())) << ", transforms with " << TransformPathName(TransformBestPath())
+              << ", occlusion "
+              << (r.occlusionCulling ? OcclusionPathName(OcclusionBestPath()) : "off") << std::endl;
+
+    // Scatter the clustered lights over the box around the cube centers
+    // ---------------------------
+    glm::vec3 sceneMin(r.cubeBounds.x[0], r.cubeBounds.y[0], r.cubeBounds.z[0]);
+    glm::vec3 sceneMax = sceneMin;
+    for (uint32_t i = 1; i < (uint32_t)r.cubeBounds.x.size(); ++i) {
+        glm::vec3 center(r.cubeBounds.x[i], r.cubeBounds.y[i], r.cubeBounds.z[i]);
+        sceneMin = glm::min(sceneMin, center);
+        sceneMax = glm::max(sceneMax, center);
+    }
+    // Small scenes get a bigger box, about 3 units apart per light, or
+    // every cluster would be lit by most of them
+    sceneMin -= glm::vec3(2.0f);
+    sceneMax += glm::vec3(2.0f);
+    glm::vec3 extent = sceneMax - sceneMin;
+    float grow = std::cbrt(27.0f * (float)options.lightCount / (extent.x * extent.y * extent.z));
+    if (grow > 1.0f) {
+        glm::vec3 center = (sceneMin + sceneMax) * 0.5f;
+        sceneMin = center - extent * 0.5f * grow;
+        sceneMax = center + extent * 0.5f * grow;
+    }
+    ClusterLightsScatter(r.lights, options.lightCount, sceneMin, sceneMax, 1234);
+    LightClustersGpuInit(r.lightClustersGpu);
+    LightClustersUploadLights(r.lightClustersGpu, r.lights);
+    if (!r.lights.empty()) {
+        std::cout << "Lighting with " << r.lights.size() << " clustered lights, assigned with "
+                  << ClusterPathName(ClusterBestPath()) << std::endl;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glGenVertexArrays(1, &r.lightCubeVAO);
+    GLStateBindVertexArray(r.lightCubeVAO);
+
+    GLStateBindBuffer(GL_ARRAY_BUFFER, r.VBO);
     // layout (location = 0) in vec3 aPos;
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GL_FLOAT), (GLvoid *)0);
     glEnableVertexAttribArray(0);
 
-    // Setup textures
+    // Setup textures, decoded on the job pool and streamed in over the
+    // first frames while a placeholder is bound
     // ---------------------------
-    uint32_t texture1 = loadTexture( "./assets/container2.png");
-    uint32_t texture2 = loadTexture( "./assets/container2_specular.png");
+    ImageCacheInit(r.imageCache, options.imageCache, options.imageCacheBudget);
+    TextureStreamerInit(r.textureStreamer, r.jobPool, &r.imageCache);
+    r.cubeMaterial = TextureStreamerRequest(r.textureStreamer, CUBE_DIFFUSE_MAP, CUBE_SPECULAR_MAP);
+    r.texturesResident = false;
 
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        // ---------------------------
-        float currentTime = (float)glfwGetTime();
-        deltaTime = currentTime - prevTime;
-        prevTime = currentTime;
+    // Filtering is sampler state, shared by every texture read the same way
+    // ---------------------------
+    SamplerCacheInit(r.samplerCache);
+    RendererSetTextureQuality(r, options.textureQuality);
+    r.gBufferSampler = SamplerCacheGet(r.samplerCache, { GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, 1.0f });
 
-        // Input processing
-        // ---------------------------
-        processInput(window);
+    // Forward by default; the G-buffer is only allocated once deferred
+    // shading is first used
+    // ---------------------------
+    r.outputFramebuffer = 0;
+    r.outputWidth = WIDTH;
+    r.outputHeight = HEIGHT;
+    r.deferred = options.deferred;
+    r.gBuffer = {};
+    GpuTimerInit(r.gpuTimers[0]);
+    GpuTimerInit(r.gpuTimers[1]);
+    ProfilerGpuInit();
+}
 
-        // Enable zBuffer
-        // ---------------------------
-        glEnable(GL_DEPTH_TEST);
+// Reorders the visible instances by view depth, nearest first, and
+// returns the depth of the nearest one
+float RendererSortFrontToBack(Renderer &r, const Camera &camera) {
+    uint32_t count = r.visibleCount;
+    r.depthKeys.resize(count);
+    r.depthScratchKeys.resize(count);
+    r.depthScratchIndices.resize(count);
+
+    float nearest = CAMERA_FAR_PLANE;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index = r.visibleIndices[i];
+        glm::vec3 center(r.cubeBounds.x[index], r.cubeBounds.y[index], r.cubeBounds.z[index]);
+        float depth = glm::dot(center - camera.position, camera.front);
+        nearest = std::min(nearest, depth);
+        r.depthKeys[i] = RadixFloatKey(depth);
+    }
+    RadixSort64(r.depthKeys.data(), r.visibleIndices.data(), count, r.depthScratchKeys.data(), r.depthScratchIndices.data());
+    return nearest;
+}
 
-        // Reset pixel
-        // ---------------------------
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// Material, flashlight and light cluster uniforms of whichever program
+// does the lighting
+void RendererSetLighting(Renderer &r, const Shader &s, const Camera &camera) {
+    // uniform Material material;
+    ShaderSetFloat(s, "material.shininess", CUBE_MATERIAL_SHININESS);
+
+    // uniform Light light;
+    SpotLight light = SpotLightFromCamera(camera.position, camera.front);
+    ShaderSetVec3(s, "light.position", light.position);
+    ShaderSetVec3(s, "light.direction", light.direction);
+    ShaderSetFloat(s,"light.cutOff", light.cutOff);
+    ShaderSetFloat(s,"light.outerCutOff", light.outerCutOff);
+    ShaderSetVec3(s, "light.ambient", light.ambient);
+    ShaderSetVec3(s, "light.diffuse", light.diffuse);
+    ShaderSetVec3(s, "light.specular", light.specular);
+
+    ShaderSetFloat(s, "light.constant", light.constant);
+    ShaderSetFloat(s, "light.linear", light.linear);
+    ShaderSetFloat(s, "light.quadratic", light.quadratic);
+
+    ShaderSetInt(s, "clusterLights", CLUSTER_UNIT_LIGHTS);
+    ShaderSetInt(s, "clusterGrid", CLUSTER_UNIT_GRID);
+    ShaderSetInt(s, "clusterIndices", CLUSTER_UNIT_INDICES);
+    ShaderSetFloat(s, "clusterDepthScale", r.lightClusters.depthScale);
+    ShaderSetFloat(s, "clusterDepthBias", r.lightClusters.depthBias);
+}
 
-        // Bind & activate texture
-        // ---------------------------
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
+void RendererDrawFrame(Renderer &r, Camera &camera) {
+    // Upload whatever finished decoding, the draws below pick up the result
+    // ---------------------------
+    {
+        PROFILE_SCOPE("texture streaming");
+        TextureStreamerUpdate(r.textureStreamer);
+        if (!r.texturesResident && TextureStreamerAllResident(r.textureStreamer)) {
+            r.texturesResident = true;
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - r.startupTime).count();
+            std::cout << "All textures resident " << ms << " ms after startup" << std::endl;
+            if (r.imageCache.enabled) {
+                ImageCacheStats stats = ImageCacheGetStats(r.imageCache);
+                std::cout << "Image cache: " << stats.hits << " hit / " << stats.misses << " miss, "
+                          << stats.savedMs << " ms saved, " << stats.bytesMapped / 1024 << " KB mapped, "
+                          << stats.sourcesHashed << " sources hashed, " << stats.evictions << " evicted" << std::endl;
+            }
+        }
+    }
+    GpuTimer &gpuTimer = r.gpuTimers[r.deferred ? 1 : 0];
+    GpuTimerBegin(gpuTimer);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+    // Enable zBuffer
+    // ---------------------------
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, r.outputFramebuffer);
+    GLStateEnable(GL_DEPTH_TEST);
 
-        ShaderUse(lightingShader);
+    // Reset pixel
+    // ---------------------------
+    ProfilerGpuBegin("clear");
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    ProfilerGpuEnd();
+
+    // Per-frame constants, computed once and shared by every program
+    // ---------------------------
+    FrameConstants frameConstants{};
+    const Shader &cubeShader = r.deferred ? r.gBufferShader : r.lightingShader;
+    {
+        PROFILE_SCOPE("uniforms");
+        frameConstants.view = CameraGetViewMatrix(camera);
+        frameConstants.projection = CameraGetPerspective(camera);
+        frameConstants.viewProjection = frameConstants.projection * frameConstants.view;
+        frameConstants.cameraPosition = camera.position;
+        FrameConstantsUpload(r.frameConstantsUBO, frameConstants);
+
+        // The cube program samples the material texture, forward it also lights
+        ShaderUse(cubeShader);
+        ShaderSetInt(cubeShader, "material.diffuseMap", 0);
+    }
+
+    // Bin the clustered lights into the froxels of this view and hand the
+    // lists to the lighting shader through texture buffers
+    // ---------------------------
+    {
+        PROFILE_SCOPE("light clusters");
+        LightClustersSetProjection(r.lightClusters, frameConstants.projection, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+        LightClustersAssign(r.lightClusters, r.lights, frameConstants.view, &r.jobPool);
+        LightClustersUpload(r.lightClustersGpu, r.lightClusters);
+        if (!r.deferred) {
+            RendererSetLighting(r, r.lightingShader, camera);
+        }
+    }
 
-        ShaderSetInt(lightingShader, "material.diffuseMap", 0);
-        ShaderSetInt(lightingShader, "material.specular", 1);
+    // Rebuild matrices of the instances whose transform changed, which in
+    // a static scene is none of them
+    // ---------------------------
+    {
+        PROFILE_SCOPE("transforms");
+        TransformsUpdate(r.cubeTransforms, r.cubeInstances.data(), &r.jobPool);
+    }
 
-        ShaderSetVec3(lightingShader, "cameraPosition", camera.position.x, camera.position.y, camera.position.z); // uniform vec3 cameraPosition;
+    // Frustum cull, then sort the survivors front to back so early-Z can
+    // reject the hidden ones inside the single instanced draw. The nearest
+    // of them then occlude the rest on the CPU. Model and normal matrices
+    // come from the instance buffer
+    // ---------------------------
+    float nearestCube;
+    {
+        PROFILE_SCOPE("culling");
+        Frustum frustum;
+        FrustumFromMatrix(frustum, frameConstants.viewProjection);
+        if (r.cullBvh) {
+            r.visibleCount = BvhQueryFrustum(r.cubeBvh, frustum, r.visibleIndices.data());
+        } else {
+            r.visibleCount = CullSpheresFrustumParallel(frustum, r.cubeBounds, r.visibleIndices.data(), r.jobPool);
+        }
+        nearestCube = RendererSortFrontToBack(r, camera);
+        if (r.occlusionCulling) {
+            r.visibleCount = CubesOcclusionCull(r.occlusion, frameConstants.viewProjection, r.cubeInstances, r.cubeBounds,
+                                                r.visibleIndices.data(), r.visibleCount, &r.jobPool);
+        }
+    }
+    {
+        PROFILE_SCOPE("instance upload");
+        CubeInstancesUpload(r.instanceVBO, r.cubeInstances, r.visibleIndices.data(), r.visibleCount, r.visibleInstances);
+    }
 
-        // uniform Material material;
-        ShaderSetVec3(lightingShader, "material.specular", 0.628281f,	0.555802f,	0.366065f);
-        ShaderSetFloat(lightingShader, "material.shininess", 32.0f);
+    // Record both draws, then sort and submit them
+    // ---------------------------
+    PROFILE_SCOPE("draw");
+    RenderQueue &q = r.renderQueue;
+    RenderQueueReset(q);
+
+    RenderCommand cubes{};
+    cubes.program = cubeShader.ID;
+    cubes.vertexArray = r.cubeVAO;
+    cubes.textures[0] = TextureStreamerResolve(r.textureStreamer, r.cubeMaterial);
+    cubes.samplers[0] = r.materialSampler;
+    cubes.modelLocation = -1;
+    cubes.vertexCount = CUBE_VERTEX_COUNT;
+    cubes.instanceCount = r.visibleCount;
+    cubes.key = RenderSortKey(RENDER_PASS_OPAQUE, cubes.program,
+                              RenderQueueTextureSet(q, cubes.textures[0], cubes.textures[1]),
+                              cubes.vertexArray, CameraNormalizedDepth(nearestCube));
+    RenderQueuePush(q, cubes);
+
+    // Deferred: the cubes fill the G-buffer, one full screen pass lights
+    // every pixel, and the light cube is drawn forward on top of it
+    // ---------------------------
+    if (r.deferred) {
+        ProfilerGpuBegin("geometry");
+        GBufferInit(r.gBuffer, r.outputWidth, r.outputHeight);
+        GBufferBeginGeometry(r.gBuffer);
+        RenderQueueSort(q);
+        RenderQueueSubmit(q);
+        RenderQueueReset(q);
+        ProfilerGpuEnd();
+
+        ProfilerGpuBegin("lighting");
+        GLStateBindFramebuffer(GL_FRAMEBUFFER, r.outputFramebuffer);
+        GLStateDisable(GL_DEPTH_TEST);
+        ShaderUse(r.deferredLightingShader);
+        RendererSetLighting(r, r.deferredLightingShader, camera);
+        ShaderSetInt(r.deferredLightingShader, "gAlbedoSpecular", GBUFFER_UNIT_ALBEDO);
+        ShaderSetInt(r.deferredLightingShader, "gNormal", GBUFFER_UNIT_NORMAL);
+        ShaderSetInt(r.deferredLightingShader, "gDepth", GBUFFER_UNIT_DEPTH);
+        glm::mat4 inverseViewProjection = glm::inverse(frameConstants.viewProjection);
+        ShaderSetTransformation(r.deferredLightingShader, "inverseViewProjection", glm::value_ptr(inverseViewProjection));
+        GBufferBindTextures(r.gBuffer, r.gBufferSampler);
+        GBufferDrawFullscreen(r.gBuffer);
+        ProfilerGpuEnd();
+
+        ProfilerGpuBegin("depth copy");
+        GBufferCopyDepth(r.gBuffer, r.outputFramebuffer);
+        GLStateEnable(GL_DEPTH_TEST);
+        ProfilerGpuEnd();
+    }
 
-        glm::vec3 lightColor(1.0f);
-        glm::vec3 diffuse = lightColor * glm::vec3(0.9f);
-        glm::vec3 ambient = diffuse * glm::vec3(0.5f);
+    RenderCommand lightCube{};
+    lightCube.program = r.lightCubeShader.ID;
+    lightCube.vertexArray = r.lightCubeVAO;
+    lightCube.modelLocation = ShaderGetUniformLocation(r.lightCubeShader, "model");
+    lightCube.modelIndex = RenderQueueAddModel(q, LightCubeModel());
+    lightCube.vertexCount = CUBE_VERTEX_COUNT;
+    lightCube.instanceCount = 1;
+    lightCube.key = RenderSortKey(RENDER_PASS_OPAQUE, lightCube.program, RenderQueueTextureSet(q, 0, 0),
+                                  lightCube.vertexArray, CameraNormalizedDepth(glm::dot(lightPosition - camera.position, camera.front)));
+    RenderQueuePush(q, lightCube);
+
+    ProfilerGpuBegin("forward");
+    RenderQueueSort(q);
+    RenderQueueSubmit(q);
+    ProfilerGpuEnd();
+    GpuTimerEnd(gpuTimer);
+    ProfilerGpuFrameEnd();
+}
 
-        glm::vec3 lightDirection(-0.2f, -1.0f, -0.3f);
+void RendererShutdown(Renderer &r) {
+    LightClustersGpuShutdown(r.lightClustersGpu);
+    GBufferShutdown(r.gBuffer);
+    GpuTimerShutdown(r.gpuTimers[0]);
+    GpuTimerShutdown(r.gpuTimers[1]);
+    ProfilerGpuShutdown();
+    JobPoolShutdown(r.jobPool);
+    TextureStreamerShutdown(r.textureStreamer);
+    ImageCacheShutdown(r.imageCache);
+    SamplerCacheShutdown(r.samplerCache);
+}
 
-        // uniform Light light;
-        ShaderSetVec3(lightingShader, "light.position", camera.position);
-        ShaderSetVec3(lightingShader, "light.direction", camera.front);
-        ShaderSetFloat(lightingShader,"light.cutOff", glm::cos(glm::radians(12.5f)));
-        ShaderSetFloat(lightingShader,"light.outerCutOff", glm::cos(glm::radians(20.5f)));
-        ShaderSetVec3(lightingShader, "light.ambient", ambient);
-        ShaderSetVec3(lightingShader, "light.diffuse", diffuse);
-        ShaderSetVec3(lightingShader, "light.specular", glm::vec3(1.0f, 1.0f, 1.0f));
+// Benchmark
+// Renders a scripted camera path with a fixed timestep so that runs are
+// comparable between commits, independent of input and wall-clock time.
+// -------------------------------------
+#define BENCH_DELTA_TIME (1.0f / 60.0f)
+#define BENCH_WARMUP_FRAMES 60
+#define BENCH_STREAM_TIMEOUT_FRAMES 10000
+
+struct BenchCameraStep {
+    bool move;
+    CameraMoveDirection direction;
+    float xOffset; // fed to CameraRotate every frame, like mouse deltas
+    float yOffset;
+    uint32_t frames;
+};
 
-        ShaderSetFloat(lightingShader, "light.constant", 1.0f);
-        ShaderSetFloat(lightingShader, "light.linear", 0.09f);
-        ShaderSetFloat(lightingShader, "light.quadratic", 0.032f);
+// Walk into the cubes, look around, strafe across and back out again
+const BenchCameraStep benchCameraPath[] = {
+    { true,  FORWARD,   0.0f,  0.0f, 180 },
+    { false, FORWARD,  -6.0f,  0.0f, 120 },
+    { true,  RIGHT,     0.0f, -1.5f, 180 },
+    { true,  FORWARD,   4.0f,  1.5f, 240 },
+    { false, FORWARD,  12.0f,  0.0f, 150 },
+    { true,  BACKWARD, -3.0f,  0.0f, 240 },
+};
 
-        // View matrix
-        auto view = CameraGetViewMatrix(camera);
-        ShaderSetTransformation(lightingShader, "view", glm::value_ptr(view));
+// Moves the camera to where the path puts it on the given frame. The path
+// restarts from the start camera once it runs out.
+void BenchCameraAdvance(Camera &c, const Camera &start, uint32_t frame) {
+    uint32_t pathFrames = 0;
+    for (const BenchCameraStep &step : benchCameraPath) {
+        pathFrames += step.frames;
+    }
 
-        // Perspective
-        auto perspective = CameraGetPerspective(camera);
-        ShaderSetTransformation(lightingShader, "perspective", glm::value_ptr(perspective));
+    uint32_t t = frame % pathFrames;
+    if (t == 0) {
+        c = start;
+    }
+    for (const BenchCameraStep &step : benchCameraPath) {
+        if (t < step.frames) {
+            CameraRotate(c, step.xOffset, step.yOffset);
+            if (step.move) {
+                CameraMove(c, step.direction, BENCH_DELTA_TIME);
+            }
+            return;
+        }
+        t -= step.frames;
+    }
+}
 
-        for (int i = 0; i < 10; ++i) {
-            // Model matrix
-            glm::mat4 model(1.0f);
-            model = glm::translate(model, cubePositions[i]);
-            model = glm::rotate(model, glm::radians(90.0f)*i, glm::vec3(0.0, -0.69f, 1.0));
-            ShaderSetTransformation(lightingShader, "model", glm::value_ptr(model));
+// Nearest-rank percentile of an ascending list
+double BenchPercentile(const std::vector<double> &sorted, double p) {
+    size_t rank = (size_t)std::ceil(p * (double)sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
 
-            // Normal matrix
-            glm::mat3 normalMatrix(glm::inverse(model));
-            int transformLocation = glGetUniformLocation(lightingShader.ID,  "normalMatrix");
-            assert(transformLocation != -1);
-            glUniformMatrix3fv(transformLocation, 1, GL_TRUE, glm::value_ptr(normalMatrix));  // uniform mat3 normalMatrix;
+// Tries the requested context kind, or each of them in turn for "auto".
+// OSMesa and EGL go through GLFW's null platform and need no display.
+GLFWwindow *BenchCreateContext(const char *context) {
+    struct Attempt {
+        const char *name;
+        int platform;
+        int api;
+    };
+    const Attempt attempts[] = {
+        { "osmesa", GLFW_PLATFORM_NULL, GLFW_OSMESA_CONTEXT_API },
+        { "egl",    GLFW_PLATFORM_NULL, GLFW_EGL_CONTEXT_API },
+        { "hidden", GLFW_ANY_PLATFORM,  GLFW_NATIVE_CONTEXT_API },
+    };
 
-            // Draw
-            // ---------------------------
-            glBindVertexArray(cubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+    for (const Attempt &a : attempts) {
+        if (strcmp(context, "auto") != 0 && strcmp(context, a.name) != 0) {
+            continue;
+        }
+        glfwInitHint(GLFW_PLATFORM, a.platform);
+        if (!glfwInit()) {
+            continue;
         }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, a.api);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "LearnOpenGL bench", NULL, NULL);
+        if (window != NULL) {
+            glfwMakeContextCurrent(window);
+            std::cout << "Benchmark context: " << a.name << std::endl;
+            return window;
+        }
+        glfwTerminate();
+    }
+    return nullptr;
+}
 
+// Surfaceless contexts have no default framebuffer, so every benchmark
+// renders into its own
+struct BenchTarget {
+    uint32_t FBO;
+    uint32_t colorRBO;
+    uint32_t depthRBO;
+};
+
+void BenchTargetInit(BenchTarget &t) {
+    glGenRenderbuffers(1, &t.colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, t.colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+
+    glGenRenderbuffers(1, &t.depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, t.depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WIDTH, HEIGHT);
+
+    glGenFramebuffers(1, &t.FBO);
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, t.FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, t.colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, t.depthRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Benchmark framebuffer is incomplete" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    glViewport(0, 0, WIDTH, HEIGHT);
+}
+
+void BenchTargetShutdown(BenchTarget &t) {
+    GLStateBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateDeleteFramebuffers(1, &t.FBO);
+    glDeleteRenderbuffers(1, &t.colorRBO);
+    glDeleteRenderbuffers(1, &t.depthRBO);
+}
+
+// Draws until texture streaming has settled so the timed frames all see
+// the final textures
+void BenchWarmup(Renderer &r, Camera &camera) {
+    for (uint32_t frame = 0; frame < BENCH_STREAM_TIMEOUT_FRAMES; ++frame) {
+        RendererDrawFrame(r, camera);
+        glFinish();
+        if (frame + 1 >= BENCH_WARMUP_FRAMES && r.texturesResident) {
+            break;
+        }
+    }
+    if (!r.texturesResident) {
+        std::cerr << "Textures did not finish streaming, timings include placeholders" << std::endl;
+    }
+}
+
+// Times `frames` frames of the scripted path. glFinish keeps GPU work
+// inside the frame it belongs to.
+void BenchRun(Renderer &r, Camera &camera, uint32_t frames) {
+    const Camera start = camera;
+
+    std::vector<double> frameMs(frames);
+    uint64_t visibleTotal = 0;
+    GLStateResetCounters();
+    GpuTimer &gpuTimer = r.gpuTimers[r.deferred ? 1 : 0];
+    GpuTimerReset(gpuTimer);
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        PROFILE_SCOPE("frame");
+        auto frameStart = std::chrono::steady_clock::now();
+        BenchCameraAdvance(camera, start, frame);
+        RendererDrawFrame(r, camera);
         {
-            ShaderUse(lightCubeShader);
+            PROFILE_SCOPE("finish");
+            glFinish();
+        }
+        frameMs[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        visibleTotal += r.visibleCount;
+    }
+
+    double totalMs = 0.0;
+    for (double ms : frameMs) {
+        totalMs += ms;
+    }
+    std::sort(frameMs.begin(), frameMs.end());
+
+    // The visible count and final position only depend on the path, so a
+    // change in either means the runs are not rendering the same frames
+    std::cout << "Renderer: " << (const char *)glGetString(GL_RENDERER) << std::endl;
+    std::cout << frames << " frames, " << r.cubeInstances.size() << " instances, "
+              << (double)visibleTotal / frames << " visible on average, camera ends at ("
+              << camera.position.x << ", " << camera.position.y << ", " << camera.position.z << ")" << std::endl;
+    std::cout << "frame ms: mean " << totalMs / frames
+              << ", p50 " << BenchPercentile(frameMs, 0.50)
+              << ", p95 " << BenchPercentile(frameMs, 0.95)
+              << ", p99 " << BenchPercentile(frameMs, 0.99)
+              << ", max " << frameMs.back() << std::endl;
+    std::cout << (r.deferred ? "deferred" : "forward") << " gpu ms: mean " << GpuTimerAverageMs(gpuTimer)
+              << " over " << gpuTimer.samples << " frames" << std::endl;
+    std::cout << "State cache per frame: " << GLStateGetCounters().issued / frames << " issued, "
+              << GLStateGetCounters().elided / frames << " elided" << std::endl;
+}
+
+// Runs the path with the renderer's shading, or forward and then deferred
+// from the same start camera, or once per texture filter tier
+void BenchRunShading(Renderer &r, Camera &camera, const AppOptions &options) {
+    const Camera start = camera;
+    if (options.benchFilters) {
+        const SamplerQuality tiers[] = {
+            { SAMPLER_TIER_NEAREST, 1 },
+            { SAMPLER_TIER_BILINEAR, 1 },
+            { SAMPLER_TIER_TRILINEAR, 1 },
+            { SAMPLER_TIER_ANISOTROPIC, SAMPLER_MAX_ANISOTROPY },
+        };
+        for (const SamplerQuality &tier : tiers) {
+            camera = start;
+            RendererSetTextureQuality(r, tier);
+            BenchWarmup(r, camera);
+            camera = start;
+            BenchRun(r, camera, options.frames);
+        }
+        return;
+    }
+    if (!options.benchDeferred) {
+        BenchRun(r, camera, options.frames);
+        return;
+    }
+    for (int deferred = 0; deferred < 2; ++deferred) {
+        camera = start;
+        r.deferred = deferred != 0;
+        BenchWarmup(r, camera);
+        camera = start;
+        BenchRun(r, camera, options.frames);
+    }
+}
+
+// Software rasterizer benchmark
+// Renders the scripted path with the software backend at 1, 2, 4, ...
+// threads up to the hardware thread count and reports frames per second,
+// once sampling the diffuse and specular maps apart and once the packed
+// material texture the GL path uses.
+// -------------------------------------
+void SwrBenchmark(const AppOptions &options, const Camera &startCamera) {
+    std::vector<CubeInstance> instances;
+    CullSpheres bounds;
+    Transforms transforms;
+    CubeInstancesBuild(instances, bounds, transforms, options.instanceCount, nullptr);
+    std::vector<uint32_t> visible(instances.size());
+
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < hardware; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardware);
+
+    std::cout << "Software rasterizer, " << WIDTH << "x" << HEIGHT << ", " << instances.size()
+              << " instances, " << options.frames << " frames" << std::endl;
+    for (uint32_t threads : threadCounts) {
+        for (int packed = 0; packed < 2; ++packed) {
+            SwrContext ctx;
+            SwrInit(ctx, WIDTH, HEIGHT, threads, CUBE_DIFFUSE_MAP, CUBE_SPECULAR_MAP, packed != 0);
+
+            Camera c = startCamera;
+            std::vector<double> frameMs(options.frames);
+            uint64_t textureBytes = 0;
+            for (uint32_t frame = 0; frame < options.frames; ++frame) {
+                auto frameStart = std::chrono::steady_clock::now();
+                BenchCameraAdvance(c, startCamera, frame);
+
+                SwrFrame f;
+                f.viewProjection = CameraGetPerspective(c) * CameraGetViewMatrix(c);
+                f.cameraPosition = c.position;
+                f.light = SpotLightFromCamera(c.position, c.front);
+                f.instances = instances.data();
+                f.visible = visible.data();
+                f.lightCubeModel = LightCubeModel();
+
+                Frustum frustum;
+                FrustumFromMatrix(frustum, f.viewProjection);
+                f.visibleCount = CullSpheresFrustum(frustum, bounds, visible.data());
+
+                SwrRenderFrame(ctx, f);
+                frameMs[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+                textureBytes += ctx.textureBytes;
+            }
+
+            double totalMs = 0.0;
+            for (double ms : frameMs) {
+                totalMs += ms;
+            }
+            std::sort(frameMs.begin(), frameMs.end());
+            std::cout << "  " << threads << (threads == 1 ? " thread,  " : " threads, ") << (packed ? "packed material: " : "separate maps:   ")
+                      << 1000.0 * options.frames / totalMs << " fps, p50 " << BenchPercentile(frameMs, 0.50)
+                      << " ms, p99 " << BenchPercentile(frameMs, 0.99) << " ms, texture lines touched "
+                      << (double)textureBytes / options.frames / (1024.0 * 1024.0) << " MB/frame" << std::endl;
+
+            if (options.swrDump && packed && threads == threadCounts.back() && !SwrWritePPM(ctx, options.swrDump)) {
+                std::cerr << "Failed to write " << options.swrDump << std::endl;
+            }
+            SwrShutdown(ctx);
+        }
+    }
+}
+
+// CPU only: the frustum survivors of every frame along the bench camera
+// path go through the occlusion culler, once per raster path
+// ---------------------------
+void OcclusionBenchmark(const AppOptions &options, const Camera &startCamera) {
+    std::vector<CubeInstance> instances;
+    CullSpheres bounds;
+    Transforms transforms;
+    CubeInstancesBuild(instances, bounds, transforms, options.instanceCount, nullptr);
+    std::vector<uint32_t> visible(instances.size());
+    std::vector<float> depths(instances.size());
+
+    std::cout << "Occlusion culling, " << OCCLUSION_WIDTH << "x" << OCCLUSION_HEIGHT << " depth, " << instances.size()
+              << " instances, up to " << OCCLUSION_MAX_OCCLUDERS << " occluders, " << options.frames << " frames" << std::endl;
+
+    std::vector<float> referenceDepth;
+    const OcclusionPath paths[] = { OCCLUSION_PATH_SCALAR, OCCLUSION_PATH_AVX };
+    for (OcclusionPath path : paths) {
+        if (path == OCCLUSION_PATH_AVX && !CpuGetFeatures().avx) {
+            continue;
+        }
+
+        OcclusionBuffer occlusion;
+        Camera c = startCamera;
+        double rasterMs = 0.0, pyramidMs = 0.0, testMs = 0.0;
+        uint64_t frustumVisible = 0, occlusionVisible = 0, triangles = 0;
+        for (uint32_t frame = 0; frame < options.frames; ++frame) {
+            BenchCameraAdvance(c, startCamera, frame);
+            glm::mat4 viewProjection = CameraGetPerspective(c) * CameraGetViewMatrix(c);
+
+            Frustum frustum;
+            FrustumFromMatrix(frustum, viewProjection);
+            uint32_t count = CullSpheresFrustum(frustum, bounds, visible.data());
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t index = visible[i];
+                depths[index] = glm::dot(glm::vec3(bounds.x[index], bounds.y[index], bounds.z[index]) - c.position, c.front);
+            }
+            std::sort(visible.begin(), visible.begin() + count, [&depths](uint32_t a, uint32_t b) {
+                return depths[a] < depths[b];
+            });
+
+            auto start = std::chrono::steady_clock::now();
+            OcclusionClear(occlusion, viewProjection);
+            uint32_t occluders = std::min<uint32_t>(count, OCCLUSION_MAX_OCCLUDERS);
+            for (uint32_t i = 0; i < occluders; ++i) {
+                OcclusionRasterizeCube(occlusion, instances[visible[i]].model, path);
+            }
+            auto rasterEnd = std::chrono::steady_clock::now();
+            OcclusionBuildPyramid(occlusion);
+            auto pyramidEnd = std::chrono::steady_clock::now();
+            uint32_t survivors = OcclusionCullSpheres(occlusion, bounds, visible.data(), count);
+            auto testEnd = std::chrono::steady_clock::now();
+
+            rasterMs += std::chrono::duration<double, std::milli>(rasterEnd - start).count();
+            pyramidMs += std::chrono::duration<double, std::milli>(pyramidEnd - rasterEnd).count();
+            testMs += std::chrono::duration<double, std::milli>(testEnd - pyramidEnd).count();
+            frustumVisible += count;
+            occlusionVisible += survivors;
+            triangles += occlusion.occluderTriangles;
+        }
+
+        // Both paths raster the same last frame, compare their depth
+        float maxError = 0.0f;
+        if (referenceDepth.empty()) {
+            referenceDepth = occlusion.depth;
+        } else {
+            for (size_t i = 0; i < referenceDepth.size(); ++i) {
+                maxError = std::max(maxError, std::abs(referenceDepth[i] - occlusion.depth[i]));
+            }
+        }
+
+        double frames = (double)options.frames;
+        std::cout << "  " << OcclusionPathName(path) << ": raster " << rasterMs / frames << " ms ("
+                  << triangles / options.frames << " triangles), pyramid " << pyramidMs / frames << " ms, test "
+                  << testMs / frames << " ms per frame" << std::endl;
+        std::cout << "    visible per frame: " << frustumVisible / frames << " after frustum, "
+                  << occlusionVisible / frames << " after occlusion";
+        if (path != OCCLUSION_PATH_SCALAR) {
+            std::cout << ", max depth difference vs scalar " << maxError;
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+AppOptions options;
+AppOptionsParse(options, argc, argv);
+PngDecodeInit();
+
+if (options.benchCull) {
+    CullBenchmark();
+    return 0;
+}
+
+if (options.benchQueue) {
+    RenderQueueBenchmark();
+    return 0;
+}
+
+if (options.benchTransforms) {
+    JobPool pool;
+    JobPoolInit(pool, 0, options.pinJobs);
+    TransformBenchmark(pool);
+    JobPoolShutdown(pool);
+    return 0;
+}
+
+if (options.benchBvh) {
+    BvhBenchmark();
+    return 0;
+}
+
+if (options.benchLights) {
+    JobPool pool;
+    JobPoolInit(pool, 0, options.pinJobs);
+    LightClustersBenchmark(pool);
+    JobPoolShutdown(pool);
+    return 0;
+}
+
+if (options.benchJobs) {
+    JobBenchmark(options.pinJobs);
+    return 0;
+}
+
+if (options.benchPng) {
+    PngDecodeBenchmark();
+    return 0;
+}
+
+if (options.benchBc) {
+    JobPool pool;
+    JobPoolInit(pool, 0, options.pinJobs);
+    BcBenchmark(pool);
+    JobPoolShutdown(pool);
+    return 0;
+}
 
-            // Model matrix
-            glm::mat4 model(1.0f);
-            model = glm::translate(model, glm::vec3(lightPosition));
-            model = glm::scale(model, glm::vec3(0.2f));
-            ShaderSetTransformation(lightCubeShader, "model", glm::value_ptr(model));
+if (options.cook) {
+    JobPool pool;
+    JobPoolInit(pool, 0, options.pinJobs);
+    int failures = CookAllTextures("./assets", options.cookFormat, &pool);
+    if (!CookPackedTexture(CUBE_DIFFUSE_MAP, CUBE_SPECULAR_MAP,
+                           CookedTexturePackedPath(CUBE_DIFFUSE_MAP, CUBE_SPECULAR_MAP).c_str(), options.cookFormat, &pool)) {
+        failures++;
+    }
+    JobPoolShutdown(pool);
+    return failures == 0 ? 0 : 1;
+}
+
+auto startupTime = std::chrono::steady_clock::now();
+
+
+// Initialize app
+// ---------------------------
+CameraInit(
+    camera,
+    glm::vec3(0.0f, 0.0f, 4.0f), // position
+    glm::vec3(0.0f, 1.0f, 0.0f), // up
+    -64.0f,                      // yaw
+    16.0f,                        // pitch
+    45.0f                        // fov
+);
 
-            // View matrix
-            auto view = CameraGetViewMatrix(camera);
-            ShaderSetTransformation(lightCubeShader, "view", glm::value_ptr(view));
+if (options.benchSwr) {
+    SwrBenchmark(options, camera);
+    return 0;
+}
 
-            // Perspective
-            auto perspective = CameraGetPerspective(camera);
-            ShaderSetTransformation(lightCubeShader, "perspective", glm::value_ptr(perspective));
+if (options.benchOcclusion) {
+    OcclusionBenchmark(options, camera);
+    return 0;
+}
 
-            // Draw
-            // ---------------------------
-            glBindVertexArray(lightCubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+// Headless run against the null driver, no window or context needed
+// ---------------------------
+if (options.nullGL) {
+    NullGLLoad();
+    Renderer renderer;
+    RendererInit(renderer, options, startupTime);
+
+    if (options.bench) {
+        BenchWarmup(renderer, camera);
+        NullGLResetCounters();
+        BenchRun(renderer, camera, options.frames);
+        NullGLReport(options.frames);
+        RendererShutdown(renderer);
+        if (options.tracePath) {
+            ProfilerWriteChromeTrace(options.tracePath);
         }
+        return 0;
+    }
+
+    NullGLResetCounters();
+    GLStateResetCounters();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < options.frames; ++frame) {
+        PROFILE_SCOPE("frame");
+        RendererDrawFrame(renderer, camera);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << options.frames << " frames against null GL: " << ms / options.frames << " ms CPU per frame, "
+              << renderer.visibleCount << "/" << renderer.cubeInstances.size() << " instances visible" << std::endl;
+    std::cout << "State cache per frame: " << GLStateGetCounters().issued / options.frames << " issued, "
+              << GLStateGetCounters().elided / options.frames << " elided" << std::endl;
+    NullGLReport(options.frames);
+    RendererShutdown(renderer);
+    if (options.tracePath) {
+        ProfilerWriteChromeTrace(options.tracePath);
+    }
+    return 0;
+}
+
+// Headless scripted run on an offscreen context
+// ---------------------------
+if (options.bench) {
+    GLFWwindow *window = BenchCreateContext(options.benchContext);
+    if (window == NULL) {
+        std::cerr << "Failed to create an offscreen context (" << options.benchContext << ")" << std::endl;
+        return -1;
+    }
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initalize GLAD" << std::endl;
+        return -1;
+    }
+    glfwSwapInterval(0);
+
+    Renderer renderer;
+    RendererInit(renderer, options, startupTime);
+    BenchTarget target;
+    BenchTargetInit(target);
+    renderer.outputFramebuffer = target.FBO;
+
+    BenchWarmup(renderer, camera);
+    BenchRunShading(renderer, camera, options);
+
+    BenchTargetShutdown(target);
+    RendererShutdown(renderer);
+    if (options.tracePath) {
+        ProfilerWriteChromeTrace(options.tracePath);
+    }
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
+
+// Initialize OpenGL
+// ---------------------------
+glfwInit();
+glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+// Window Creation
+    // ---------------------------
+    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Hello from OpenGL", NULL, NULL);
+    if (window == NULL) {
+        std::cerr << "Failed to create a window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
+
+    // Registering mouse callbacks
+    // ---------------------------
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    glfwSetScrollCallback(window, scrollCallback);
+    glfwSetKeyCallback(window, keyCallback);
+
+    // Load OpenGL functions
+    // ---------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initalize GLAD" << std::endl;
+        return -1;
+    }
+
+    Renderer renderer;
+    RendererInit(renderer, options, startupTime);
+
+    FrameClock clock;
+    FrameClockInit(clock);
+    FrameHistogram statsHistogram;   // since the last report
+    FrameHistogram sessionHistogram; // whole run, printed at exit
+    FrameHistogramReset(statsHistogram);
+    FrameHistogramReset(sessionHistogram);
+    uint64_t prevStatsNs = clock.lastNs;
+    prevCameraPosition = camera.position;
+    while (!glfwWindowShouldClose(window)) {
+        PROFILE_SCOPE("frame");
+
+        // per-frame time logic
+        // ---------------------------
+        uint32_t steps = FrameClockAdvance(clock);
+        if (clock.frames > 1) {
+            double frameMs = (double)clock.frameNs * 1.0e-6;
+            FrameHistogramAdd(statsHistogram, frameMs);
+            FrameHistogramAdd(sessionHistogram, frameMs);
+        }
+
+        // Report frame times and last frame's uniform lookups once per second
+        // ---------------------------
+        if (clock.lastNs - prevStatsNs >= 1000000000ull && statsHistogram.count > 0) {
+            const FrameHistogram &h = statsHistogram;
+            GpuTimer &gpuTimer = renderer.gpuTimers[renderer.deferred ? 1 : 0];
+            std::cout << "frame min " << h.minMs << " avg " << FrameHistogramMean(h) << " p99 " << FrameHistogramPercentile(h, 0.99)
+                      << " max " << h.maxMs << " ms (" << renderer.visibleCount << "/" << renderer.cubeInstances.size() << " instances visible)"
+                      << ", " << (renderer.deferred ? "deferred" : "forward") << " gpu " << GpuTimerAverageMs(gpuTimer) << " ms"
+                      << ", uniform lookups per frame: driver " << shaderStats.driverLookups
+                      << ", table " << shaderStats.tableLookups
+                      << ", state calls issued " << GLStateGetCounters().issued
+                      << ", elided " << GLStateGetCounters().elided << std::endl;
+            prevStatsNs = clock.lastNs;
+            FrameHistogramReset(statsHistogram);
+            GpuTimerReset(gpuTimer);
+        }
+        shaderStats = {};
+        GLStateResetCounters();
+
+        // Input processing
+        // ---------------------------
+        {
+            PROFILE_SCOPE("input");
+            // Movement runs at the fixed rate whatever the frame rate is;
+            // mouse look stays immediate in the callbacks
+            for (uint32_t step = 0; step < steps; ++step) {
+                prevCameraPosition = camera.position;
+                processInput(window, (float)FrameClockStepSeconds());
+            }
+            if (toggleShadingPath) {
+                toggleShadingPath = false;
+                renderer.deferred = !renderer.deferred;
+                std::cout << "Switched to " << (renderer.deferred ? "deferred" : "forward") << " shading" << std::endl;
+            }
+            if (cycleTextureFilter) {
+                cycleTextureFilter = false;
+                RendererSetTextureQuality(renderer, SamplerQualityNext(renderer.textureQuality));
+            }
+            if (dumpTrace) {
+                dumpTrace = false;
+                ProfilerWriteChromeTrace(options.tracePath ? options.tracePath : "trace.json");
+            }
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            renderer.outputWidth = (uint32_t)std::max(framebufferWidth, 1);
+            renderer.outputHeight = (uint32_t)std::max(framebufferHeight, 1);
+        }
+
+        // Draw the camera where it is between the last two steps
+        // ---------------------------
+        Camera frameCamera = camera;
+        frameCamera.position = glm::mix(prevCameraPosition, camera.position, (float)FrameClockAlpha(clock));
+        RendererDrawFrame(renderer, frameCamera);
 
         // Swap buffer and poll IO events
         // ---------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+        }
+        {
+            PROFILE_SCOPE("poll events");
+            glfwPollEvents();
+        }
+    }
+
+    const FrameHistogram &h = sessionHistogram;
+    std::cout << "session " << FrameClockSeconds(clock) << " s, " << h.count << " frames: min " << h.minMs
+              << " avg " << FrameHistogramMean(h) << " p50 " << FrameHistogramPercentile(h, 0.5)
+              << " p99 " << FrameHistogramPercentile(h, 0.99) << " max " << h.maxMs << " ms, "
+              << (double)clock.droppedNs * 1.0e-6 << " ms of simulation dropped" << std::endl;
+
+    RendererShutdown(renderer);
+    if (options.tracePath) {
+        ProfilerWriteChromeTrace(options.tracePath);
     }
 
     glfwTerminate();
@@ -0,0 +1,81 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+bool MappedFileOpen(MappedFile &f, const char *path) {
+    f = {};
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    f.data = (const uint8_t *)view;
+    f.size = (size_t)size.QuadPart;
+    f.file = file;
+    f.mapping = mapping;
+    return true;
+}
+
+void MappedFileClose(MappedFile &f) {
+    if (f.data) {
+        UnmapViewOfFile(f.data);
+        CloseHandle((HANDLE)f.mapping);
+        CloseHandle((HANDLE)f.file);
+    }
+    f = {};
+}
+#else
+bool MappedFileOpen(MappedFile &f, const char *path) {
+    f = {};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    f.data = (const uint8_t *)view;
+    f.size = (size_t)st.st_size;
+    return true;
+}
+
+void MappedFileClose(MappedFile &f) {
+    if (f.data) {
+        munmap((void *)f.data, f.size);
+    }
+    f = {};
+}
+#endif
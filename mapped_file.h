@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapped file
+// -------------------------------------
+struct MappedFile {
+    const uint8_t *data;
+    size_t size;
+#if defined(_WIN32)
+    void *file;
+    void *mapping;
+#endif
+};
+
+bool MappedFileOpen(MappedFile &f, const char *path);
+void MappedFileClose(MappedFile &f);
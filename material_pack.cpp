@@ -0,0 +1,37 @@
+#include "material_pack.h"
+#include "stb_image.h"
+
+#include <filesystem>
+#include <iostream>
+
+uint8_t *MaterialPackLoad(const char *diffusePath, const char *specularPath, int &width, int &height) {
+    int channels, specularWidth, specularHeight;
+    stbi_set_flip_vertically_on_load_thread(true);
+    uint8_t *pixels = stbi_load(diffusePath, &width, &height, &channels, 4);
+    if (!pixels) {
+        std::cerr << "Cannot load " << diffusePath << " : " << stbi_failure_reason() << std::endl;
+        return nullptr;
+    }
+    // One channel requested, stb_image reduces color to luminance
+    uint8_t *specular = stbi_load(specularPath, &specularWidth, &specularHeight, &channels, 1);
+    if (!specular) {
+        std::cerr << "Cannot load " << specularPath << " : " << stbi_failure_reason() << std::endl;
+        stbi_image_free(pixels);
+        return nullptr;
+    }
+
+    for (int y = 0; y < height; ++y) {
+        int sy = (int)((int64_t)y * specularHeight / height);
+        for (int x = 0; x < width; ++x) {
+            int sx = (int)((int64_t)x * specularWidth / width);
+            pixels[((size_t)y * width + x) * 4 + 3] = specular[(size_t)sy * specularWidth + sx];
+        }
+    }
+    stbi_image_free(specular);
+    return pixels;
+}
+
+std::string MaterialPackName(const char *diffusePath, const char *specularPath) {
+    return std::filesystem::path(diffusePath).filename().string() + "+" +
+           std::filesystem::path(specularPath).filename().string();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Material packing
+// The cube material's specular map is grey, so it fits in the unused alpha
+// channel of its diffuse map. One RGBA texture then serves both: one bind
+// and one sampler per material, and the shaders fetch each texel once
+// instead of once per map. A specular map of another size is point
+// sampled to the diffuse map's size.
+// -------------------------------------
+
+// Diffuse rgb with specular in alpha, width * height RGBA8 flipped for GL.
+// Free with stbi_image_free. nullptr when either map can't be loaded.
+uint8_t *MaterialPackLoad(const char *diffusePath, const char *specularPath, int &width, int &height);
+
+// "./assets/a.png" + "./assets/b.png" -> "a.png+b.png", names the packed
+// texture in logs and cooked files
+std::string MaterialPackName(const char *diffusePath, const char *specularPath);
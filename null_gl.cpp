@@ -0,0 +1,916 @@
+#include "null_gl.h"
+
+#include <glad/glad.h>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+
+// Every entry point glad loads for GL 3.3 core
+// ---------------------------
+#define NULL_GL_ENTRY_POINTS(X) \
+    X(glActiveTexture, PFNGLACTIVETEXTUREPROC) \
+    X(glAttachShader, PFNGLATTACHSHADERPROC) \
+    X(glBeginConditionalRender, PFNGLBEGINCONDITIONALRENDERPROC) \
+    X(glBeginQuery, PFNGLBEGINQUERYPROC) \
+    X(glBeginTransformFeedback, PFNGLBEGINTRANSFORMFEEDBACKPROC) \
+    X(glBindAttribLocation, PFNGLBINDATTRIBLOCATIONPROC) \
+    X(glBindBuffer, PFNGLBINDBUFFERPROC) \
+    X(glBindBufferBase, PFNGLBINDBUFFERBASEPROC) \
+    X(glBindBufferRange, PFNGLBINDBUFFERRANGEPROC) \
+    X(glBindFragDataLocation, PFNGLBINDFRAGDATALOCATIONPROC) \
+    X(glBindFragDataLocationIndexed, PFNGLBINDFRAGDATALOCATIONINDEXEDPROC) \
+    X(glBindFramebuffer, PFNGLBINDFRAMEBUFFERPROC) \
+    X(glBindRenderbuffer, PFNGLBINDRENDERBUFFERPROC) \
+    X(glBindSampler, PFNGLBINDSAMPLERPROC) \
+    X(glBindTexture, PFNGLBINDTEXTUREPROC) \
+    X(glBindVertexArray, PFNGLBINDVERTEXARRAYPROC) \
+    X(glBlendColor, PFNGLBLENDCOLORPROC) \
+    X(glBlendEquation, PFNGLBLENDEQUATIONPROC) \
+    X(glBlendEquationSeparate, PFNGLBLENDEQUATIONSEPARATEPROC) \
+    X(glBlendFunc, PFNGLBLENDFUNCPROC) \
+    X(glBlendFuncSeparate, PFNGLBLENDFUNCSEPARATEPROC) \
+    X(glBlitFramebuffer, PFNGLBLITFRAMEBUFFERPROC) \
+    X(glBufferData, PFNGLBUFFERDATAPROC) \
+    X(glBufferSubData, PFNGLBUFFERSUBDATAPROC) \
+    X(glCheckFramebufferStatus, PFNGLCHECKFRAMEBUFFERSTATUSPROC) \
+    X(glClampColor, PFNGLCLAMPCOLORPROC) \
+    X(glClear, PFNGLCLEARPROC) \
+    X(glClearBufferfi, PFNGLCLEARBUFFERFIPROC) \
+    X(glClearBufferfv, PFNGLCLEARBUFFERFVPROC) \
+    X(glClearBufferiv, PFNGLCLEARBUFFERIVPROC) \
+    X(glClearBufferuiv, PFNGLCLEARBUFFERUIVPROC) \
+    X(glClearColor, PFNGLCLEARCOLORPROC) \
+    X(glClearDepth, PFNGLCLEARDEPTHPROC) \
+    X(glClearStencil, PFNGLCLEARSTENCILPROC) \
+    X(glClientWaitSync, PFNGLCLIENTWAITSYNCPROC) \
+    X(glColorMask, PFNGLCOLORMASKPROC) \
+    X(glColorMaski, PFNGLCOLORMASKIPROC) \
+    X(glColorP3ui, PFNGLCOLORP3UIPROC) \
+    X(glColorP3uiv, PFNGLCOLORP3UIVPROC) \
+    X(glColorP4ui, PFNGLCOLORP4UIPROC) \
+    X(glColorP4uiv, PFNGLCOLORP4UIVPROC) \
+    X(glCompileShader, PFNGLCOMPILESHADERPROC) \
+    X(glCompressedTexImage1D, PFNGLCOMPRESSEDTEXIMAGE1DPROC) \
+    X(glCompressedTexImage2D, PFNGLCOMPRESSEDTEXIMAGE2DPROC) \
+    X(glCompressedTexImage3D, PFNGLCOMPRESSEDTEXIMAGE3DPROC) \
+    X(glCompressedTexSubImage1D, PFNGLCOMPRESSEDTEXSUBIMAGE1DPROC) \
+    X(glCompressedTexSubImage2D, PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC) \
+    X(glCompressedTexSubImage3D, PFNGLCOMPRESSEDTEXSUBIMAGE3DPROC) \
+    X(glCopyBufferSubData, PFNGLCOPYBUFFERSUBDATAPROC) \
+    X(glCopyTexImage1D, PFNGLCOPYTEXIMAGE1DPROC) \
+    X(glCopyTexImage2D, PFNGLCOPYTEXIMAGE2DPROC) \
+    X(glCopyTexSubImage1D, PFNGLCOPYTEXSUBIMAGE1DPROC) \
+    X(glCopyTexSubImage2D, PFNGLCOPYTEXSUBIMAGE2DPROC) \
+    X(glCopyTexSubImage3D, PFNGLCOPYTEXSUBIMAGE3DPROC) \
+    X(glCreateProgram, PFNGLCREATEPROGRAMPROC) \
+    X(glCreateShader, PFNGLCREATESHADERPROC) \
+    X(glCullFace, PFNGLCULLFACEPROC) \
+    X(glDeleteBuffers, PFNGLDELETEBUFFERSPROC) \
+    X(glDeleteFramebuffers, PFNGLDELETEFRAMEBUFFERSPROC) \
+    X(glDeleteProgram, PFNGLDELETEPROGRAMPROC) \
+    X(glDeleteQueries, PFNGLDELETEQUERIESPROC) \
+    X(glDeleteRenderbuffers, PFNGLDELETERENDERBUFFERSPROC) \
+    X(glDeleteSamplers, PFNGLDELETESAMPLERSPROC) \
+    X(glDeleteShader, PFNGLDELETESHADERPROC) \
+    X(glDeleteSync, PFNGLDELETESYNCPROC) \
+    X(glDeleteTextures, PFNGLDELETETEXTURESPROC) \
+    X(glDeleteVertexArrays, PFNGLDELETEVERTEXARRAYSPROC) \
+    X(glDepthFunc, PFNGLDEPTHFUNCPROC) \
+    X(glDepthMask, PFNGLDEPTHMASKPROC) \
+    X(glDepthRange, PFNGLDEPTHRANGEPROC) \
+    X(glDetachShader, PFNGLDETACHSHADERPROC) \
+    X(glDisable, PFNGLDISABLEPROC) \
+    X(glDisableVertexAttribArray, PFNGLDISABLEVERTEXATTRIBARRAYPROC) \
+    X(glDisablei, PFNGLDISABLEIPROC) \
+    X(glDrawArrays, PFNGLDRAWARRAYSPROC) \
+    X(glDrawArraysInstanced, PFNGLDRAWARRAYSINSTANCEDPROC) \
+    X(glDrawBuffer, PFNGLDRAWBUFFERPROC) \
+    X(glDrawBuffers, PFNGLDRAWBUFFERSPROC) \
+    X(glDrawElements, PFNGLDRAWELEMENTSPROC) \
+    X(glDrawElementsBaseVertex, PFNGLDRAWELEMENTSBASEVERTEXPROC) \
+    X(glDrawElementsInstanced, PFNGLDRAWELEMENTSINSTANCEDPROC) \
+    X(glDrawElementsInstancedBaseVertex, PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC) \
+    X(glDrawRangeElements, PFNGLDRAWRANGEELEMENTSPROC) \
+    X(glDrawRangeElementsBaseVertex, PFNGLDRAWRANGEELEMENTSBASEVERTEXPROC) \
+    X(glEnable, PFNGLENABLEPROC) \
+    X(glEnableVertexAttribArray, PFNGLENABLEVERTEXATTRIBARRAYPROC) \
+    X(glEnablei, PFNGLENABLEIPROC) \
+    X(glEndConditionalRender, PFNGLENDCONDITIONALRENDERPROC) \
+    X(glEndQuery, PFNGLENDQUERYPROC) \
+    X(glEndTransformFeedback, PFNGLENDTRANSFORMFEEDBACKPROC) \
+    X(glFenceSync, PFNGLFENCESYNCPROC) \
+    X(glFinish, PFNGLFINISHPROC) \
+    X(glFlush, PFNGLFLUSHPROC) \
+    X(glFlushMappedBufferRange, PFNGLFLUSHMAPPEDBUFFERRANGEPROC) \
+    X(glFramebufferRenderbuffer, PFNGLFRAMEBUFFERRENDERBUFFERPROC) \
+    X(glFramebufferTexture, PFNGLFRAMEBUFFERTEXTUREPROC) \
+    X(glFramebufferTexture1D, PFNGLFRAMEBUFFERTEXTURE1DPROC) \
+    X(glFramebufferTexture2D, PFNGLFRAMEBUFFERTEXTURE2DPROC) \
+    X(glFramebufferTexture3D, PFNGLFRAMEBUFFERTEXTURE3DPROC) \
+    X(glFramebufferTextureLayer, PFNGLFRAMEBUFFERTEXTURELAYERPROC) \
+    X(glFrontFace, PFNGLFRONTFACEPROC) \
+    X(glGenBuffers, PFNGLGENBUFFERSPROC) \
+    X(glGenFramebuffers, PFNGLGENFRAMEBUFFERSPROC) \
+    X(glGenQueries, PFNGLGENQUERIESPROC) \
+    X(glGenRenderbuffers, PFNGLGENRENDERBUFFERSPROC) \
+    X(glGenSamplers, PFNGLGENSAMPLERSPROC) \
+    X(glGenTextures, PFNGLGENTEXTURESPROC) \
+    X(glGenVertexArrays, PFNGLGENVERTEXARRAYSPROC) \
+    X(glGenerateMipmap, PFNGLGENERATEMIPMAPPROC) \
+    X(glGetActiveAttrib, PFNGLGETACTIVEATTRIBPROC) \
+    X(glGetActiveUniform, PFNGLGETACTIVEUNIFORMPROC) \
+    X(glGetActiveUniformBlockName, PFNGLGETACTIVEUNIFORMBLOCKNAMEPROC) \
+    X(glGetActiveUniformBlockiv, PFNGLGETACTIVEUNIFORMBLOCKIVPROC) \
+    X(glGetActiveUniformName, PFNGLGETACTIVEUNIFORMNAMEPROC) \
+    X(glGetActiveUniformsiv, PFNGLGETACTIVEUNIFORMSIVPROC) \
+    X(glGetAttachedShaders, PFNGLGETATTACHEDSHADERSPROC) \
+    X(glGetAttribLocation, PFNGLGETATTRIBLOCATIONPROC) \
+    X(glGetBooleani_v, PFNGLGETBOOLEANI_VPROC) \
+    X(glGetBooleanv, PFNGLGETBOOLEANVPROC) \
+    X(glGetBufferParameteri64v, PFNGLGETBUFFERPARAMETERI64VPROC) \
+    X(glGetBufferParameteriv, PFNGLGETBUFFERPARAMETERIVPROC) \
+    X(glGetBufferPointerv, PFNGLGETBUFFERPOINTERVPROC) \
+    X(glGetBufferSubData, PFNGLGETBUFFERSUBDATAPROC) \
+    X(glGetCompressedTexImage, PFNGLGETCOMPRESSEDTEXIMAGEPROC) \
+    X(glGetDoublev, PFNGLGETDOUBLEVPROC) \
+    X(glGetError, PFNGLGETERRORPROC) \
+    X(glGetFloatv, PFNGLGETFLOATVPROC) \
+    X(glGetFragDataIndex, PFNGLGETFRAGDATAINDEXPROC) \
+    X(glGetFragDataLocation, PFNGLGETFRAGDATALOCATIONPROC) \
+    X(glGetFramebufferAttachmentParameteriv, PFNGLGETFRAMEBUFFERATTACHMENTPARAMETERIVPROC) \
+    X(glGetInteger64i_v, PFNGLGETINTEGER64I_VPROC) \
+    X(glGetInteger64v, PFNGLGETINTEGER64VPROC) \
+    X(glGetIntegeri_v, PFNGLGETINTEGERI_VPROC) \
+    X(glGetIntegerv, PFNGLGETINTEGERVPROC) \
+    X(glGetMultisamplefv, PFNGLGETMULTISAMPLEFVPROC) \
+    X(glGetProgramInfoLog, PFNGLGETPROGRAMINFOLOGPROC) \
+    X(glGetProgramiv, PFNGLGETPROGRAMIVPROC) \
+    X(glGetQueryObjecti64v, PFNGLGETQUERYOBJECTI64VPROC) \
+    X(glGetQueryObjectiv, PFNGLGETQUERYOBJECTIVPROC) \
+    X(glGetQueryObjectui64v, PFNGLGETQUERYOBJECTUI64VPROC) \
+    X(glGetQueryObjectuiv, PFNGLGETQUERYOBJECTUIVPROC) \
+    X(glGetQueryiv, PFNGLGETQUERYIVPROC) \
+    X(glGetRenderbufferParameteriv, PFNGLGETRENDERBUFFERPARAMETERIVPROC) \
+    X(glGetSamplerParameterIiv, PFNGLGETSAMPLERPARAMETERIIVPROC) \
+    X(glGetSamplerParameterIuiv, PFNGLGETSAMPLERPARAMETERIUIVPROC) \
+    X(glGetSamplerParameterfv, PFNGLGETSAMPLERPARAMETERFVPROC) \
+    X(glGetSamplerParameteriv, PFNGLGETSAMPLERPARAMETERIVPROC) \
+    X(glGetShaderInfoLog, PFNGLGETSHADERINFOLOGPROC) \
+    X(glGetShaderSource, PFNGLGETSHADERSOURCEPROC) \
+    X(glGetShaderiv, PFNGLGETSHADERIVPROC) \
+    X(glGetString, PFNGLGETSTRINGPROC) \
+    X(glGetStringi, PFNGLGETSTRINGIPROC) \
+    X(glGetSynciv, PFNGLGETSYNCIVPROC) \
+    X(glGetTexImage, PFNGLGETTEXIMAGEPROC) \
+    X(glGetTexLevelParameterfv, PFNGLGETTEXLEVELPARAMETERFVPROC) \
+    X(glGetTexLevelParameteriv, PFNGLGETTEXLEVELPARAMETERIVPROC) \
+    X(glGetTexParameterIiv, PFNGLGETTEXPARAMETERIIVPROC) \
+    X(glGetTexParameterIuiv, PFNGLGETTEXPARAMETERIUIVPROC) \
+    X(glGetTexParameterfv, PFNGLGETTEXPARAMETERFVPROC) \
+    X(glGetTexParameteriv, PFNGLGETTEXPARAMETERIVPROC) \
+    X(glGetTransformFeedbackVarying, PFNGLGETTRANSFORMFEEDBACKVARYINGPROC) \
+    X(glGetUniformBlockIndex, PFNGLGETUNIFORMBLOCKINDEXPROC) \
+    X(glGetUniformIndices, PFNGLGETUNIFORMINDICESPROC) \
+    X(glGetUniformLocation, PFNGLGETUNIFORMLOCATIONPROC) \
+    X(glGetUniformfv, PFNGLGETUNIFORMFVPROC) \
+    X(glGetUniformiv, PFNGLGETUNIFORMIVPROC) \
+    X(glGetUniformuiv, PFNGLGETUNIFORMUIVPROC) \
+    X(glGetVertexAttribIiv, PFNGLGETVERTEXATTRIBIIVPROC) \
+    X(glGetVertexAttribIuiv, PFNGLGETVERTEXATTRIBIUIVPROC) \
+    X(glGetVertexAttribPointerv, PFNGLGETVERTEXATTRIBPOINTERVPROC) \
+    X(glGetVertexAttribdv, PFNGLGETVERTEXATTRIBDVPROC) \
+    X(glGetVertexAttribfv, PFNGLGETVERTEXATTRIBFVPROC) \
+    X(glGetVertexAttribiv, PFNGLGETVERTEXATTRIBIVPROC) \
+    X(glHint, PFNGLHINTPROC) \
+    X(glIsBuffer, PFNGLISBUFFERPROC) \
+    X(glIsEnabled, PFNGLISENABLEDPROC) \
+    X(glIsEnabledi, PFNGLISENABLEDIPROC) \
+    X(glIsFramebuffer, PFNGLISFRAMEBUFFERPROC) \
+    X(glIsProgram, PFNGLISPROGRAMPROC) \
+    X(glIsQuery, PFNGLISQUERYPROC) \
+    X(glIsRenderbuffer, PFNGLISRENDERBUFFERPROC) \
+    X(glIsSampler, PFNGLISSAMPLERPROC) \
+    X(glIsShader, PFNGLISSHADERPROC) \
+    X(glIsSync, PFNGLISSYNCPROC) \
+    X(glIsTexture, PFNGLISTEXTUREPROC) \
+    X(glIsVertexArray, PFNGLISVERTEXARRAYPROC) \
+    X(glLineWidth, PFNGLLINEWIDTHPROC) \
+    X(glLinkProgram, PFNGLLINKPROGRAMPROC) \
+    X(glLogicOp, PFNGLLOGICOPPROC) \
+    X(glMapBuffer, PFNGLMAPBUFFERPROC) \
+    X(glMapBufferRange, PFNGLMAPBUFFERRANGEPROC) \
+    X(glMultiDrawArrays, PFNGLMULTIDRAWARRAYSPROC) \
+    X(glMultiDrawElements, PFNGLMULTIDRAWELEMENTSPROC) \
+    X(glMultiDrawElementsBaseVertex, PFNGLMULTIDRAWELEMENTSBASEVERTEXPROC) \
+    X(glMultiTexCoordP1ui, PFNGLMULTITEXCOORDP1UIPROC) \
+    X(glMultiTexCoordP1uiv, PFNGLMULTITEXCOORDP1UIVPROC) \
+    X(glMultiTexCoordP2ui, PFNGLMULTITEXCOORDP2UIPROC) \
+    X(glMultiTexCoordP2uiv, PFNGLMULTITEXCOORDP2UIVPROC) \
+    X(glMultiTexCoordP3ui, PFNGLMULTITEXCOORDP3UIPROC) \
+    X(glMultiTexCoordP3uiv, PFNGLMULTITEXCOORDP3UIVPROC) \
+    X(glMultiTexCoordP4ui, PFNGLMULTITEXCOORDP4UIPROC) \
+    X(glMultiTexCoordP4uiv, PFNGLMULTITEXCOORDP4UIVPROC) \
+    X(glNormalP3ui, PFNGLNORMALP3UIPROC) \
+    X(glNormalP3uiv, PFNGLNORMALP3UIVPROC) \
+    X(glPixelStoref, PFNGLPIXELSTOREFPROC) \
+    X(glPixelStorei, PFNGLPIXELSTOREIPROC) \
+    X(glPointParameterf, PFNGLPOINTPARAMETERFPROC) \
+    X(glPointParameterfv, PFNGLPOINTPARAMETERFVPROC) \
+    X(glPointParameteri, PFNGLPOINTPARAMETERIPROC) \
+    X(glPointParameteriv, PFNGLPOINTPARAMETERIVPROC) \
+    X(glPointSize, PFNGLPOINTSIZEPROC) \
+    X(glPolygonMode, PFNGLPOLYGONMODEPROC) \
+    X(glPolygonOffset, PFNGLPOLYGONOFFSETPROC) \
+    X(glPrimitiveRestartIndex, PFNGLPRIMITIVERESTARTINDEXPROC) \
+    X(glProvokingVertex, PFNGLPROVOKINGVERTEXPROC) \
+    X(glQueryCounter, PFNGLQUERYCOUNTERPROC) \
+    X(glReadBuffer, PFNGLREADBUFFERPROC) \
+    X(glReadPixels, PFNGLREADPIXELSPROC) \
+    X(glRenderbufferStorage, PFNGLRENDERBUFFERSTORAGEPROC) \
+    X(glRenderbufferStorageMultisample, PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC) \
+    X(glSampleCoverage, PFNGLSAMPLECOVERAGEPROC) \
+    X(glSampleMaski, PFNGLSAMPLEMASKIPROC) \
+    X(glSamplerParameterIiv, PFNGLSAMPLERPARAMETERIIVPROC) \
+    X(glSamplerParameterIuiv, PFNGLSAMPLERPARAMETERIUIVPROC) \
+    X(glSamplerParameterf, PFNGLSAMPLERPARAMETERFPROC) \
+    X(glSamplerParameterfv, PFNGLSAMPLERPARAMETERFVPROC) \
+    X(glSamplerParameteri, PFNGLSAMPLERPARAMETERIPROC) \
+    X(glSamplerParameteriv, PFNGLSAMPLERPARAMETERIVPROC) \
+    X(glScissor, PFNGLSCISSORPROC) \
+    X(glSecondaryColorP3ui, PFNGLSECONDARYCOLORP3UIPROC) \
+    X(glSecondaryColorP3uiv, PFNGLSECONDARYCOLORP3UIVPROC) \
+    X(glShaderSource, PFNGLSHADERSOURCEPROC) \
+    X(glStencilFunc, PFNGLSTENCILFUNCPROC) \
+    X(glStencilFuncSeparate, PFNGLSTENCILFUNCSEPARATEPROC) \
+    X(glStencilMask, PFNGLSTENCILMASKPROC) \
+    X(glStencilMaskSeparate, PFNGLSTENCILMASKSEPARATEPROC) \
+    X(glStencilOp, PFNGLSTENCILOPPROC) \
+    X(glStencilOpSeparate, PFNGLSTENCILOPSEPARATEPROC) \
+    X(glTexBuffer, PFNGLTEXBUFFERPROC) \
+    X(glTexCoordP1ui, PFNGLTEXCOORDP1UIPROC) \
+    X(glTexCoordP1uiv, PFNGLTEXCOORDP1UIVPROC) \
+    X(glTexCoordP2ui, PFNGLTEXCOORDP2UIPROC) \
+    X(glTexCoordP2uiv, PFNGLTEXCOORDP2UIVPROC) \
+    X(glTexCoordP3ui, PFNGLTEXCOORDP3UIPROC) \
+    X(glTexCoordP3uiv, PFNGLTEXCOORDP3UIVPROC) \
+    X(glTexCoordP4ui, PFNGLTEXCOORDP4UIPROC) \
+    X(glTexCoordP4uiv, PFNGLTEXCOORDP4UIVPROC) \
+    X(glTexImage1D, PFNGLTEXIMAGE1DPROC) \
+    X(glTexImage2D, PFNGLTEXIMAGE2DPROC) \
+    X(glTexImage2DMultisample, PFNGLTEXIMAGE2DMULTISAMPLEPROC) \
+    X(glTexImage3D, PFNGLTEXIMAGE3DPROC) \
+    X(glTexImage3DMultisample, PFNGLTEXIMAGE3DMULTISAMPLEPROC) \
+    X(glTexParameterIiv, PFNGLTEXPARAMETERIIVPROC) \
+    X(glTexParameterIuiv, PFNGLTEXPARAMETERIUIVPROC) \
+    X(glTexParameterf, PFNGLTEXPARAMETERFPROC) \
+    X(glTexParameterfv, PFNGLTEXPARAMETERFVPROC) \
+    X(glTexParameteri, PFNGLTEXPARAMETERIPROC) \
+    X(glTexParameteriv, PFNGLTEXPARAMETERIVPROC) \
+    X(glTexSubImage1D, PFNGLTEXSUBIMAGE1DPROC) \
+    X(glTexSubImage2D, PFNGLTEXSUBIMAGE2DPROC) \
+    X(glTexSubImage3D, PFNGLTEXSUBIMAGE3DPROC) \
+    X(glTransformFeedbackVaryings, PFNGLTRANSFORMFEEDBACKVARYINGSPROC) \
+    X(glUniform1f, PFNGLUNIFORM1FPROC) \
+    X(glUniform1fv, PFNGLUNIFORM1FVPROC) \
+    X(glUniform1i, PFNGLUNIFORM1IPROC) \
+    X(glUniform1iv, PFNGLUNIFORM1IVPROC) \
+    X(glUniform1ui, PFNGLUNIFORM1UIPROC) \
+    X(glUniform1uiv, PFNGLUNIFORM1UIVPROC) \
+    X(glUniform2f, PFNGLUNIFORM2FPROC) \
+    X(glUniform2fv, PFNGLUNIFORM2FVPROC) \
+    X(glUniform2i, PFNGLUNIFORM2IPROC) \
+    X(glUniform2iv, PFNGLUNIFORM2IVPROC) \
+    X(glUniform2ui, PFNGLUNIFORM2UIPROC) \
+    X(glUniform2uiv, PFNGLUNIFORM2UIVPROC) \
+    X(glUniform3f, PFNGLUNIFORM3FPROC) \
+    X(glUniform3fv, PFNGLUNIFORM3FVPROC) \
+    X(glUniform3i, PFNGLUNIFORM3IPROC) \
+    X(glUniform3iv, PFNGLUNIFORM3IVPROC) \
+    X(glUniform3ui, PFNGLUNIFORM3UIPROC) \
+    X(glUniform3uiv, PFNGLUNIFORM3UIVPROC) \
+    X(glUniform4f, PFNGLUNIFORM4FPROC) \
+    X(glUniform4fv, PFNGLUNIFORM4FVPROC) \
+    X(glUniform4i, PFNGLUNIFORM4IPROC) \
+    X(glUniform4iv, PFNGLUNIFORM4IVPROC) \
+    X(glUniform4ui, PFNGLUNIFORM4UIPROC) \
+    X(glUniform4uiv, PFNGLUNIFORM4UIVPROC) \
+    X(glUniformBlockBinding, PFNGLUNIFORMBLOCKBINDINGPROC) \
+    X(glUniformMatrix2fv, PFNGLUNIFORMMATRIX2FVPROC) \
+    X(glUniformMatrix2x3fv, PFNGLUNIFORMMATRIX2X3FVPROC) \
+    X(glUniformMatrix2x4fv, PFNGLUNIFORMMATRIX2X4FVPROC) \
+    X(glUniformMatrix3fv, PFNGLUNIFORMMATRIX3FVPROC) \
+    X(glUniformMatrix3x2fv, PFNGLUNIFORMMATRIX3X2FVPROC) \
+    X(glUniformMatrix3x4fv, PFNGLUNIFORMMATRIX3X4FVPROC) \
+    X(glUniformMatrix4fv, PFNGLUNIFORMMATRIX4FVPROC) \
+    X(glUniformMatrix4x2fv, PFNGLUNIFORMMATRIX4X2FVPROC) \
+    X(glUniformMatrix4x3fv, PFNGLUNIFORMMATRIX4X3FVPROC) \
+    X(glUnmapBuffer, PFNGLUNMAPBUFFERPROC) \
+    X(glUseProgram, PFNGLUSEPROGRAMPROC) \
+    X(glValidateProgram, PFNGLVALIDATEPROGRAMPROC) \
+    X(glVertexAttrib1d, PFNGLVERTEXATTRIB1DPROC) \
+    X(glVertexAttrib1dv, PFNGLVERTEXATTRIB1DVPROC) \
+    X(glVertexAttrib1f, PFNGLVERTEXATTRIB1FPROC) \
+    X(glVertexAttrib1fv, PFNGLVERTEXATTRIB1FVPROC) \
+    X(glVertexAttrib1s, PFNGLVERTEXATTRIB1SPROC) \
+    X(glVertexAttrib1sv, PFNGLVERTEXATTRIB1SVPROC) \
+    X(glVertexAttrib2d, PFNGLVERTEXATTRIB2DPROC) \
+    X(glVertexAttrib2dv, PFNGLVERTEXATTRIB2DVPROC) \
+    X(glVertexAttrib2f, PFNGLVERTEXATTRIB2FPROC) \
+    X(glVertexAttrib2fv, PFNGLVERTEXATTRIB2FVPROC) \
+    X(glVertexAttrib2s, PFNGLVERTEXATTRIB2SPROC) \
+    X(glVertexAttrib2sv, PFNGLVERTEXATTRIB2SVPROC) \
+    X(glVertexAttrib3d, PFNGLVERTEXATTRIB3DPROC) \
+    X(glVertexAttrib3dv, PFNGLVERTEXATTRIB3DVPROC) \
+    X(glVertexAttrib3f, PFNGLVERTEXATTRIB3FPROC) \
+    X(glVertexAttrib3fv, PFNGLVERTEXATTRIB3FVPROC) \
+    X(glVertexAttrib3s, PFNGLVERTEXATTRIB3SPROC) \
+    X(glVertexAttrib3sv, PFNGLVERTEXATTRIB3SVPROC) \
+    X(glVertexAttrib4Nbv, PFNGLVERTEXATTRIB4NBVPROC) \
+    X(glVertexAttrib4Niv, PFNGLVERTEXATTRIB4NIVPROC) \
+    X(glVertexAttrib4Nsv, PFNGLVERTEXATTRIB4NSVPROC) \
+    X(glVertexAttrib4Nub, PFNGLVERTEXATTRIB4NUBPROC) \
+    X(glVertexAttrib4Nubv, PFNGLVERTEXATTRIB4NUBVPROC) \
+    X(glVertexAttrib4Nuiv, PFNGLVERTEXATTRIB4NUIVPROC) \
+    X(glVertexAttrib4Nusv, PFNGLVERTEXATTRIB4NUSVPROC) \
+    X(glVertexAttrib4bv, PFNGLVERTEXATTRIB4BVPROC) \
+    X(glVertexAttrib4d, PFNGLVERTEXATTRIB4DPROC) \
+    X(glVertexAttrib4dv, PFNGLVERTEXATTRIB4DVPROC) \
+    X(glVertexAttrib4f, PFNGLVERTEXATTRIB4FPROC) \
+    X(glVertexAttrib4fv, PFNGLVERTEXATTRIB4FVPROC) \
+    X(glVertexAttrib4iv, PFNGLVERTEXATTRIB4IVPROC) \
+    X(glVertexAttrib4s, PFNGLVERTEXATTRIB4SPROC) \
+    X(glVertexAttrib4sv, PFNGLVERTEXATTRIB4SVPROC) \
+    X(glVertexAttrib4ubv, PFNGLVERTEXATTRIB4UBVPROC) \
+    X(glVertexAttrib4uiv, PFNGLVERTEXATTRIB4UIVPROC) \
+    X(glVertexAttrib4usv, PFNGLVERTEXATTRIB4USVPROC) \
+    X(glVertexAttribDivisor, PFNGLVERTEXATTRIBDIVISORPROC) \
+    X(glVertexAttribI1i, PFNGLVERTEXATTRIBI1IPROC) \
+    X(glVertexAttribI1iv, PFNGLVERTEXATTRIBI1IVPROC) \
+    X(glVertexAttribI1ui, PFNGLVERTEXATTRIBI1UIPROC) \
+    X(glVertexAttribI1uiv, PFNGLVERTEXATTRIBI1UIVPROC) \
+    X(glVertexAttribI2i, PFNGLVERTEXATTRIBI2IPROC) \
+    X(glVertexAttribI2iv, PFNGLVERTEXATTRIBI2IVPROC) \
+    X(glVertexAttribI2ui, PFNGLVERTEXATTRIBI2UIPROC) \
+    X(glVertexAttribI2uiv, PFNGLVERTEXATTRIBI2UIVPROC) \
+    X(glVertexAttribI3i, PFNGLVERTEXATTRIBI3IPROC) \
+    X(glVertexAttribI3iv, PFNGLVERTEXATTRIBI3IVPROC) \
+    X(glVertexAttribI3ui, PFNGLVERTEXATTRIBI3UIPROC) \
+    X(glVertexAttribI3uiv, PFNGLVERTEXATTRIBI3UIVPROC) \
+    X(glVertexAttribI4bv, PFNGLVERTEXATTRIBI4BVPROC) \
+    X(glVertexAttribI4i, PFNGLVERTEXATTRIBI4IPROC) \
+    X(glVertexAttribI4iv, PFNGLVERTEXATTRIBI4IVPROC) \
+    X(glVertexAttribI4sv, PFNGLVERTEXATTRIBI4SVPROC) \
+    X(glVertexAttribI4ubv, PFNGLVERTEXATTRIBI4UBVPROC) \
+    X(glVertexAttribI4ui, PFNGLVERTEXATTRIBI4UIPROC) \
+    X(glVertexAttribI4uiv, PFNGLVERTEXATTRIBI4UIVPROC) \
+    X(glVertexAttribI4usv, PFNGLVERTEXATTRIBI4USVPROC) \
+    X(glVertexAttribIPointer, PFNGLVERTEXATTRIBIPOINTERPROC) \
+    X(glVertexAttribP1ui, PFNGLVERTEXATTRIBP1UIPROC) \
+    X(glVertexAttribP1uiv, PFNGLVERTEXATTRIBP1UIVPROC) \
+    X(glVertexAttribP2ui, PFNGLVERTEXATTRIBP2UIPROC) \
+    X(glVertexAttribP2uiv, PFNGLVERTEXATTRIBP2UIVPROC) \
+    X(glVertexAttribP3ui, PFNGLVERTEXATTRIBP3UIPROC) \
+    X(glVertexAttribP3uiv, PFNGLVERTEXATTRIBP3UIVPROC) \
+    X(glVertexAttribP4ui, PFNGLVERTEXATTRIBP4UIPROC) \
+    X(glVertexAttribP4uiv, PFNGLVERTEXATTRIBP4UIVPROC) \
+    X(glVertexAttribPointer, PFNGLVERTEXATTRIBPOINTERPROC) \
+    X(glVertexP2ui, PFNGLVERTEXP2UIPROC) \
+    X(glVertexP2uiv, PFNGLVERTEXP2UIVPROC) \
+    X(glVertexP3ui, PFNGLVERTEXP3UIPROC) \
+    X(glVertexP3uiv, PFNGLVERTEXP3UIVPROC) \
+    X(glVertexP4ui, PFNGLVERTEXP4UIPROC) \
+    X(glVertexP4uiv, PFNGLVERTEXP4UIVPROC) \
+    X(glViewport, PFNGLVIEWPORTPROC) \
+    X(glWaitSync, PFNGLWAITSYNCPROC)
+
+enum NullGLEntry {
+#define X(name, type) NULL_GL_##name,
+    NULL_GL_ENTRY_POINTS(X)
+#undef X
+    NULL_GL_ENTRY_COUNT
+};
+
+static const char *nullGLNames[] = {
+#define X(name, type) #name,
+    NULL_GL_ENTRY_POINTS(X)
+#undef X
+};
+
+// Driver state
+// ---------------------------
+struct NullGLUniform {
+    std::string name;
+    GLint size;
+};
+
+struct NullGLProgram {
+    std::vector<GLuint> shaders;
+    std::vector<NullGLUniform> uniforms;
+    std::string source; // every attached shader, for uniform block lookups
+};
+
+struct NullGL {
+    uint64_t calls[NULL_GL_ENTRY_COUNT];
+    GLuint nextName;
+    std::unordered_map<GLuint, std::string> shaderSources;
+    std::unordered_map<GLuint, NullGLProgram> programs;
+    std::unordered_map<GLuint, std::vector<uint8_t>> buffers;
+    std::unordered_map<GLenum, GLuint> boundBuffers;
+};
+
+static NullGL nullGL;
+
+#define NULL_GL_COUNT(name) nullGL.calls[NULL_GL_##name]++
+
+// Accepts any call and returns zero. Instantiated per entry point so each
+// one gets its own counter.
+template <typename T, int Id>
+struct NullGLStub;
+
+template <typename R, typename... Args, int Id>
+struct NullGLStub<R (APIENTRYP)(Args...), Id> {
+    static R APIENTRY Call(Args...) {
+        nullGL.calls[Id]++;
+        if constexpr (!std::is_void_v<R>) {
+            return R{};
+        }
+    }
+};
+
+// GLSL reflection
+// Just enough of a parser for the shaders in this repo: struct definitions,
+// plain and struct typed uniforms, arrays, and uniform blocks (skipped, their
+// members have no location).
+// ---------------------------
+struct NullGLMember {
+    std::string type;
+    std::string name;
+    GLint count;
+};
+
+static std::vector<std::string> NullGLTokenize(const std::string &source) {
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < source.size()) {
+        char c = source[i];
+        if (c == '/' && i + 1 < source.size() && source[i + 1] == '/') {
+            while (i < source.size() && source[i] != '\n') i++;
+        } else if (c == '/' && i + 1 < source.size() && source[i + 1] == '*') {
+            size_t end = source.find("*/", i + 2);
+            i = end == std::string::npos ? source.size() : end + 2;
+        } else if (c == '#') {
+            while (i < source.size() && source[i] != '\n') i++;
+        } else if (isspace((unsigned char)c)) {
+            i++;
+        } else if (isalnum((unsigned char)c) || c == '_') {
+            size_t start = i;
+            while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_')) i++;
+            tokens.push_back(source.substr(start, i - start));
+        } else {
+            tokens.push_back(std::string(1, c));
+            i++;
+        }
+    }
+    return tokens;
+}
+
+// Parses "type name [N] ;" starting at tokens[i], advancing i past the ';'
+static bool NullGLParseDeclaration(const std::vector<std::string> &tokens, size_t &i, NullGLMember &m) {
+    if (i + 2 >= tokens.size()) {
+        return false;
+    }
+    m.type = tokens[i++];
+    m.name = tokens[i++];
+    m.count = 0;
+    if (tokens[i] == "[") {
+        m.count = atoi(tokens[i + 1].c_str());
+        i += 3;
+    }
+    while (i < tokens.size() && tokens[i] != ";") i++;
+    i++;
+    return true;
+}
+
+static void NullGLAddUniform(NullGLProgram &p,
+                             const std::unordered_map<std::string, std::vector<NullGLMember>> &structs,
+                             const std::string &type, const std::string &name, GLint count) {
+    auto it = structs.find(type);
+    if (it == structs.end()) {
+        // Arrays of basic types are reported once as "name[0]"
+        p.uniforms.push_back({ count ? name + "[0]" : name, count ? count : 1 });
+        return;
+    }
+    for (GLint e = 0; e < (count ? count : 1); ++e) {
+        std::string base = count ? name + "[" + std::to_string(e) + "]" : name;
+        for (const NullGLMember &m : it->second) {
+            NullGLAddUniform(p, structs, m.type, base + "." + m.name, m.count);
+        }
+    }
+}
+
+static void NullGLReflect(NullGLProgram &p) {
+    std::unordered_map<std::string, std::vector<NullGLMember>> structs;
+    std::vector<std::string> tokens = NullGLTokenize(p.source);
+    size_t i = 0;
+    while (i < tokens.size()) {
+        if (tokens[i] == "struct" && i + 2 < tokens.size() && tokens[i + 2] == "{") {
+            std::string name = tokens[i + 1];
+            i += 3;
+            std::vector<NullGLMember> members;
+            while (i < tokens.size() && tokens[i] != "}") {
+                NullGLMember m;
+                if (!NullGLParseDeclaration(tokens, i, m)) break;
+                members.push_back(m);
+            }
+            structs[name] = members;
+            i++;
+        } else if (tokens[i] == "uniform" && i + 2 < tokens.size()) {
+            i++;
+            if (tokens[i + 1] == "{") {
+                // Uniform block, skip to its closing brace
+                while (i < tokens.size() && tokens[i] != "}") i++;
+                continue;
+            }
+            NullGLMember m;
+            if (!NullGLParseDeclaration(tokens, i, m)) break;
+            bool duplicate = std::any_of(p.uniforms.begin(), p.uniforms.end(), [&](const NullGLUniform &u) {
+                return u.name == m.name || u.name.rfind(m.name + ".", 0) == 0 || u.name == m.name + "[0]";
+            });
+            if (!duplicate) {
+                NullGLAddUniform(p, structs, m.type, m.name, m.count);
+            }
+        } else {
+            i++;
+        }
+    }
+}
+
+// Overrides for entry points whose results the app depends on
+// ---------------------------
+static GLuint NullGLGenName() {
+    return ++nullGL.nextName;
+}
+
+static void NullGLGenNames(GLsizei n, GLuint *names) {
+    for (GLsizei i = 0; i < n; ++i) {
+        names[i] = NullGLGenName();
+    }
+}
+
+static void APIENTRY NullGenBuffers(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenBuffers); NullGLGenNames(n, names); }
+static void APIENTRY NullGenTextures(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenTextures); NullGLGenNames(n, names); }
+static void APIENTRY NullGenVertexArrays(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenVertexArrays); NullGLGenNames(n, names); }
+static void APIENTRY NullGenFramebuffers(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenFramebuffers); NullGLGenNames(n, names); }
+static void APIENTRY NullGenRenderbuffers(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenRenderbuffers); NullGLGenNames(n, names); }
+static void APIENTRY NullGenQueries(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenQueries); NullGLGenNames(n, names); }
+static void APIENTRY NullGenSamplers(GLsizei n, GLuint *names) { NULL_GL_COUNT(glGenSamplers); NullGLGenNames(n, names); }
+
+static GLuint APIENTRY NullCreateShader(GLenum) {
+    NULL_GL_COUNT(glCreateShader);
+    GLuint name = NullGLGenName();
+    nullGL.shaderSources[name] = std::string();
+    return name;
+}
+
+static GLuint APIENTRY NullCreateProgram() {
+    NULL_GL_COUNT(glCreateProgram);
+    GLuint name = NullGLGenName();
+    nullGL.programs[name] = NullGLProgram();
+    return name;
+}
+
+static void APIENTRY NullShaderSource(GLuint shader, GLsizei count, const GLchar *const *strings, const GLint *lengths) {
+    NULL_GL_COUNT(glShaderSource);
+    std::string &source = nullGL.shaderSources[shader];
+    source.clear();
+    for (GLsizei i = 0; i < count; ++i) {
+        if (lengths && lengths[i] >= 0) {
+            source.append(strings[i], lengths[i]);
+        } else {
+            source.append(strings[i]);
+        }
+    }
+}
+
+static void APIENTRY NullAttachShader(GLuint program, GLuint shader) {
+    NULL_GL_COUNT(glAttachShader);
+    nullGL.programs[program].shaders.push_back(shader);
+}
+
+static void APIENTRY NullLinkProgram(GLuint program) {
+    NULL_GL_COUNT(glLinkProgram);
+    NullGLProgram &p = nullGL.programs[program];
+    p.source.clear();
+    p.uniforms.clear();
+    for (GLuint shader : p.shaders) {
+        p.source += nullGL.shaderSources[shader];
+        p.source += '\n';
+    }
+    NullGLReflect(p);
+}
+
+static void APIENTRY NullDeleteProgram(GLuint program) {
+    NULL_GL_COUNT(glDeleteProgram);
+    nullGL.programs.erase(program);
+}
+
+static void APIENTRY NullDeleteShader(GLuint shader) {
+    NULL_GL_COUNT(glDeleteShader);
+    nullGL.shaderSources.erase(shader);
+}
+
+static void APIENTRY NullGetShaderiv(GLuint, GLenum pname, GLint *params) {
+    NULL_GL_COUNT(glGetShaderiv);
+    *params = (pname == GL_COMPILE_STATUS || pname == GL_DELETE_STATUS) ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetProgramiv(GLuint program, GLenum pname, GLint *params) {
+    NULL_GL_COUNT(glGetProgramiv);
+    const NullGLProgram &p = nullGL.programs[program];
+    switch (pname) {
+    case GL_LINK_STATUS:
+    case GL_VALIDATE_STATUS:
+        *params = GL_TRUE;
+        break;
+    case GL_ACTIVE_UNIFORMS:
+        *params = (GLint)p.uniforms.size();
+        break;
+    case GL_ACTIVE_UNIFORM_MAX_LENGTH: {
+        size_t length = 0;
+        for (const NullGLUniform &u : p.uniforms) {
+            length = std::max(length, u.name.size() + 1);
+        }
+        *params = (GLint)length;
+        break;
+    }
+    case GL_ATTACHED_SHADERS:
+        *params = (GLint)p.shaders.size();
+        break;
+    default:
+        *params = 0;
+    }
+}
+
+static void APIENTRY NullGetShaderInfoLog(GLuint, GLsizei bufSize, GLsizei *length, GLchar *infoLog) {
+    NULL_GL_COUNT(glGetShaderInfoLog);
+    if (length) *length = 0;
+    if (bufSize > 0) infoLog[0] = '\0';
+}
+
+static void APIENTRY NullGetProgramInfoLog(GLuint, GLsizei bufSize, GLsizei *length, GLchar *infoLog) {
+    NULL_GL_COUNT(glGetProgramInfoLog);
+    if (length) *length = 0;
+    if (bufSize > 0) infoLog[0] = '\0';
+}
+
+static void APIENTRY NullGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei *length,
+                                          GLint *size, GLenum *type, GLchar *name) {
+    NULL_GL_COUNT(glGetActiveUniform);
+    const NullGLProgram &p = nullGL.programs[program];
+    const NullGLUniform &u = p.uniforms[index];
+    GLsizei copied = bufSize > 0 ? (GLsizei)std::min(u.name.size(), (size_t)bufSize - 1) : 0;
+    if (bufSize > 0) {
+        memcpy(name, u.name.data(), copied);
+        name[copied] = '\0';
+    }
+    if (length) *length = copied;
+    *size = u.size;
+    *type = GL_FLOAT;
+}
+
+// Locations are the uniform's index in the reflected list
+static GLint APIENTRY NullGetUniformLocation(GLuint program, const GLchar *name) {
+    NULL_GL_COUNT(glGetUniformLocation);
+    const NullGLProgram &p = nullGL.programs[program];
+    for (size_t i = 0; i < p.uniforms.size(); ++i) {
+        const std::string &u = p.uniforms[i].name;
+        if (u == name || (u.size() > 3 && u.compare(u.size() - 3, 3, "[0]") == 0 && u.compare(0, u.size() - 3, name) == 0)) {
+            return (GLint)i;
+        }
+    }
+    return -1;
+}
+
+static GLuint APIENTRY NullGetUniformBlockIndex(GLuint program, const GLchar *blockName) {
+    NULL_GL_COUNT(glGetUniformBlockIndex);
+    std::vector<std::string> tokens = NullGLTokenize(nullGL.programs[program].source);
+    for (size_t i = 0; i + 2 < tokens.size(); ++i) {
+        if (tokens[i] == "uniform" && tokens[i + 1] == blockName && tokens[i + 2] == "{") {
+            return 0;
+        }
+    }
+    return GL_INVALID_INDEX;
+}
+
+static void APIENTRY NullGetUniformIndices(GLuint, GLsizei count, const GLchar *const *, GLuint *indices) {
+    NULL_GL_COUNT(glGetUniformIndices);
+    for (GLsizei i = 0; i < count; ++i) {
+        indices[i] = GL_INVALID_INDEX;
+    }
+}
+
+static const GLubyte *APIENTRY NullGetString(GLenum name) {
+    NULL_GL_COUNT(glGetString);
+    switch (name) {
+    case GL_VENDOR: return (const GLubyte *)"LearnOpenGL";
+    case GL_RENDERER: return (const GLubyte *)"Null GL";
+    case GL_VERSION: return (const GLubyte *)"3.3.0 Null GL";
+    case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte *)"3.30";
+    default: return (const GLubyte *)"";
+    }
+}
+
+static const GLubyte *APIENTRY NullGetStringi(GLenum, GLuint) {
+    NULL_GL_COUNT(glGetStringi);
+    return (const GLubyte *)"";
+}
+
+static void APIENTRY NullGetIntegerv(GLenum pname, GLint *data) {
+    NULL_GL_COUNT(glGetIntegerv);
+    switch (pname) {
+    case GL_MAJOR_VERSION: *data = 3; break;
+    case GL_MINOR_VERSION: *data = 3; break;
+    case GL_MAX_TEXTURE_BUFFER_SIZE: *data = 1 << 27; break;
+    case GL_VIEWPORT:
+    case GL_SCISSOR_BOX:
+        data[0] = data[1] = data[2] = data[3] = 0;
+        break;
+    default: *data = 0;
+    }
+}
+
+static void APIENTRY NullGetFloatv(GLenum, GLfloat *data) { NULL_GL_COUNT(glGetFloatv); *data = 0.0f; }
+static void APIENTRY NullGetBooleanv(GLenum, GLboolean *data) { NULL_GL_COUNT(glGetBooleanv); *data = GL_FALSE; }
+
+static void APIENTRY NullGetActiveUniformsiv(GLuint, GLsizei count, const GLuint *, GLenum, GLint *params) {
+    NULL_GL_COUNT(glGetActiveUniformsiv);
+    for (GLsizei i = 0; i < count; ++i) {
+        params[i] = 0;
+    }
+}
+
+// Buffers get real backing memory so mapping works
+static void APIENTRY NullBindBuffer(GLenum target, GLuint buffer) {
+    NULL_GL_COUNT(glBindBuffer);
+    nullGL.boundBuffers[target] = buffer;
+}
+
+static void APIENTRY NullBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum) {
+    NULL_GL_COUNT(glBufferData);
+    std::vector<uint8_t> &storage = nullGL.buffers[nullGL.boundBuffers[target]];
+    storage.resize((size_t)size);
+    if (data) {
+        memcpy(storage.data(), data, (size_t)size);
+    }
+}
+
+static void *APIENTRY NullMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield) {
+    NULL_GL_COUNT(glMapBufferRange);
+    std::vector<uint8_t> &storage = nullGL.buffers[nullGL.boundBuffers[target]];
+    if ((size_t)(offset + length) > storage.size()) {
+        return nullptr;
+    }
+    return storage.data() + offset;
+}
+
+static void *APIENTRY NullMapBuffer(GLenum target, GLenum) {
+    NULL_GL_COUNT(glMapBuffer);
+    std::vector<uint8_t> &storage = nullGL.buffers[nullGL.boundBuffers[target]];
+    return storage.empty() ? nullptr : storage.data();
+}
+
+static GLboolean APIENTRY NullUnmapBuffer(GLenum) {
+    NULL_GL_COUNT(glUnmapBuffer);
+    return GL_TRUE;
+}
+
+static void APIENTRY NullDeleteBuffers(GLsizei n, const GLuint *buffers) {
+    NULL_GL_COUNT(glDeleteBuffers);
+    for (GLsizei i = 0; i < n; ++i) {
+        nullGL.buffers.erase(buffers[i]);
+    }
+}
+
+static GLsync APIENTRY NullFenceSync(GLenum, GLbitfield) {
+    NULL_GL_COUNT(glFenceSync);
+    return (GLsync)(uintptr_t)NullGLGenName();
+}
+
+static GLenum APIENTRY NullClientWaitSync(GLsync, GLbitfield, GLuint64) {
+    NULL_GL_COUNT(glClientWaitSync);
+    return GL_ALREADY_SIGNALED;
+}
+
+static GLenum APIENTRY NullCheckFramebufferStatus(GLenum) {
+    NULL_GL_COUNT(glCheckFramebufferStatus);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void APIENTRY NullGetQueryObjectiv(GLuint, GLenum pname, GLint *params) {
+    NULL_GL_COUNT(glGetQueryObjectiv);
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetQueryObjectuiv(GLuint, GLenum pname, GLuint *params) {
+    NULL_GL_COUNT(glGetQueryObjectuiv);
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetQueryObjecti64v(GLuint, GLenum pname, GLint64 *params) {
+    NULL_GL_COUNT(glGetQueryObjecti64v);
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+static void APIENTRY NullGetQueryObjectui64v(GLuint, GLenum pname, GLuint64 *params) {
+    NULL_GL_COUNT(glGetQueryObjectui64v);
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+int NullGLLoad() {
+    nullGL = NullGL();
+
+#define X(name, type) glad_##name = NullGLStub<type, NULL_GL_##name>::Call;
+    NULL_GL_ENTRY_POINTS(X)
+#undef X
+
+    glad_glGenBuffers = NullGenBuffers;
+    glad_glGenTextures = NullGenTextures;
+    glad_glGenVertexArrays = NullGenVertexArrays;
+    glad_glGenFramebuffers = NullGenFramebuffers;
+    glad_glGenRenderbuffers = NullGenRenderbuffers;
+    glad_glGenQueries = NullGenQueries;
+    glad_glGenSamplers = NullGenSamplers;
+    glad_glCreateShader = NullCreateShader;
+    glad_glCreateProgram = NullCreateProgram;
+    glad_glShaderSource = NullShaderSource;
+    glad_glAttachShader = NullAttachShader;
+    glad_glLinkProgram = NullLinkProgram;
+    glad_glDeleteProgram = NullDeleteProgram;
+    glad_glDeleteShader = NullDeleteShader;
+    glad_glGetShaderiv = NullGetShaderiv;
+    glad_glGetProgramiv = NullGetProgramiv;
+    glad_glGetShaderInfoLog = NullGetShaderInfoLog;
+    glad_glGetProgramInfoLog = NullGetProgramInfoLog;
+    glad_glGetActiveUniform = NullGetActiveUniform;
+    glad_glGetUniformLocation = NullGetUniformLocation;
+    glad_glGetUniformBlockIndex = NullGetUniformBlockIndex;
+    glad_glGetUniformIndices = NullGetUniformIndices;
+    glad_glGetActiveUniformsiv = NullGetActiveUniformsiv;
+    glad_glGetString = NullGetString;
+    glad_glGetStringi = NullGetStringi;
+    glad_glGetIntegerv = NullGetIntegerv;
+    glad_glGetFloatv = NullGetFloatv;
+    glad_glGetBooleanv = NullGetBooleanv;
+    glad_glBindBuffer = NullBindBuffer;
+    glad_glBufferData = NullBufferData;
+    glad_glMapBufferRange = NullMapBufferRange;
+    glad_glMapBuffer = NullMapBuffer;
+    glad_glUnmapBuffer = NullUnmapBuffer;
+    glad_glDeleteBuffers = NullDeleteBuffers;
+    glad_glFenceSync = NullFenceSync;
+    glad_glClientWaitSync = NullClientWaitSync;
+    glad_glCheckFramebufferStatus = NullCheckFramebufferStatus;
+    glad_glGetQueryObjectiv = NullGetQueryObjectiv;
+    glad_glGetQueryObjectuiv = NullGetQueryObjectuiv;
+    glad_glGetQueryObjecti64v = NullGetQueryObjecti64v;
+    glad_glGetQueryObjectui64v = NullGetQueryObjectui64v;
+
+    GLVersion.major = 3;
+    GLVersion.minor = 3;
+    GLAD_GL_VERSION_1_0 = GLAD_GL_VERSION_1_1 = GLAD_GL_VERSION_1_2 = GLAD_GL_VERSION_1_3 = 1;
+    GLAD_GL_VERSION_1_4 = GLAD_GL_VERSION_1_5 = GLAD_GL_VERSION_2_0 = GLAD_GL_VERSION_2_1 = 1;
+    GLAD_GL_VERSION_3_0 = GLAD_GL_VERSION_3_1 = GLAD_GL_VERSION_3_2 = GLAD_GL_VERSION_3_3 = 1;
+    return 1;
+}
+
+void NullGLResetCounters() {
+    memset(nullGL.calls, 0, sizeof(nullGL.calls));
+}
+
+uint64_t NullGLTotalCalls() {
+    uint64_t total = 0;
+    for (uint64_t c : nullGL.calls) {
+        total += c;
+    }
+    return total;
+}
+
+void NullGLReport(uint32_t frames) {
+    std::vector<int> called;
+    for (int i = 0; i < NULL_GL_ENTRY_COUNT; ++i) {
+        if (nullGL.calls[i]) {
+            called.push_back(i);
+        }
+    }
+    std::sort(called.begin(), called.end(), [](int a, int b) { return nullGL.calls[a] > nullGL.calls[b]; });
+
+    double perFrame = frames ? 1.0 / frames : 1.0;
+    std::cout << "GL calls per frame: " << NullGLTotalCalls() * perFrame << std::endl;
+    for (int i : called) {
+        std::cout << "    " << nullGLNames[i] << ": " << nullGL.calls[i] * perFrame << std::endl;
+    }
+}
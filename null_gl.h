@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Null GL driver
+// Points every glad entry point at a stub that accepts the call, hands out
+// plausible object names, reflects uniforms from the GLSL it was given and
+// counts how often each entry point is hit. Lets the whole render loop run
+// without a GPU so its CPU submission cost can be measured deterministically.
+// -------------------------------------
+
+// Replaces the glad function pointers, use instead of gladLoadGLLoader
+int NullGLLoad();
+
+void NullGLResetCounters();
+uint64_t NullGLTotalCalls();
+
+// Prints every entry point that was called, divided by `frames`
+void NullGLReport(uint32_t frames);
@@ -0,0 +1,301 @@
+#include "occlusion.h"
+#include "cpu_features.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+#define OCCLUSION_MIN_W 1.0e-4f // clip w below this counts as behind the camera
+
+// Edge functions e = a * x + b * y + c, positive inside, edge i opposite
+// vertex i, and the depth plane z = za * x + zb * y + zc
+struct OcclusionTriangle {
+    float a[3];
+    float b[3];
+    float c[3];
+    float za, zb, zc;
+    int32_t x0, y0, x1, y1; // inclusive pixel bounds
+};
+
+static bool OcclusionSetupTriangle(OcclusionTriangle &t, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+    // Both windings are rasterized, the cube is closed either way
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+    if (area < 1.0e-6f) {
+        return false;
+    }
+
+    float minX = std::min(v0.x, std::min(v1.x, v2.x));
+    float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+    float minY = std::min(v0.y, std::min(v1.y, v2.y));
+    float maxY = std::max(v0.y, std::max(v1.y, v2.y));
+    t.x0 = (int32_t)std::max(std::floor(minX), 0.0f);
+    t.y0 = (int32_t)std::max(std::floor(minY), 0.0f);
+    t.x1 = (int32_t)std::min(std::ceil(maxX), (float)(OCCLUSION_WIDTH - 1));
+    t.y1 = (int32_t)std::min(std::ceil(maxY), (float)(OCCLUSION_HEIGHT - 1));
+    if (t.x0 > t.x1 || t.y0 > t.y1) {
+        return false;
+    }
+
+    const glm::vec3 v[3] = { v0, v1, v2 };
+    for (int i = 0; i < 3; ++i) {
+        const glm::vec3 &p = v[(i + 1) % 3];
+        const glm::vec3 &q = v[(i + 2) % 3];
+        t.a[i] = p.y - q.y;
+        t.b[i] = q.x - p.x;
+        t.c[i] = (q.y - p.y) * p.x - (q.x - p.x) * p.y;
+    }
+
+    // Barycentric weight i is e[i] / area
+    float invArea = 1.0f / area;
+    t.za = (t.a[0] * v0.z + t.a[1] * v1.z + t.a[2] * v2.z) * invArea;
+    t.zb = (t.b[0] * v0.z + t.b[1] * v1.z + t.b[2] * v2.z) * invArea;
+    t.zc = (t.c[0] * v0.z + t.c[1] * v1.z + t.c[2] * v2.z) * invArea;
+    return true;
+}
+
+// Scalar
+// ---------------------------
+static void OcclusionRasterScalar(float *depth, const OcclusionTriangle &t) {
+    for (int32_t y = t.y0; y <= t.y1; ++y) {
+        float py = (float)y + 0.5f;
+        float row0 = t.b[0] * py + t.c[0];
+        float row1 = t.b[1] * py + t.c[1];
+        float row2 = t.b[2] * py + t.c[2];
+        float rowZ = t.zb * py + t.zc;
+        float *row = depth + (size_t)y * OCCLUSION_WIDTH;
+        for (int32_t x = t.x0; x <= t.x1; ++x) {
+            float px = (float)x + 0.5f;
+            float e0 = t.a[0] * px + row0;
+            float e1 = t.a[1] * px + row1;
+            float e2 = t.a[2] * px + row2;
+            if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                row[x] = std::min(row[x], t.za * px + rowZ);
+            }
+        }
+    }
+}
+
+// AVX, 8 pixels per step. Rows start on a multiple of 8 and the buffer
+// width is one too, so steps never leave the row; lanes outside the
+// bounds are outside the triangle and fail the edge test.
+// ---------------------------
+SIMD_TARGET_AVX
+static void OcclusionRasterAVX(float *depth, const OcclusionTriangle &t) {
+    const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 a0 = _mm256_set1_ps(t.a[0]);
+    const __m256 a1 = _mm256_set1_ps(t.a[1]);
+    const __m256 a2 = _mm256_set1_ps(t.a[2]);
+    const __m256 za = _mm256_set1_ps(t.za);
+    const int32_t xStart = t.x0 & ~7;
+
+    for (int32_t y = t.y0; y <= t.y1; ++y) {
+        float py = (float)y + 0.5f;
+        __m256 row0 = _mm256_set1_ps(t.b[0] * py + t.c[0]);
+        __m256 row1 = _mm256_set1_ps(t.b[1] * py + t.c[1]);
+        __m256 row2 = _mm256_set1_ps(t.b[2] * py + t.c[2]);
+        __m256 rowZ = _mm256_set1_ps(t.zb * py + t.zc);
+        float *row = depth + (size_t)y * OCCLUSION_WIDTH;
+        for (int32_t x = xStart; x <= t.x1; x += 8) {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+            __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), row0);
+            __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), row1);
+            __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), row2);
+            __m256 inside = _mm256_and_ps(_mm256_and_ps(
+                _mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0) {
+                continue;
+            }
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(za, px), rowZ);
+            __m256 old = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+        }
+    }
+    _mm256_zeroupper();
+}
+
+const char *OcclusionPathName(OcclusionPath path) {
+    switch (path) {
+    case OCCLUSION_PATH_SCALAR: return "scalar";
+    case OCCLUSION_PATH_AVX: return "avx";
+    default: return "auto";
+    }
+}
+
+OcclusionPath OcclusionBestPath() {
+    return CpuGetFeatures().avx ? OCCLUSION_PATH_AVX : OCCLUSION_PATH_SCALAR;
+}
+
+void OcclusionClear(OcclusionBuffer &b, const glm::mat4 &viewProjection) {
+    if (b.depth.empty()) {
+        uint32_t width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT, offset = 0;
+        b.levelCount = 0;
+        while (b.levelCount < OCCLUSION_MAX_LEVELS) {
+            b.levelWidth[b.levelCount] = width;
+            b.levelHeight[b.levelCount] = height;
+            b.levelOffset[b.levelCount] = offset;
+            b.levelCount++;
+            offset += width * height;
+            if (width == 1 && height == 1) {
+                break;
+            }
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+        }
+        b.depth.resize(offset);
+    }
+    std::fill(b.depth.begin(), b.depth.begin() + OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+    b.viewProjection = viewProjection;
+    b.occluderTriangles = 0;
+}
+
+void OcclusionRasterizeCube(OcclusionBuffer &b, const glm::mat4 &model, OcclusionPath path) {
+    if (path == OCCLUSION_PATH_AUTO) {
+        path = OcclusionBestPath();
+    }
+    glm::mat4 mvp = b.viewProjection * model;
+
+    // Window coordinates of level 0, depth mapped to 0..1
+    glm::vec3 screen[CUBE_VERTEX_COUNT];
+    for (uint32_t i = 0; i < CUBE_VERTEX_COUNT; ++i) {
+        const float *v = &cubeVertices[i * CUBE_VERTEX_STRIDE];
+        glm::vec4 clip = mvp * glm::vec4(v[0], v[1], v[2], 1.0f);
+        if (clip.w < OCCLUSION_MIN_W) {
+            return;
+        }
+        float invW = 1.0f / clip.w;
+        screen[i].x = (clip.x * invW * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+        screen[i].y = (clip.y * invW * 0.5f + 0.5f) * (float)OCCLUSION_HEIGHT;
+        screen[i].z = clip.z * invW * 0.5f + 0.5f;
+    }
+
+    float *depth = b.depth.data();
+    for (uint32_t i = 0; i < CUBE_VERTEX_COUNT; i += 3) {
+        OcclusionTriangle t;
+        if (!OcclusionSetupTriangle(t, screen[i], screen[i + 1], screen[i + 2])) {
+            continue;
+        }
+        if (path == OCCLUSION_PATH_AVX) {
+            OcclusionRasterAVX(depth, t);
+        } else {
+            OcclusionRasterScalar(depth, t);
+        }
+        b.occluderTriangles++;
+    }
+}
+
+// Each texel keeps the farthest of the 2x2 below it; odd edges reuse the
+// last row or column
+void OcclusionBuildPyramid(OcclusionBuffer &b) {
+    for (uint32_t level = 1; level < b.levelCount; ++level) {
+        const float *src = b.depth.data() + b.levelOffset[level - 1];
+        float *dst = b.depth.data() + b.levelOffset[level];
+        uint32_t srcWidth = b.levelWidth[level - 1];
+        uint32_t srcHeight = b.levelHeight[level - 1];
+        for (uint32_t y = 0; y < b.levelHeight[level]; ++y) {
+            const float *row0 = src + (size_t)(2 * y) * srcWidth;
+            const float *row1 = src + (size_t)std::min(2 * y + 1, srcHeight - 1) * srcWidth;
+            for (uint32_t x = 0; x < b.levelWidth[level]; ++x) {
+                uint32_t x0 = 2 * x;
+                uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+                dst[y * b.levelWidth[level] + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionSphereVisible(const OcclusionBuffer &b, glm::vec3 center, float radius) {
+    // Corners of the sphere's box, built from the projected center and the
+    // projected axes
+    glm::vec4 c = b.viewProjection * glm::vec4(center, 1.0f);
+    glm::vec4 ex = b.viewProjection[0] * radius;
+    glm::vec4 ey = b.viewProjection[1] * radius;
+    glm::vec4 ez = b.viewProjection[2] * radius;
+
+    float minX = INFINITY, minY = INFINITY, minZ = INFINITY;
+    float maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 p = c + ex * ((i & 1) ? 1.0f : -1.0f) + ey * ((i & 2) ? 1.0f : -1.0f) + ez * ((i & 4) ? 1.0f : -1.0f);
+        if (p.w < OCCLUSION_MIN_W) {
+            return true;
+        }
+        float invW = 1.0f / p.w;
+        minX = std::min(minX, p.x * invW);
+        maxX = std::max(maxX, p.x * invW);
+        minY = std::min(minY, p.y * invW);
+        maxY = std::max(maxY, p.y * invW);
+        minZ = std::min(minZ, p.z * invW);
+    }
+
+    // Every level 0 pixel the rectangle touches, clamped to the screen
+    float fx0 = (minX * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+    float fx1 = (maxX * 0.5f + 0.5f) * (float)OCCLUSION_WIDTH;
+    float fy0 = (minY * 0.5f + 0.5f) * (float)OCCLUSION_HEIGHT;
+    float fy1 = (maxY * 0.5f + 0.5f) * (float)OCCLUSION_HEIGHT;
+    if (fx1 < 0.0f || fy1 < 0.0f || fx0 >= (float)OCCLUSION_WIDTH || fy0 >= (float)OCCLUSION_HEIGHT) {
+        return true; // off screen, frustum culling has the final say
+    }
+    uint32_t x0 = (uint32_t)std::max(fx0, 0.0f);
+    uint32_t y0 = (uint32_t)std::max(fy0, 0.0f);
+    uint32_t x1 = (uint32_t)std::min(fx1, (float)(OCCLUSION_WIDTH - 1));
+    uint32_t y1 = (uint32_t)std::min(fy1, (float)(OCCLUSION_HEIGHT - 1));
+
+    // Coarsest detail where the rectangle still spans at most 4x4 texels
+    uint32_t level = 0;
+    while (level + 1 < b.levelCount && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4)) {
+        level++;
+    }
+
+    const float *depth = b.depth.data() + b.levelOffset[level];
+    uint32_t width = b.levelWidth[level];
+    float farthest = 0.0f;
+    for (uint32_t y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (uint32_t x = x0 >> level; x <= (x1 >> level); ++x) {
+            farthest = std::max(farthest, depth[y * width + x]);
+        }
+    }
+    return minZ * 0.5f + 0.5f <= farthest;
+}
+
+static uint32_t OcclusionCullRange(const OcclusionBuffer &b, const CullSpheres &s, const uint32_t *candidates, uint32_t count, uint32_t *visible) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index = candidates[i];
+        glm::vec3 center(s.x[index], s.y[index], s.z[index]);
+        if (OcclusionSphereVisible(b, center, s.radius[index])) {
+            visible[n++] = index;
+        }
+    }
+    return n;
+}
+
+// Same packing as CullSpheresFrustumParallel: every job compacts its own
+// range in place, then the ranges are moved down in order
+uint32_t OcclusionCullSpheres(const OcclusionBuffer &b, const CullSpheres &s, uint32_t *visible, uint32_t count, JobPool *pool) {
+    const uint32_t jobCount = (count + OCCLUSION_JOB_SPHERES - 1) / OCCLUSION_JOB_SPHERES;
+    if (!pool || jobCount <= 1 || pool->workers.empty()) {
+        return OcclusionCullRange(b, s, visible, count, visible);
+    }
+
+    std::vector<uint32_t> jobVisible(jobCount);
+    JobPoolParallelFor(*pool, jobCount, [&](uint32_t job) {
+        uint32_t begin = job * OCCLUSION_JOB_SPHERES;
+        uint32_t end = std::min(begin + OCCLUSION_JOB_SPHERES, count);
+        jobVisible[job] = OcclusionCullRange(b, s, visible + begin, end - begin, visible + begin);
+    });
+
+    uint32_t n = jobVisible[0];
+    for (uint32_t job = 1; job < jobCount; ++job) {
+        memmove(visible + n, visible + job * OCCLUSION_JOB_SPHERES, jobVisible[job] * sizeof(uint32_t));
+        n += jobVisible[job];
+    }
+    return n;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "jobs.h"
+
+// Occlusion culling
+// The nearest cubes are rasterized as occluders into a small CPU depth
+// buffer, 8 pixels per step with AVX masks where available. A max-depth
+// pyramid is built on top, and every candidate's bounding box is then
+// tested against the one pyramid level where its screen rectangle covers
+// a few texels. A candidate is occluded when its nearest point lies behind
+// the farthest occluder depth under that rectangle. Depth is NDC z mapped
+// to 0..1, cleared to 1.
+//
+// Occluders are sampled at pixel centers, so a silhouette pixel counts as
+// covered when its center is. At this resolution that can hide a sliver
+// of a cube peeking past an occluder edge, which is the usual trade-off of
+// this kind of culler.
+// -------------------------------------
+#define OCCLUSION_WIDTH 256 // a multiple of 8 for the AVX rows
+#define OCCLUSION_HEIGHT 192
+#define OCCLUSION_MAX_LEVELS 10
+#define OCCLUSION_MAX_OCCLUDERS 64
+#define OCCLUSION_JOB_SPHERES 4096 // candidates per job when testing on a pool
+
+enum OcclusionPath {
+    OCCLUSION_PATH_SCALAR,
+    OCCLUSION_PATH_AVX,
+    OCCLUSION_PATH_AUTO
+};
+
+struct OcclusionBuffer {
+    glm::mat4 viewProjection;
+    std::vector<float> depth; // every level, finest first
+    uint32_t levelWidth[OCCLUSION_MAX_LEVELS];
+    uint32_t levelHeight[OCCLUSION_MAX_LEVELS];
+    uint32_t levelOffset[OCCLUSION_MAX_LEVELS];
+    uint32_t levelCount;
+    uint32_t occluderTriangles; // rasterized since the last clear
+};
+
+// Starts a frame: clears level 0 to the far plane
+void OcclusionClear(OcclusionBuffer &b, const glm::mat4 &viewProjection);
+// Rasterizes the unit cube of cubeVertices under `model`. Cubes reaching
+// behind the camera are skipped rather than clipped.
+void OcclusionRasterizeCube(OcclusionBuffer &b, const glm::mat4 &model, OcclusionPath path = OCCLUSION_PATH_AUTO);
+void OcclusionBuildPyramid(OcclusionBuffer &b);
+
+// False when the sphere's bounding box is hidden behind the occluders
+bool OcclusionSphereVisible(const OcclusionBuffer &b, glm::vec3 center, float radius);
+// Drops the occluded spheres from visible[0..count), keeping the order,
+// and returns how many are left. Runs on `pool` when given.
+uint32_t OcclusionCullSpheres(const OcclusionBuffer &b, const CullSpheres &s, uint32_t *visible, uint32_t count, JobPool *pool = nullptr);
+
+const char *OcclusionPathName(OcclusionPath path);
+OcclusionPath OcclusionBestPath();
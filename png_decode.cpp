@@ -0,0 +1,99 @@
+#include "png_decode.h"
+#include "cpu_features.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static int PngBestKernels() {
+    return CpuGetFeatures().avx2 ? STBI_PNG_KERNELS_AVX2 : STBI_PNG_KERNELS_SSE2;
+}
+
+void PngDecodeInit() {
+    stbi_png_set_kernels(PngBestKernels());
+}
+
+const char *PngKernelsName(int kernels) {
+    switch (kernels) {
+    case STBI_PNG_KERNELS_REFERENCE: return "reference";
+    case STBI_PNG_KERNELS_FAST: return "fast inflate";
+    case STBI_PNG_KERNELS_SSE2: return "sse2";
+    case STBI_PNG_KERNELS_AVX2: return "avx2";
+    default: return "unknown";
+    }
+}
+
+// Files are read up front so only decoding is timed. The reference level
+// decodes first, every other level is compared against its pixels.
+// ---------------------------
+void PngDecodeBenchmark() {
+    const uint32_t iterations = 20;
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator("./assets", ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".png") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::cerr << "No PNGs in ./assets" << std::endl;
+        return;
+    }
+
+    int best = PngBestKernels();
+    double totalMs[STBI_PNG_KERNELS_AVX2 + 1] = {};
+    for (const std::string &path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        std::vector<uint8_t> reference;
+        for (int kernels = STBI_PNG_KERNELS_REFERENCE; kernels <= best; ++kernels) {
+            stbi_png_set_kernels(kernels);
+            if (stbi_png_get_kernels() != kernels) {
+                continue; // not compiled in
+            }
+            double bestMs = 1e30;
+            int width = 0, height = 0, channels = 0;
+            std::vector<uint8_t> pixels;
+            for (uint32_t it = 0; it < iterations; ++it) {
+                auto start = std::chrono::steady_clock::now();
+                uint8_t *decoded = stbi_load_from_memory(data.data(), (int)data.size(), &width, &height, &channels, 0);
+                bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                if (!decoded) {
+                    std::cerr << "Cannot decode " << path << " : " << stbi_failure_reason() << std::endl;
+                    stbi_png_set_kernels(best);
+                    return;
+                }
+                if (it == 0) {
+                    pixels.assign(decoded, decoded + (size_t)width * height * channels);
+                }
+                stbi_image_free(decoded);
+            }
+            if (kernels == STBI_PNG_KERNELS_REFERENCE) {
+                reference = pixels;
+                std::cout << "png " << path << " " << width << "x" << height << "x" << channels << ", "
+                          << data.size() << " bytes" << std::endl;
+            }
+            totalMs[kernels] += bestMs;
+            std::cout << "png   " << PngKernelsName(kernels) << ": " << bestMs << " ms, "
+                      << (double)pixels.size() / (bestMs * 1.0e3) << " MB/s"
+                      << (pixels == reference ? "" : ", MISMATCH vs reference") << std::endl;
+        }
+    }
+
+    std::cout << "png all " << paths.size() << " files:";
+    for (int kernels = STBI_PNG_KERNELS_REFERENCE; kernels <= best; ++kernels) {
+        if (totalMs[kernels] > 0.0) {
+            std::cout << " " << PngKernelsName(kernels) << " " << totalMs[kernels] << " ms";
+        }
+    }
+    std::cout << std::endl;
+    stbi_png_set_kernels(best);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// PNG decoding
+// PNGs are decoded by the bundled stb_image, whose inflate and row
+// defilter loops come in several kernel levels (STBI_PNG_KERNELS_*, see
+// stb_image.h). Every level writes the same pixels. stb_image doesn't detect
+// CPU features, so the level is picked here, from cpu_features.h.
+// -------------------------------------
+
+// Picks the fastest level this CPU runs. Call before anything decodes.
+void PngDecodeInit();
+const char *PngKernelsName(int kernels);
+
+// Decode time and throughput of every level on the PNGs in ./assets
+void PngDecodeBenchmark();
@@ -0,0 +1,204 @@
+#include "profiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static_assert((PROFILER_RING_EVENTS & (PROFILER_RING_EVENTS - 1)) == 0, "ring size must be a power of two");
+
+struct ProfilerGpuPass {
+    const char *name;
+    uint64_t cpuStartNs; // when the pass was submitted
+};
+
+struct Profiler {
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    ProfilerEvent ring[PROFILER_RING_EVENTS];
+    std::atomic<uint64_t> writeIndex{0};
+    std::atomic<uint32_t> threadCount{0};
+
+    // GPU passes of the last PROFILER_GPU_LATENCY frames, one slot each.
+    // Only the thread owning the GL context touches these.
+    uint32_t queries[PROFILER_GPU_LATENCY][PROFILER_GPU_PASSES];
+    ProfilerGpuPass passes[PROFILER_GPU_LATENCY][PROFILER_GPU_PASSES];
+    uint32_t passCount[PROFILER_GPU_LATENCY];
+    uint32_t frame;
+    bool passOpen;
+    bool gpuReady;
+    uint64_t gpuTrackEndNs; // end of the last GPU event placed on the track
+    uint64_t droppedPasses;
+};
+
+static Profiler profiler;
+
+uint64_t ProfilerNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profiler.epoch).count();
+}
+
+uint32_t ProfilerThreadTrack() {
+    static thread_local uint32_t track = profiler.threadCount.fetch_add(1, std::memory_order_relaxed);
+    return track;
+}
+
+// Writers bracket the payload with sequence stores like a seqlock: 0 while
+// the slot is being filled, index + 1 once it's complete
+void ProfilerRecord(const char *name, uint64_t startNs, uint64_t endNs, uint32_t track) {
+    uint64_t index = profiler.writeIndex.fetch_add(1, std::memory_order_relaxed);
+    ProfilerEvent &e = profiler.ring[index & (PROFILER_RING_EVENTS - 1)];
+    e.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(name, std::memory_order_relaxed);
+    e.startNs.store(startNs, std::memory_order_relaxed);
+    e.durationNs.store(endNs > startNs ? endNs - startNs : 0, std::memory_order_relaxed);
+    e.track.store(track, std::memory_order_relaxed);
+    e.sequence.store(index + 1, std::memory_order_release);
+}
+
+// GPU passes
+// ---------------------------
+void ProfilerGpuInit() {
+    glGenQueries(PROFILER_GPU_LATENCY * PROFILER_GPU_PASSES, &profiler.queries[0][0]);
+    for (uint32_t i = 0; i < PROFILER_GPU_LATENCY; ++i) {
+        profiler.passCount[i] = 0;
+    }
+    profiler.frame = 0;
+    profiler.passOpen = false;
+    profiler.gpuReady = true;
+    profiler.gpuTrackEndNs = 0;
+    profiler.droppedPasses = 0;
+}
+
+void ProfilerGpuShutdown() {
+    if (!profiler.gpuReady) {
+        return;
+    }
+    glDeleteQueries(PROFILER_GPU_LATENCY * PROFILER_GPU_PASSES, &profiler.queries[0][0]);
+    profiler.gpuReady = false;
+    if (profiler.droppedPasses > 0) {
+        std::cerr << "Profiler dropped " << profiler.droppedPasses << " GPU passes whose results came in late" << std::endl;
+    }
+}
+
+void ProfilerGpuBegin(const char *name) {
+    uint32_t slot = profiler.frame % PROFILER_GPU_LATENCY;
+    uint32_t &count = profiler.passCount[slot];
+    if (!profiler.gpuReady || profiler.passOpen || count == PROFILER_GPU_PASSES) {
+        return;
+    }
+    profiler.passes[slot][count] = { name, ProfilerNowNs() };
+    glBeginQuery(GL_TIME_ELAPSED, profiler.queries[slot][count]);
+    profiler.passOpen = true;
+}
+
+void ProfilerGpuEnd() {
+    if (!profiler.passOpen) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    profiler.passCount[profiler.frame % PROFILER_GPU_LATENCY]++;
+    profiler.passOpen = false;
+}
+
+// Elapsed time queries carry durations only. Each pass is placed at the
+// CPU time it was submitted, or right after the previous pass when the
+// GPU was still busy with that one.
+void ProfilerGpuFrameEnd() {
+    if (!profiler.gpuReady) {
+        return;
+    }
+    profiler.frame++;
+    uint32_t slot = profiler.frame % PROFILER_GPU_LATENCY;
+    for (uint32_t i = 0; i < profiler.passCount[slot]; ++i) {
+        GLint available = 0;
+        glGetQueryObjectiv(profiler.queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            profiler.droppedPasses++;
+            continue;
+        }
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(profiler.queries[slot][i], GL_QUERY_RESULT, &elapsedNs);
+        const ProfilerGpuPass &pass = profiler.passes[slot][i];
+        uint64_t startNs = std::max(pass.cpuStartNs, profiler.gpuTrackEndNs);
+        profiler.gpuTrackEndNs = startNs + elapsedNs;
+        ProfilerRecord(pass.name, startNs, startNs + elapsedNs, PROFILER_GPU_TRACK);
+    }
+    profiler.passCount[slot] = 0;
+}
+
+// Chrome trace
+// ---------------------------
+static void ProfilerWriteJsonString(std::ofstream &file, const char *s) {
+    file << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            file << '\\';
+        }
+        file << *s;
+    }
+    file << '"';
+}
+
+bool ProfilerWriteChromeTrace(const char *path) {
+    struct Event {
+        const char *name;
+        uint64_t startNs;
+        uint64_t durationNs;
+        uint32_t track;
+    };
+
+    // Copy out whatever is complete, a slot rewritten meanwhile changes its
+    // sequence and is skipped
+    std::vector<Event> events;
+    uint64_t end = profiler.writeIndex.load(std::memory_order_acquire);
+    uint64_t begin = end > PROFILER_RING_EVENTS ? end - PROFILER_RING_EVENTS : 0;
+    events.reserve((size_t)(end - begin));
+    for (uint64_t index = begin; index < end; ++index) {
+        const ProfilerEvent &e = profiler.ring[index & (PROFILER_RING_EVENTS - 1)];
+        if (e.sequence.load(std::memory_order_acquire) != index + 1) {
+            continue;
+        }
+        Event copy = { e.name.load(std::memory_order_relaxed), e.startNs.load(std::memory_order_relaxed),
+                       e.durationNs.load(std::memory_order_relaxed), e.track.load(std::memory_order_relaxed) };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e.sequence.load(std::memory_order_relaxed) == index + 1) {
+            events.push_back(copy);
+        }
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Cannot write the profiler trace to " << path << std::endl;
+        return false;
+    }
+
+    // Chrome wants microseconds, the GPU track goes last
+    const uint32_t gpuTid = 1000;
+    uint32_t threads = profiler.threadCount.load(std::memory_order_relaxed);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpuTid << ",\"args\":{\"name\":\"GPU\"}}";
+    for (uint32_t t = 0; t < threads; ++t) {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\""
+             << (t == 0 ? "main" : "thread ") << (t == 0 ? "" : std::to_string(t)) << "\"}}";
+    }
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for (const Event &e : events) {
+        file << ",\n{\"name\":";
+        ProfilerWriteJsonString(file, e.name);
+        file << ",\"cat\":\"" << (e.track == PROFILER_GPU_TRACK ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << (e.track == PROFILER_GPU_TRACK ? gpuTid : e.track)
+             << ",\"ts\":" << (double)e.startNs * 1.0e-3 << ",\"dur\":" << (double)e.durationNs * 1.0e-3 << "}";
+    }
+    file << "\n]}\n";
+    file.close();
+    if (!file) {
+        std::cerr << "Cannot write the profiler trace to " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << events.size() << " profiler events to " << path << std::endl;
+    return true;
+}
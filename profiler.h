@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Frame profiler
+// CPU scopes from any thread go into one fixed ring of events. A writer
+// claims a slot with a single atomic add and publishes it with a sequence
+// number, so recording never locks and a dump skips slots that are still
+// being written or were overwritten meanwhile. GPU passes are timed with
+// GL_TIME_ELAPSED queries, read back PROFILER_GPU_LATENCY frames later
+// without waiting, and land in the same ring on a track of their own.
+// GL allows one elapsed time query at a time, so GPU passes don't nest.
+// The ring can be written out as Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev) at any time.
+// -------------------------------------
+#define PROFILER_RING_EVENTS 65536 // a power of two
+#define PROFILER_GPU_LATENCY 4     // frames before a pass query is read
+#define PROFILER_GPU_PASSES 16     // per frame
+#define PROFILER_GPU_TRACK 0xffffffffu
+
+// Every field is atomic so a dump racing a writer is well defined; the
+// sequence tells whether what it read belongs together
+struct ProfilerEvent {
+    std::atomic<const char *> name; // must outlive the profiler, string literals in practice
+    std::atomic<uint64_t> startNs;
+    std::atomic<uint64_t> durationNs;
+    std::atomic<uint32_t> track;    // recording thread, or PROFILER_GPU_TRACK
+    std::atomic<uint64_t> sequence; // claimed index + 1 once complete
+};
+
+// Nanoseconds since the profiler started
+uint64_t ProfilerNowNs();
+void ProfilerRecord(const char *name, uint64_t startNs, uint64_t endNs, uint32_t track);
+// Small index of the calling thread, the main thread is 0 if it asks first
+uint32_t ProfilerThreadTrack();
+
+struct ProfilerScope {
+    const char *name;
+    uint64_t startNs;
+
+    explicit ProfilerScope(const char *scopeName) : name(scopeName), startNs(ProfilerNowNs()) {}
+    ~ProfilerScope() { ProfilerRecord(name, startNs, ProfilerNowNs(), ProfilerThreadTrack()); }
+};
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfilerScope PROFILER_CONCAT(profilerScope, __LINE__)(name)
+
+// Needs a current GL context
+void ProfilerGpuInit();
+void ProfilerGpuShutdown();
+void ProfilerGpuBegin(const char *name);
+void ProfilerGpuEnd();
+// Reads back the passes of PROFILER_GPU_LATENCY frames ago and starts the
+// next frame. Results not ready by then are dropped rather than waited on.
+void ProfilerGpuFrameEnd();
+
+// Every complete event still in the ring, oldest first. Returns false when
+// the file can't be written.
+bool ProfilerWriteChromeTrace(const char *path);
@@ -0,0 +1,231 @@
+#include "render_queue.h"
+#include "gl_state.h"
+#include "null_gl.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+
+uint64_t RenderSortKey(RenderPass pass, uint32_t program, uint32_t textureSet, uint32_t vertexArray, float depth) {
+    const uint32_t depthMax = (1u << RENDER_DEPTH_BITS) - 1;
+    float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+    uint64_t quantized = (uint64_t)(clamped * (float)depthMax);
+
+    return ((uint64_t)(pass & 0xf) << 60) |
+           ((uint64_t)(program & 0xfff) << 48) |
+           ((uint64_t)(textureSet & 0xfff) << 36) |
+           ((uint64_t)(vertexArray & 0xfff) << 24) |
+           quantized;
+}
+
+void RenderQueueReset(RenderQueue &q) {
+    q.commands.clear();
+    q.models.clear();
+    q.textureSets.clear();
+}
+
+// A handful of sets per frame, a linear search beats hashing here
+uint32_t RenderQueueTextureSet(RenderQueue &q, uint32_t texture0, uint32_t texture1) {
+    uint64_t packed = ((uint64_t)texture1 << 32) | texture0;
+    for (uint32_t i = 0; i < q.textureSets.size(); ++i) {
+        if (q.textureSets[i] == packed) {
+            return i;
+        }
+    }
+    q.textureSets.push_back(packed);
+    return (uint32_t)q.textureSets.size() - 1;
+}
+
+uint32_t RenderQueueAddModel(RenderQueue &q, const glm::mat4 &model) {
+    q.models.push_back(model);
+    return (uint32_t)q.models.size() - 1;
+}
+
+void RenderQueuePush(RenderQueue &q, const RenderCommand &command) {
+    q.commands.push_back(command);
+}
+
+void RadixSort64(uint64_t *keys, uint32_t *values, uint32_t count, uint64_t *scratchKeys, uint32_t *scratchValues) {
+    // One histogram per byte, all gathered in a single read of the keys
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t key = keys[i];
+        for (int byte = 0; byte < 8; ++byte) {
+            histograms[byte][(key >> (byte * 8)) & 0xff]++;
+        }
+    }
+
+    uint64_t *srcKeys = keys, *dstKeys = scratchKeys;
+    uint32_t *srcValues = values, *dstValues = scratchValues;
+    for (int byte = 0; byte < 8; ++byte) {
+        uint32_t *histogram = histograms[byte];
+        if (count == 0 || histogram[(srcKeys[0] >> (byte * 8)) & 0xff] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < 256; ++bucket) {
+            uint32_t n = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += n;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t slot = histogram[(srcKeys[i] >> (byte * 8)) & 0xff]++;
+            dstKeys[slot] = srcKeys[i];
+            dstValues[slot] = srcValues[i];
+        }
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys) {
+        memcpy(keys, srcKeys, count * sizeof(uint64_t));
+        memcpy(values, srcValues, count * sizeof(uint32_t));
+    }
+}
+
+uint32_t RadixFloatKey(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+void RenderQueueSort(RenderQueue &q) {
+    uint32_t count = (uint32_t)q.commands.size();
+    q.keys.resize(count);
+    q.order.resize(count);
+    q.scratchKeys.resize(count);
+    q.scratchOrder.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        q.keys[i] = q.commands[i].key;
+        q.order[i] = i;
+    }
+    RadixSort64(q.keys.data(), q.order.data(), count, q.scratchKeys.data(), q.scratchOrder.data());
+}
+
+// Walks the commands in sorted order; the state cache drops whatever the
+// previous command already bound
+void RenderQueueSubmit(const RenderQueue &q) {
+    for (uint32_t index : q.order) {
+        const RenderCommand &c = q.commands[index];
+        GLStateUseProgram(c.program);
+        GLStateBindVertexArray(c.vertexArray);
+        for (uint32_t unit = 0; unit < RENDER_TEXTURE_SLOTS; ++unit) {
+            if (c.textures[unit]) {
+                GLStateBindTexture(unit, GL_TEXTURE_2D, c.textures[unit]);
+            }
+            if (c.samplers[unit]) {
+                GLStateBindSampler(unit, c.samplers[unit]);
+            }
+        }
+        if (c.modelLocation >= 0) {
+            glUniformMatrix4fv(c.modelLocation, 1, GL_FALSE, glm::value_ptr(q.models[c.modelIndex]));
+        }
+
+        if (c.instanceCount == 1) {
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)c.vertexCount);
+        } else if (c.instanceCount > 1) {
+            glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)c.vertexCount, (GLsizei)c.instanceCount);
+        }
+    }
+}
+
+// Benchmark
+// ---------------------------
+static uint32_t RenderRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static void RenderQueueRecord(RenderQueue &q, uint32_t count, uint32_t seed) {
+    RenderQueueReset(q);
+    for (uint32_t i = 0; i < count; ++i) {
+        RenderCommand c{};
+        c.program = 1 + RenderRandom(seed) % 8;
+        c.vertexArray = 1 + RenderRandom(seed) % 32;
+        c.textures[0] = 1 + RenderRandom(seed) % 16;
+        c.textures[1] = c.textures[0] + 16;
+        c.modelLocation = 0;
+        c.modelIndex = RenderQueueAddModel(q, glm::mat4(1.0f));
+        c.vertexCount = 36;
+        c.instanceCount = 1;
+        float depth = (float)(RenderRandom(seed) & 0xffff) / 65535.0f;
+        uint32_t textureSet = RenderQueueTextureSet(q, c.textures[0], c.textures[1]);
+        c.key = RenderSortKey(RENDER_PASS_OPAQUE, c.program, textureSet, c.vertexArray, depth);
+        RenderQueuePush(q, c);
+    }
+}
+
+static double RenderElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RenderQueueBenchmark() {
+    const uint32_t count = 100000;
+    const uint32_t iterations = 20;
+    NullGLLoad();
+
+    RenderQueue q;
+    double recordMs = 0.0, radixMs = 0.0, stdSortMs = 0.0, submitMs = 0.0, unsortedSubmitMs = 0.0;
+    GLStateCounters sortedCounters{}, unsortedCounters{};
+    uint64_t sortedCalls = 0, unsortedCalls = 0;
+    bool match = true;
+
+    for (uint32_t it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        RenderQueueRecord(q, count, 1234 + it);
+        recordMs += RenderElapsedMs(start);
+
+        // Submission order as recorded, for comparison
+        q.order.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            q.order[i] = i;
+        }
+        GLStateInvalidate();
+        GLStateResetCounters();
+        NullGLResetCounters();
+        start = std::chrono::steady_clock::now();
+        RenderQueueSubmit(q);
+        unsortedSubmitMs += RenderElapsedMs(start);
+        unsortedCounters = GLStateGetCounters();
+        unsortedCalls = NullGLTotalCalls();
+
+        // std::sort on (key, index) pairs as the reference
+        std::vector<std::pair<uint64_t, uint32_t>> reference(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            reference[i] = { q.commands[i].key, i };
+        }
+        start = std::chrono::steady_clock::now();
+        std::sort(reference.begin(), reference.end());
+        stdSortMs += RenderElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        RenderQueueSort(q);
+        radixMs += RenderElapsedMs(start);
+        for (uint32_t i = 0; i < count; ++i) {
+            match = match && reference[i].second == q.order[i];
+        }
+
+        GLStateInvalidate();
+        GLStateResetCounters();
+        NullGLResetCounters();
+        start = std::chrono::steady_clock::now();
+        RenderQueueSubmit(q);
+        submitMs += RenderElapsedMs(start);
+        sortedCounters = GLStateGetCounters();
+        sortedCalls = NullGLTotalCalls();
+    }
+
+    std::cout << "render queue, " << count << " commands, average of " << iterations << " runs" << std::endl;
+    std::cout << "  record:          " << recordMs / iterations << " ms" << std::endl;
+    std::cout << "  radix sort:      " << radixMs / iterations << " ms"
+              << (match ? "" : " (MISMATCH vs std::sort)") << std::endl;
+    std::cout << "  std::sort:       " << stdSortMs / iterations << " ms" << std::endl;
+    std::cout << "  submit unsorted: " << unsortedSubmitMs / iterations << " ms, " << unsortedCalls << " GL calls, "
+              << unsortedCounters.issued << " state changes issued / " << unsortedCounters.elided << " elided" << std::endl;
+    std::cout << "  submit sorted:   " << submitMs / iterations << " ms, " << sortedCalls << " GL calls, "
+              << sortedCounters.issued << " state changes issued / " << sortedCounters.elided << " elided" << std::endl;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Render queue
+// Draws are recorded as small commands with a 64-bit sort key, radix
+// sorted once per frame and submitted through the GL state cache. The key
+// puts state above depth, so draws sharing a program, texture set and
+// vertex array end up next to each other and, within such a run, go front
+// to back for early-Z rejection.
+//
+//   63..60  pass
+//   59..48  program
+//   47..36  texture set
+//   35..24  vertex array
+//   23..0   quantized depth, 0 = near plane
+// -------------------------------------
+#define RENDER_TEXTURE_SLOTS 2
+#define RENDER_DEPTH_BITS 24
+
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 0,
+};
+
+struct RenderCommand {
+    uint64_t key;
+    uint32_t program;
+    uint32_t vertexArray;
+    uint32_t textures[RENDER_TEXTURE_SLOTS]; // 0 leaves the unit alone
+    uint32_t samplers[RENDER_TEXTURE_SLOTS]; // likewise; not in the key, they follow the filter quality
+    int32_t modelLocation;                   // -1 when there is no model uniform
+    uint32_t modelIndex;
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+};
+
+struct RenderQueue {
+    std::vector<RenderCommand> commands;
+    std::vector<glm::mat4> models;
+    std::vector<uint64_t> textureSets; // both texture names packed, index = set id
+
+    // Sort buffers, kept around so steady state frames do not allocate
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> scratchKeys;
+    std::vector<uint32_t> scratchOrder;
+};
+
+// depth is normalized to 0..1 between the near and far plane
+uint64_t RenderSortKey(RenderPass pass, uint32_t program, uint32_t textureSet, uint32_t vertexArray, float depth);
+
+void RenderQueueReset(RenderQueue &q);
+uint32_t RenderQueueTextureSet(RenderQueue &q, uint32_t texture0, uint32_t texture1);
+uint32_t RenderQueueAddModel(RenderQueue &q, const glm::mat4 &model);
+void RenderQueuePush(RenderQueue &q, const RenderCommand &command);
+void RenderQueueSort(RenderQueue &q);
+void RenderQueueSubmit(const RenderQueue &q);
+
+// LSD radix sort of `count` keys with their values, 8 bits per pass. Passes
+// where every key has the same byte are skipped, so narrow keys only pay
+// for the bytes they use. Stable; the result ends up in keys/values.
+void RadixSort64(uint64_t *keys, uint32_t *values, uint32_t count, uint64_t *scratchKeys, uint32_t *scratchValues);
+
+// Maps a float onto an unsigned key with the same ordering
+uint32_t RadixFloatKey(float value);
+
+// Records, sorts and submits 100k commands against the null driver
+void RenderQueueBenchmark();
@@ -0,0 +1,172 @@
+#include "sampler_cache.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+bool SamplerQualityParse(const char *name, SamplerQuality &q) {
+    if (strcmp(name, "nearest") == 0) {
+        q = { SAMPLER_TIER_NEAREST, 1 };
+    } else if (strcmp(name, "bilinear") == 0) {
+        q = { SAMPLER_TIER_BILINEAR, 1 };
+    } else if (strcmp(name, "trilinear") == 0) {
+        q = { SAMPLER_TIER_TRILINEAR, 1 };
+    } else if (strncmp(name, "aniso", 5) == 0) {
+        char *end = nullptr;
+        unsigned long n = strtoul(name + 5, &end, 10);
+        if (*end != '\0' || n < 2 || n > SAMPLER_MAX_ANISOTROPY || (n & (n - 1)) != 0) {
+            return false;
+        }
+        q = { SAMPLER_TIER_ANISOTROPIC, (uint32_t)n };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *SamplerTierName(SamplerTier tier) {
+    switch (tier) {
+    case SAMPLER_TIER_NEAREST: return "nearest";
+    case SAMPLER_TIER_BILINEAR: return "bilinear";
+    case SAMPLER_TIER_TRILINEAR: return "trilinear";
+    case SAMPLER_TIER_ANISOTROPIC: return "anisotropic";
+    }
+    return "unknown";
+}
+
+SamplerQuality SamplerQualityNext(SamplerQuality q) {
+    switch (q.tier) {
+    case SAMPLER_TIER_NEAREST: return { SAMPLER_TIER_BILINEAR, 1 };
+    case SAMPLER_TIER_BILINEAR: return { SAMPLER_TIER_TRILINEAR, 1 };
+    case SAMPLER_TIER_TRILINEAR: return { SAMPLER_TIER_ANISOTROPIC, 2 };
+    case SAMPLER_TIER_ANISOTROPIC:
+        if (q.anisotropy < SAMPLER_MAX_ANISOTROPY) {
+            return { SAMPLER_TIER_ANISOTROPIC, q.anisotropy * 2 };
+        }
+        break;
+    }
+    return { SAMPLER_TIER_NEAREST, 1 };
+}
+
+SamplerState SamplerStateForQuality(SamplerQuality q, GLenum wrap) {
+    SamplerState s;
+    s.wrapS = wrap;
+    s.wrapT = wrap;
+    s.maxAnisotropy = 1.0f;
+    switch (q.tier) {
+    case SAMPLER_TIER_NEAREST:
+        s.minFilter = GL_NEAREST_MIPMAP_NEAREST;
+        s.magFilter = GL_NEAREST;
+        break;
+    case SAMPLER_TIER_BILINEAR:
+        s.minFilter = GL_LINEAR_MIPMAP_NEAREST;
+        s.magFilter = GL_LINEAR;
+        break;
+    case SAMPLER_TIER_TRILINEAR:
+        s.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+        s.magFilter = GL_LINEAR;
+        break;
+    case SAMPLER_TIER_ANISOTROPIC:
+        s.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+        s.magFilter = GL_LINEAR;
+        s.maxAnisotropy = (float)q.anisotropy;
+        break;
+    }
+    return s;
+}
+
+// State key
+// Filters and wraps each have a handful of legal values, so they pack into
+// a few bits and the key is exact: equal keys always mean equal states.
+// ---------------------------
+static uint64_t SamplerFilterBits(GLenum filter) {
+    switch (filter) {
+    case GL_NEAREST: return 0;
+    case GL_LINEAR: return 1;
+    case GL_NEAREST_MIPMAP_NEAREST: return 2;
+    case GL_LINEAR_MIPMAP_NEAREST: return 3;
+    case GL_NEAREST_MIPMAP_LINEAR: return 4;
+    default: return 5; // GL_LINEAR_MIPMAP_LINEAR
+    }
+}
+
+static uint64_t SamplerWrapBits(GLenum wrap) {
+    switch (wrap) {
+    case GL_REPEAT: return 0;
+    case GL_CLAMP_TO_EDGE: return 1;
+    case GL_MIRRORED_REPEAT: return 2;
+    default: return 3; // GL_CLAMP_TO_BORDER
+    }
+}
+
+static uint64_t SamplerStateKey(const SamplerState &s) {
+    uint32_t anisotropyBits;
+    memcpy(&anisotropyBits, &s.maxAnisotropy, sizeof(anisotropyBits));
+    return SamplerFilterBits(s.minFilter)
+         | SamplerFilterBits(s.magFilter) << 3
+         | SamplerWrapBits(s.wrapS) << 6
+         | SamplerWrapBits(s.wrapT) << 8
+         | (uint64_t)anisotropyBits << 32;
+}
+
+// Anisotropic filtering is core from 4.6, before that it is an extension
+// nearly every desktop driver has
+// ---------------------------
+static bool SamplerAnisotropySupported() {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 6)) {
+        return true;
+    }
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (name && (strcmp(name, "GL_EXT_texture_filter_anisotropic") == 0 ||
+                     strcmp(name, "GL_ARB_texture_filter_anisotropic") == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SamplerCacheInit(SamplerCache &c) {
+    c.samplers.clear();
+    c.requests = 0;
+    c.maxAnisotropy = 1.0f;
+    if (SamplerAnisotropySupported()) {
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &c.maxAnisotropy);
+        c.maxAnisotropy = std::max(c.maxAnisotropy, 1.0f);
+    }
+}
+
+void SamplerCacheShutdown(SamplerCache &c) {
+    for (auto &entry : c.samplers) {
+        GLStateDeleteSamplers(1, &entry.second);
+    }
+    c.samplers.clear();
+}
+
+uint32_t SamplerCacheGet(SamplerCache &c, SamplerState state) {
+    c.requests++;
+    state.maxAnisotropy = std::min(std::max(state.maxAnisotropy, 1.0f), c.maxAnisotropy);
+    uint64_t key = SamplerStateKey(state);
+    auto found = c.samplers.find(key);
+    if (found != c.samplers.end()) {
+        return found->second;
+    }
+
+    uint32_t sampler;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, (GLint)state.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, (GLint)state.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, (GLint)state.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, (GLint)state.wrapT);
+    if (state.maxAnisotropy > 1.0f) {
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, state.maxAnisotropy);
+    }
+    c.samplers[key] = sampler;
+    return sampler;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <glad/glad.h>
+
+// Sampler cache
+// Filtering and wrapping live in GL sampler objects bound per texture
+// unit, not in the textures, so a texture can be read with any filter and
+// switching quality never touches texture state. Samplers are shared: a
+// state is packed into a 64 bit key and every request for the same key
+// gets the same object. Anisotropy is clamped to what the driver offers
+// before the lookup, so tiers it can't tell apart share a sampler too.
+//   nearest    point sampled, nearest mip
+//   bilinear   filtered within the nearest mip
+//   trilinear  filtered within and between the two nearest mips
+//   anisoN     trilinear with up to N taps along the axis of anisotropy
+// Every tier reads the mip chain, so minified textures stay cache friendly.
+// -------------------------------------
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE     // GL 4.6, EXT/ARB_texture_filter_anisotropic
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+#define SAMPLER_MAX_ANISOTROPY 16
+
+enum SamplerTier {
+    SAMPLER_TIER_NEAREST,
+    SAMPLER_TIER_BILINEAR,
+    SAMPLER_TIER_TRILINEAR,
+    SAMPLER_TIER_ANISOTROPIC
+};
+
+struct SamplerQuality {
+    SamplerTier tier;
+    uint32_t anisotropy; // 2..SAMPLER_MAX_ANISOTROPY, anisotropic tier only
+};
+
+struct SamplerState {
+    GLenum minFilter;
+    GLenum magFilter;
+    GLenum wrapS;
+    GLenum wrapT;
+    float maxAnisotropy; // 1 turns it off
+};
+
+struct SamplerCache {
+    std::unordered_map<uint64_t, uint32_t> samplers; // state key -> sampler object
+    float maxAnisotropy; // of the driver, 1 without the extension
+    uint32_t requests;
+};
+
+// "nearest", "bilinear", "trilinear" or "anisoN" with N a power of two
+bool SamplerQualityParse(const char *name, SamplerQuality &q);
+const char *SamplerTierName(SamplerTier tier);
+// The next tier up, wrapping around to nearest; walks anisotropy by doubling
+SamplerQuality SamplerQualityNext(SamplerQuality q);
+SamplerState SamplerStateForQuality(SamplerQuality q, GLenum wrap);
+
+// Needs a current GL context
+void SamplerCacheInit(SamplerCache &c);
+void SamplerCacheShutdown(SamplerCache &c);
+// Sampler object with `state`, created the first time it is asked for
+uint32_t SamplerCacheGet(SamplerCache &c, SamplerState state);
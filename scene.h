@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Scene data
+// Shared by the GL renderer and the software rasterizer so both draw the
+// same cubes under the same light.
+// -------------------------------------
+#define CUBE_VERTEX_COUNT 36
+#define CUBE_VERTEX_STRIDE 8 // position, normal, texture coords
+#define CUBE_MATERIAL_SHININESS 32.0f
+#define CUBE_DIFFUSE_MAP "./assets/container2.png"
+#define CUBE_SPECULAR_MAP "./assets/container2_specular.png" // grey, packed into the diffuse alpha
+
+extern const float cubeVertices[CUBE_VERTEX_COUNT * CUBE_VERTEX_STRIDE];
+
+// Per instance data, laid out the way colors_vertex.glsl reads it
+struct CubeInstance {
+    glm::mat4 model;
+    glm::mat3 normalMatrix;
+};
+
+// `uniform Light light` in colors_fragment.glsl
+struct SpotLight {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// The flashlight carried by the camera
+SpotLight SpotLightFromCamera(glm::vec3 position, glm::vec3 front);
@@ -524,6 +524,23 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// PNG decode kernels (also used by the ZLIB client). Each level adds to the
+// one before it. Defaults to SSE2 where stb_image compiles SSE2 code, FAST
+// elsewhere. AVX2 is never picked on its own, since stb_image doesn't detect
+// CPU features: check for it before asking. Set it before decoding starts,
+// it is not thread safe.
+enum
+{
+   STBI_PNG_KERNELS_REFERENCE, // the original inflate and defilter loops
+   STBI_PNG_KERNELS_FAST,      // table driven inflate, scalar defilter
+   STBI_PNG_KERNELS_SSE2,      // SSE2 defilter
+   STBI_PNG_KERNELS_AVX2       // AVX2 for rows filtered with Up
+};
+
+// clamped to the highest level compiled in
+STBIDEF void stbi_png_set_kernels(int kernels);
+STBIDEF int  stbi_png_get_kernels(void);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -774,6 +791,18 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 PNG kernels are compiled with a target attribute, so they build
+// without -mavx2 and only run once the caller turns them on
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && (defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+#define STBI__AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define STBI__AVX2_TARGET
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -4092,6 +4121,36 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
+// tables of the fast inflate loop, see stbi__parse_huffman_block_fast
+#define STBI__ZFAST2_BITS  10
+#define STBI__ZFAST2_MASK  ((1 << STBI__ZFAST2_BITS) - 1)
+
+typedef unsigned long long stbi__uint64;
+
+#ifdef STBI_SSE2
+static int stbi__png_kernels = STBI_PNG_KERNELS_SSE2;
+#else
+static int stbi__png_kernels = STBI_PNG_KERNELS_FAST;
+#endif
+
+STBIDEF void stbi_png_set_kernels(int kernels)
+{
+   int highest = STBI_PNG_KERNELS_FAST;
+#ifdef STBI_SSE2
+   highest = STBI_PNG_KERNELS_SSE2;
+#endif
+#ifdef STBI__AVX2
+   highest = STBI_PNG_KERNELS_AVX2;
+#endif
+   if (kernels < STBI_PNG_KERNELS_REFERENCE) kernels = STBI_PNG_KERNELS_REFERENCE;
+   stbi__png_kernels = kernels < highest ? kernels : highest;
+}
+
+STBIDEF int stbi_png_get_kernels(void)
+{
+   return stbi__png_kernels;
+}
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -4187,6 +4246,10 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+
+   int fast; // use stbi__parse_huffman_block_fast
+   stbi__uint32 fast_length[1 << STBI__ZFAST2_BITS];
+   stbi__uint32 fast_distance[1 << STBI__ZFAST2_BITS];
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
@@ -4306,9 +4369,211 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
-static int stbi__parse_huffman_block(stbi__zbuf *a)
+// Fast inflate
+// The loop below refills a 32 bit buffer a byte at a time and checks for
+// the end of input and output on every symbol. As long as there are at
+// least STBI__ZFAST_IN_SLACK input bytes left and room for the longest
+// match, this one skips both checks. It refills a 64 bit buffer with one
+// unaligned load, which holds enough bits for a whole length/distance pair.
+// Symbols come out of 10 bit tables whose entries already hold the literal,
+// or the base and extra bit count of a length or distance. Close to either
+// end it hands the bits back and the loop below finishes the block.
+#define STBI__ZFAST_IN_SLACK   16
+#define STBI__ZFAST_OUT_SLACK  (258 + 8) // longest match, plus a word copied past its end
+
+// table entry: base << 16 | extra bits << 8 | kind | code length
+#define STBI__ZFAST2_LITERAL   0x20
+#define STBI__ZFAST2_MATCH     0x40
+#define STBI__ZFAST2_END       0x60
+#define STBI__ZFAST2_KIND      0x60
+
+// 0 for symbols that must not appear in compressed data
+static stbi__uint32 stbi__zfast_entry(int symbol, int length, int distance)
+{
+   if (distance)
+      return symbol < 30 ? (stbi__uint32) (stbi__zdist_base[symbol] << 16 | stbi__zdist_extra[symbol] << 8 | STBI__ZFAST2_MATCH | length) : 0;
+   if (symbol < 256)
+      return (stbi__uint32) (symbol << 16 | STBI__ZFAST2_LITERAL | length);
+   if (symbol == 256)
+      return (stbi__uint32) (STBI__ZFAST2_END | length);
+   if (symbol < 286)
+      return (stbi__uint32) (stbi__zlength_base[symbol-257] << 16 | stbi__zlength_extra[symbol-257] << 8 | STBI__ZFAST2_MATCH | length);
+   return 0;
+}
+
+// same code assignment as stbi__zbuild_huffman, which must have run first
+static void stbi__zbuild_fast2(stbi__uint32 *table, const stbi__zhuffman *z, const stbi_uc *sizelist, int num, int distance)
 {
+   int i, next_code[16];
+   memset(table, 0, sizeof(stbi__uint32) << STBI__ZFAST2_BITS);
+   for (i=1; i < 16; ++i)
+      next_code[i] = z->firstcode[i];
+   for (i=0; i < num; ++i) {
+      int s = sizelist[i];
+      if (s) {
+         if (s <= STBI__ZFAST2_BITS) {
+            stbi__uint32 entry = stbi__zfast_entry(i, s, distance);
+            int j = stbi__bit_reverse(next_code[s],s);
+            while (j < (1 << STBI__ZFAST2_BITS)) {
+               table[j] = entry;
+               j += (1 << s);
+            }
+         }
+         ++next_code[s];
+      }
+   }
+}
+
+// codes longer than the table, as in stbi__zhuffman_decode_slowpath
+static int stbi__zfast_decode_long(const stbi__zhuffman *z, stbi__uint64 bits, int *length)
+{
+   int b,s,k;
+   k = stbi__bit_reverse((int) (bits & 0xffff), 16);
+   for (s=STBI__ZFAST2_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s >= 16) return -1; // invalid code!
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b < 0 || b >= STBI__ZNSYMS) return -1; // from a code shorter than the table, never assigned
+   if (z->size[b] != s) return -1;
+   *length = s;
+   return z->value[b];
+}
+
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc *p)
+{
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET)
+   stbi__uint64 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+#else
+   return (stbi__uint64) p[0]       | (stbi__uint64) p[1] <<  8 | (stbi__uint64) p[2] << 16 | (stbi__uint64) p[3] << 24 |
+          (stbi__uint64) p[4] << 32 | (stbi__uint64) p[5] << 40 | (stbi__uint64) p[6] << 48 | (stbi__uint64) p[7] << 56;
+#endif
+}
+
+// sets *done when it reached the end of the block
+static int stbi__parse_huffman_block_fast(stbi__zbuf *a, int *done)
+{
+   const stbi_uc *in = a->zbuffer;
+   stbi__uint64 bitbuf = a->code_buffer;
+   int bitcount = a->num_bits;
    char *zout = a->zout;
+
+   *done = 0;
+   // the bits the loop below holds then aren't all from the input
+   if (a->zbuffer_end - in < STBI__ZFAST_IN_SLACK || a->hit_zeof_once)
+      return 1;
+
+   while (a->zbuffer_end - in >= STBI__ZFAST_IN_SLACK) {
+      stbi__uint32 entry;
+      int n, len, dist;
+      char *end;
+      const char *src;
+
+      if (a->zout_end - zout < STBI__ZFAST_OUT_SLACK) {
+         if (!a->z_expandable) break;
+         if (!stbi__zexpand(a, zout, STBI__ZFAST_OUT_SLACK)) return 0;
+         zout = a->zout;
+      }
+
+      // 56 to 63 bits after this; bits past bitcount are input bytes not
+      // consumed yet, which the next load puts back in the same place
+      bitbuf |= stbi__zload64(in) << bitcount;
+      in += (63 - bitcount) >> 3;
+      bitcount |= 56;
+
+      entry = a->fast_length[bitbuf & STBI__ZFAST2_MASK];
+      if ((entry & STBI__ZFAST2_KIND) == STBI__ZFAST2_LITERAL) {
+         n = entry & 31;
+         bitbuf >>= n;
+         bitcount -= n;
+         *zout++ = (char) (entry >> 16);
+         // a second literal still fits in the bits of this refill
+         entry = a->fast_length[bitbuf & STBI__ZFAST2_MASK];
+         if ((entry & STBI__ZFAST2_KIND) == STBI__ZFAST2_LITERAL) {
+            n = entry & 31;
+            bitbuf >>= n;
+            bitcount -= n;
+            *zout++ = (char) (entry >> 16);
+         }
+         continue;
+      }
+      if (entry == 0) {
+         int symbol = stbi__zfast_decode_long(&a->z_length, bitbuf, &n);
+         if (symbol < 0) return stbi__err("bad huffman code","Corrupt PNG");
+         entry = stbi__zfast_entry(symbol, n, 0);
+         if (entry == 0) return stbi__err("bad huffman code","Corrupt PNG"); // length codes 286 and 287
+      }
+      n = entry & 31;
+      bitbuf >>= n;
+      bitcount -= n;
+      if ((entry & STBI__ZFAST2_KIND) == STBI__ZFAST2_LITERAL) {
+         *zout++ = (char) (entry >> 16);
+         continue;
+      }
+      if ((entry & STBI__ZFAST2_KIND) == STBI__ZFAST2_END) {
+         *done = 1;
+         break;
+      }
+      n = (entry >> 8) & 15;
+      len = (int) (entry >> 16) + (int) (bitbuf & ((1u << n) - 1));
+      bitbuf >>= n;
+      bitcount -= n;
+
+      entry = a->fast_distance[bitbuf & STBI__ZFAST2_MASK];
+      if (entry == 0) {
+         int symbol = stbi__zfast_decode_long(&a->z_distance, bitbuf, &n);
+         if (symbol < 0) return stbi__err("bad huffman code","Corrupt PNG");
+         entry = stbi__zfast_entry(symbol, n, 1);
+         if (entry == 0) return stbi__err("bad huffman code","Corrupt PNG"); // distance codes 30 and 31
+      }
+      n = entry & 31;
+      bitbuf >>= n;
+      bitcount -= n;
+      n = (entry >> 8) & 15;
+      dist = (int) (entry >> 16) + (int) (bitbuf & ((1u << n) - 1));
+      bitbuf >>= n;
+      bitcount -= n;
+      if (zout - a->zout_start < dist) return stbi__err("bad dist","Corrupt PNG");
+
+      src = zout - dist;
+      end = zout + len;
+      if (dist >= 8) {
+         // may copy up to 7 bytes past the end, inside the output slack
+         do {
+            memcpy(zout, src, 8);
+            zout += 8;
+            src += 8;
+         } while (zout < end);
+      } else if (dist == 1) { // run of one byte; common in images.
+         memset(zout, *src, len);
+      } else {
+         do *zout++ = *src++; while (zout < end);
+      }
+      zout = end;
+   }
+
+   // hand whole bytes back to the input, the loop below wants the bit
+   // buffer to hold only bits from the bytes right before a->zbuffer
+   in -= bitcount >> 3;
+   bitcount &= 7;
+   a->zbuffer = (stbi_uc *) in;
+   a->code_buffer = (stbi__uint32) bitbuf & ((1u << bitcount) - 1);
+   a->num_bits = bitcount;
+   a->zout = zout;
+   return 1;
+}
+
+static int stbi__parse_huffman_block(stbi__zbuf *a)
+{
+   char *zout;
+   if (a->fast) {
+      int done;
+      if (!stbi__parse_huffman_block_fast(a, &done)) return 0;
+      if (done) return 1;
+   }
+   zout = a->zout;
    for(;;) {
       int z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
@@ -4403,6 +4668,10 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
    if (n != ntot) return stbi__err("bad codelengths","Corrupt PNG");
    if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
    if (!stbi__zbuild_huffman(&a->z_distance, lencodes+hlit, hdist)) return 0;
+   if (a->fast) {
+      stbi__zbuild_fast2(a->fast_length, &a->z_length, lencodes, hlit, 0);
+      stbi__zbuild_fast2(a->fast_distance, &a->z_distance, lencodes+hlit, hdist, 1);
+   }
    return 1;
 }
 
@@ -4498,6 +4767,10 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
             // use fixed code lengths
             if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS)) return 0;
             if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+            if (a->fast) {
+               stbi__zbuild_fast2(a->fast_length  , &a->z_length  , stbi__zdefault_length  , STBI__ZNSYMS, 0);
+               stbi__zbuild_fast2(a->fast_distance, &a->z_distance, stbi__zdefault_distance,  32, 1);
+            }
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
@@ -4513,6 +4786,7 @@ static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->fast = stbi__png_kernels >= STBI_PNG_KERNELS_FAST;
 
    return stbi__parse_zlib(a, parse_header);
 }
@@ -4692,6 +4966,138 @@ static void stbi__create_png_alpha_expand8(stbi_uc *dest, stbi_uc *src, stbi__ui
    }
 }
 
+#ifdef STBI_SSE2
+// PNG defilter kernels
+// Sub and Avg predict each byte from the one filter_bytes to its left, so
+// a row is a serial chain of pixels. They go a pixel at a time, with all
+// its channels in one register. Only Sub of 4 byte pixels takes 4 pixels at
+// once, adding the register to itself shifted by one pixel, then by two. Up
+// has no chain and takes 16 bytes at once, or 32 with AVX2.
+// Paeth stays scalar: its chain through the left pixel is longer in SIMD
+// than stbi__paeth's, whose channels run side by side, and it came out
+// slower. Pixels of 3 and 4 bytes are covered (8 bit RGB and RGBA, 16 bit
+// gray with alpha); other rows, except Up, take the scalar loops too. The
+// helpers are forced inline so the pixel size is a constant in every loop.
+#ifdef _MSC_VER
+#define STBI__PNG_INLINE __forceinline
+#else
+#define STBI__PNG_INLINE inline __attribute__((always_inline))
+#endif
+
+// 3 byte pixels go through shifts, a 3 byte memcpy into an int would stall
+// on store forwarding
+STBI__PNG_INLINE static __m128i stbi__png_load_pixel(const stbi_uc *p, int n)
+{
+   int v;
+   if (n == 4)
+      memcpy(&v, p, 4);
+   else
+      v = p[0] | p[1] << 8 | p[2] << 16;
+   return _mm_cvtsi32_si128(v);
+}
+
+STBI__PNG_INLINE static void stbi__png_store_pixel(stbi_uc *p, __m128i v, int n)
+{
+   int x = _mm_cvtsi128_si32(v);
+   if (n == 4) {
+      memcpy(p, &x, 4);
+   } else {
+      p[0] = STBI__BYTECAST(x);
+      p[1] = STBI__BYTECAST(x >> 8);
+      p[2] = STBI__BYTECAST(x >> 16);
+   }
+}
+
+STBI__PNG_INLINE static void stbi__png_sub_sse2(stbi_uc *cur, const stbi_uc *raw, int nk, int n)
+{
+   __m128i a = _mm_setzero_si128();
+   int k = 0;
+   if (n == 4) {
+      for (; k + 16 <= nk; k += 16) {
+         __m128i x = _mm_loadu_si128((const __m128i *) (raw + k));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+         x = _mm_add_epi8(x, a);
+         _mm_storeu_si128((__m128i *) (cur + k), x);
+         a = _mm_shuffle_epi32(x, _MM_SHUFFLE(3,3,3,3));
+      }
+   }
+   for (; k < nk; k += n) {
+      a = _mm_add_epi8(a, stbi__png_load_pixel(raw + k, n));
+      stbi__png_store_pixel(cur + k, a, n);
+   }
+}
+
+STBI__PNG_INLINE static void stbi__png_avg_sse2(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int n)
+{
+   __m128i a = _mm_setzero_si128();
+   __m128i one = _mm_set1_epi8(1);
+   int k;
+   for (k=0; k < nk; k += n) {
+      __m128i b = stbi__png_load_pixel(prior + k, n);
+      // _mm_avg_epu8 rounds up, PNG rounds down
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(stbi__png_load_pixel(raw + k, n), avg);
+      stbi__png_store_pixel(cur + k, a, n);
+   }
+}
+
+STBI__PNG_INLINE static int stbi__png_defilter_pixels(int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int n)
+{
+   switch (filter) {
+   case STBI__F_sub: stbi__png_sub_sse2(cur, raw, nk, n); return 1;
+   case STBI__F_avg: stbi__png_avg_sse2(cur, prior, raw, nk, n); return 1;
+   }
+   return 0;
+}
+
+static void stbi__png_up_sse2(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk)
+{
+   int k;
+   for (k=0; k + 16 <= nk; k += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *) (raw + k));
+      __m128i b = _mm_loadu_si128((const __m128i *) (prior + k));
+      _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(x, b));
+   }
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+#ifdef STBI__AVX2
+STBI__AVX2_TARGET static void stbi__png_up_avx2(stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk)
+{
+   int k;
+   for (k=0; k + 32 <= nk; k += 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i *) (raw + k));
+      __m256i b = _mm256_loadu_si256((const __m256i *) (prior + k));
+      _mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(x, b));
+   }
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+#endif
+
+// 0 when the row is left to the scalar loops
+static int stbi__png_defilter_simd(int kernels, int filter, stbi_uc *cur, const stbi_uc *prior, const stbi_uc *raw, int nk, int filter_bytes)
+{
+   if (filter == STBI__F_up) {
+#ifdef STBI__AVX2
+      if (kernels >= STBI_PNG_KERNELS_AVX2) {
+         stbi__png_up_avx2(cur, prior, raw, nk);
+         return 1;
+      }
+#endif
+      stbi__png_up_sse2(cur, prior, raw, nk);
+      return 1;
+   }
+   STBI_NOTUSED(kernels);
+   // constant pixel sizes, so the loads and stores inline
+   if (filter_bytes == 4) return stbi__png_defilter_pixels(filter, cur, prior, raw, nk, 4);
+   if (filter_bytes == 3) return stbi__png_defilter_pixels(filter, cur, prior, raw, nk, 3);
+   return 0;
+}
+#endif // STBI_SSE2
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4701,7 +5107,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    stbi__uint32 img_len, img_width_bytes;
    stbi_uc *filter_buf;
    int all_ok = 1;
-   int k;
+   int k, handled;
    int img_n = s->img_n; // copy it into a local for later
 
    int output_bytes = out_n*bytes;
@@ -4752,7 +5158,12 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       if (j == 0) filter = first_row_filter[filter];
 
       // perform actual filtering
-      switch (filter) {
+      handled = 0;
+#ifdef STBI_SSE2
+      if (stbi__png_kernels >= STBI_PNG_KERNELS_SSE2)
+         handled = stbi__png_defilter_simd(stbi__png_kernels, filter, cur, prior, raw, nk, filter_bytes);
+#endif
+      if (!handled) switch (filter) {
       case STBI__F_none:
          memcpy(cur, raw, nk);
          break;
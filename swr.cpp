@@ -0,0 +1,480 @@
+#include "swr.h"
+#include "material_pack.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <bitset>
+#include <emmintrin.h>
+
+// Takes RGBA8 `pixels` and frees them
+static void SwrTextureSet(SwrTexture &t, unsigned char *pixels, int width, int height) {
+    t.width = (uint32_t)width;
+    t.height = (uint32_t)height;
+    t.texels.resize((size_t)width * height);
+    memcpy(t.texels.data(), pixels, t.texels.size() * 4);
+    stbi_image_free(pixels);
+
+    size_t lines = (t.texels.size() * 4 + SWR_CACHE_LINE - 1) / SWR_CACHE_LINE;
+    t.lineWords = (uint32_t)((lines + 63) / 64);
+    t.linesTouched.reset(new std::atomic<uint64_t>[t.lineWords]);
+    for (uint32_t i = 0; i < t.lineWords; ++i) {
+        t.linesTouched[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Bytes of the cache lines sampled since the last call, which starts over
+static uint64_t SwrTextureTakeTouchedBytes(SwrTexture &t) {
+    uint64_t lines = 0;
+    for (uint32_t i = 0; i < t.lineWords; ++i) {
+        lines += std::bitset<64>(t.linesTouched[i].exchange(0, std::memory_order_relaxed)).count();
+    }
+    return lines * SWR_CACHE_LINE;
+}
+
+static void SwrTextureLoad(SwrTexture &t, const char *path) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(true);
+    unsigned char *pixels = stbi_load(path, &width, &height, &channels, 4);
+    if (!pixels) {
+        std::cerr << "Failed to load texture " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    SwrTextureSet(t, pixels, width, height);
+}
+
+// Nearest texel of the top level with GL_REPEAT wrapping. Cheaper than
+// any of the GL sampler tiers, which also read the mip chain.
+static glm::vec4 SwrTextureSample(const SwrTexture &t, float u, float v) {
+    float fu = u - std::floor(u);
+    float fv = v - std::floor(v);
+    uint32_t x = std::min((uint32_t)(fu * (float)t.width), t.width - 1);
+    uint32_t y = std::min((uint32_t)(fv * (float)t.height), t.height - 1);
+    size_t index = (size_t)y * t.width + x;
+    uint32_t texel = t.texels[index];
+
+    // Tiles shade in parallel. Most samples land on a line already marked,
+    // so look before paying for the atomic or.
+    size_t line = index * 4 / SWR_CACHE_LINE;
+    std::atomic<uint64_t> &word = t.linesTouched[line / 64];
+    uint64_t bit = 1ull << (line % 64);
+    if (!(word.load(std::memory_order_relaxed) & bit)) {
+        word.fetch_or(bit, std::memory_order_relaxed);
+    }
+    return glm::vec4((float)(texel & 0xff), (float)((texel >> 8) & 0xff),
+                     (float)((texel >> 16) & 0xff), (float)(texel >> 24)) * (1.0f / 255.0f);
+}
+
+void SwrInit(SwrContext &ctx, uint32_t width, uint32_t height, uint32_t threadCount,
+             const char *diffusePath, const char *specularPath, bool packedMaterial) {
+    ctx.width = width;
+    ctx.height = height;
+    ctx.stride = (width + 3) & ~3u;
+    ctx.tilesX = (width + SWR_TILE_SIZE - 1) / SWR_TILE_SIZE;
+    ctx.tilesY = (height + SWR_TILE_SIZE - 1) / SWR_TILE_SIZE;
+
+    size_t pixels = (size_t)ctx.stride * height;
+    ctx.color.assign(pixels, 0);
+    ctx.depth.assign(pixels, 1.0f);
+    ctx.triangle.assign(pixels, nullptr);
+    ctx.weight1.assign(pixels, 0.0f);
+    ctx.weight2.assign(pixels, 0.0f);
+
+    ctx.packedMaterial = packedMaterial;
+    if (packedMaterial) {
+        int textureWidth, textureHeight;
+        unsigned char *packed = MaterialPackLoad(diffusePath, specularPath, textureWidth, textureHeight);
+        if (!packed) {
+            exit(EXIT_FAILURE);
+        }
+        SwrTextureSet(ctx.materialMap, packed, textureWidth, textureHeight);
+    } else {
+        SwrTextureLoad(ctx.diffuseMap, diffusePath);
+        SwrTextureLoad(ctx.specularMap, specularPath);
+    }
+    ctx.textureBytes = 0;
+
+    ctx.threadCount = std::max(threadCount, 1u);
+    if (ctx.threadCount > 1) {
+        JobPoolInit(ctx.pool, ctx.threadCount - 1);
+    }
+}
+
+void SwrShutdown(SwrContext &ctx) {
+    JobPoolShutdown(ctx.pool);
+    ctx.chunkTriangles.clear();
+    ctx.chunkBins.clear();
+}
+
+// Transform
+// ---------------------------
+struct SwrVertex {
+    glm::vec4 clip;
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+static SwrVertex SwrVertexLerp(const SwrVertex &a, const SwrVertex &b, float t) {
+    SwrVertex v;
+    v.clip = a.clip + (b.clip - a.clip) * t;
+    v.position = a.position + (b.position - a.position) * t;
+    v.normal = a.normal + (b.normal - a.normal) * t;
+    v.uv = a.uv + (b.uv - a.uv) * t;
+    return v;
+}
+
+// Viewport transform and edge setup. Returns false for triangles that
+// are degenerate or fall outside the screen.
+static bool SwrTriangleSetup(const SwrContext &ctx, const SwrVertex *v, bool lit, SwrTriangle &t) {
+    for (int i = 0; i < 3; ++i) {
+        float invW = 1.0f / v[i].clip.w;
+        t.x[i] = (v[i].clip.x * invW * 0.5f + 0.5f) * (float)ctx.width;
+        t.y[i] = (v[i].clip.y * invW * 0.5f + 0.5f) * (float)ctx.height;
+        t.z[i] = v[i].clip.z * invW * 0.5f + 0.5f;
+        t.invW[i] = invW;
+        t.position[i] = v[i].position;
+        t.normal[i] = v[i].normal;
+        t.uv[i] = v[i].uv;
+    }
+    t.lit = lit;
+
+    float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+    if (!(area != 0.0f)) {
+        return false;
+    }
+    // No face culling on the GL side either, so flip clockwise triangles
+    // instead of dropping them
+    if (area < 0.0f) {
+        std::swap(t.x[1], t.x[2]);
+        std::swap(t.y[1], t.y[2]);
+        std::swap(t.z[1], t.z[2]);
+        std::swap(t.invW[1], t.invW[2]);
+        std::swap(t.position[1], t.position[2]);
+        std::swap(t.normal[1], t.normal[2]);
+        std::swap(t.uv[1], t.uv[2]);
+    }
+
+    float minX = std::min({ t.x[0], t.x[1], t.x[2] });
+    float maxX = std::max({ t.x[0], t.x[1], t.x[2] });
+    float minY = std::min({ t.y[0], t.y[1], t.y[2] });
+    float maxY = std::max({ t.y[0], t.y[1], t.y[2] });
+    t.minX = std::max((int32_t)std::floor(minX), 0);
+    t.minY = std::max((int32_t)std::floor(minY), 0);
+    t.maxX = std::min((int32_t)std::ceil(maxX), (int32_t)ctx.width - 1);
+    t.maxY = std::min((int32_t)std::ceil(maxY), (int32_t)ctx.height - 1);
+    return t.minX <= t.maxX && t.minY <= t.maxY;
+}
+
+// Clips against the near plane (z >= -w), which leaves at most a quad, and
+// emits the result as one or two triangles
+static void SwrTriangleEmit(SwrContext &ctx, uint32_t chunk, const SwrVertex *in, bool lit) {
+    SwrVertex clipped[4];
+    uint32_t count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const SwrVertex &a = in[i];
+        const SwrVertex &b = in[(i + 1) % 3];
+        float da = a.clip.z + a.clip.w;
+        float db = b.clip.z + b.clip.w;
+        if (da >= 0.0f) {
+            clipped[count++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            clipped[count++] = SwrVertexLerp(a, b, da / (da - db));
+        }
+    }
+
+    std::vector<SwrTriangle> &triangles = ctx.chunkTriangles[chunk];
+    const uint32_t tileCount = ctx.tilesX * ctx.tilesY;
+    for (uint32_t i = 1; i + 1 < count; ++i) {
+        SwrVertex v[3] = { clipped[0], clipped[i], clipped[i + 1] };
+        SwrTriangle t;
+        if (!SwrTriangleSetup(ctx, v, lit, t)) {
+            continue;
+        }
+
+        uint32_t index = (uint32_t)triangles.size();
+        triangles.push_back(t);
+        for (int32_t ty = t.minY / SWR_TILE_SIZE; ty <= t.maxY / SWR_TILE_SIZE; ++ty) {
+            for (int32_t tx = t.minX / SWR_TILE_SIZE; tx <= t.maxX / SWR_TILE_SIZE; ++tx) {
+                ctx.chunkBins[chunk * tileCount + ty * ctx.tilesX + tx].push_back(index);
+            }
+        }
+    }
+}
+
+static void SwrDrawCube(SwrContext &ctx, uint32_t chunk, const glm::mat4 &viewProjection,
+                        const glm::mat4 &model, const glm::mat3 &normalMatrix, bool lit) {
+    glm::mat4 mvp = viewProjection * model;
+
+    // Same math as colors_vertex.glsl
+    SwrVertex vertices[CUBE_VERTEX_COUNT];
+    for (uint32_t i = 0; i < CUBE_VERTEX_COUNT; ++i) {
+        const float *src = &cubeVertices[i * CUBE_VERTEX_STRIDE];
+        glm::vec4 position(src[0], src[1], src[2], 1.0f);
+        vertices[i].clip = mvp * position;
+        vertices[i].position = glm::vec3(model * position);
+        vertices[i].normal = normalMatrix * glm::vec3(src[3], src[4], src[5]);
+        vertices[i].uv = glm::vec2(src[6], src[7]);
+    }
+
+    for (uint32_t i = 0; i < CUBE_VERTEX_COUNT; i += 3) {
+        SwrTriangleEmit(ctx, chunk, &vertices[i], lit);
+    }
+}
+
+// Raster
+// ---------------------------
+
+// Edge function A*x + B*y + C, positive on the inside of a CCW triangle.
+// Pixels exactly on an edge belong to it only for top and left edges.
+struct SwrEdge {
+    float a, b, c;
+    bool topLeft;
+};
+
+static SwrEdge SwrEdgeSetup(float x0, float y0, float x1, float y1) {
+    SwrEdge e;
+    e.a = y0 - y1;
+    e.b = x1 - x0;
+    e.c = -(e.a * x0 + e.b * y0);
+    e.topLeft = e.a > 0.0f || (e.a == 0.0f && e.b < 0.0f);
+    return e;
+}
+
+static inline __m128 SwrEdgeInside(__m128 e, bool topLeft) {
+    __m128 zero = _mm_setzero_ps();
+    return topLeft ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+}
+
+static void SwrRasterTriangle(SwrContext &ctx, const SwrTriangle &t,
+                              int32_t tileX0, int32_t tileY0, int32_t tileX1, int32_t tileY1) {
+    int32_t x0 = std::max(t.minX, tileX0) & ~3;
+    int32_t x1 = std::min(t.maxX, tileX1);
+    int32_t y0 = std::max(t.minY, tileY0);
+    int32_t y1 = std::min(t.maxY, tileY1);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+
+    SwrEdge e12 = SwrEdgeSetup(t.x[1], t.y[1], t.x[2], t.y[2]);
+    SwrEdge e20 = SwrEdgeSetup(t.x[2], t.y[2], t.x[0], t.y[0]);
+    SwrEdge e01 = SwrEdgeSetup(t.x[0], t.y[0], t.x[1], t.y[1]);
+    float area = e01.a * t.x[2] + e01.b * t.y[2] + e01.c;
+    float invArea = 1.0f / area;
+
+    const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 a12 = _mm_set1_ps(e12.a), a20 = _mm_set1_ps(e20.a), a01 = _mm_set1_ps(e01.a);
+    const __m128 step12 = _mm_set1_ps(e12.a * 4.0f);
+    const __m128 step20 = _mm_set1_ps(e20.a * 4.0f);
+    const __m128 step01 = _mm_set1_ps(e01.a * 4.0f);
+    const __m128 z0 = _mm_set1_ps(t.z[0]);
+    const __m128 dz1 = _mm_set1_ps((t.z[1] - t.z[0]) * invArea);
+    const __m128 dz2 = _mm_set1_ps((t.z[2] - t.z[0]) * invArea);
+    const __m128 vInvArea = _mm_set1_ps(invArea);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (int32_t y = y0; y <= y1; ++y) {
+        float py = (float)y + 0.5f;
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)x0), laneOffset);
+        __m128 w0 = _mm_add_ps(_mm_mul_ps(a12, px), _mm_set1_ps(e12.b * py + e12.c));
+        __m128 w1 = _mm_add_ps(_mm_mul_ps(a20, px), _mm_set1_ps(e20.b * py + e20.c));
+        __m128 w2 = _mm_add_ps(_mm_mul_ps(a01, px), _mm_set1_ps(e01.b * py + e01.c));
+
+        size_t row = (size_t)y * ctx.stride;
+        for (int32_t x = x0; x <= x1; x += 4) {
+            __m128 inside = _mm_and_ps(SwrEdgeInside(w0, e12.topLeft),
+                            _mm_and_ps(SwrEdgeInside(w1, e20.topLeft), SwrEdgeInside(w2, e01.topLeft)));
+            if (_mm_movemask_ps(inside)) {
+                size_t index = row + x;
+                __m128 z = _mm_add_ps(z0, _mm_add_ps(_mm_mul_ps(w1, dz1), _mm_mul_ps(w2, dz2)));
+                __m128 depth = _mm_loadu_ps(&ctx.depth[index]);
+                __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, depth));
+                pass = _mm_and_ps(pass, _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+
+                int mask = _mm_movemask_ps(pass);
+                if (mask) {
+                    __m128 l1 = _mm_mul_ps(w1, vInvArea);
+                    __m128 l2 = _mm_mul_ps(w2, vInvArea);
+                    __m128 oldL1 = _mm_loadu_ps(&ctx.weight1[index]);
+                    __m128 oldL2 = _mm_loadu_ps(&ctx.weight2[index]);
+                    _mm_storeu_ps(&ctx.depth[index], _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, depth)));
+                    _mm_storeu_ps(&ctx.weight1[index], _mm_or_ps(_mm_and_ps(pass, l1), _mm_andnot_ps(pass, oldL1)));
+                    _mm_storeu_ps(&ctx.weight2[index], _mm_or_ps(_mm_and_ps(pass, l2), _mm_andnot_ps(pass, oldL2)));
+                    for (int lane = 0; lane < 4; ++lane) {
+                        if (mask & (1 << lane)) {
+                            ctx.triangle[index + lane] = &t;
+                        }
+                    }
+                }
+            }
+            w0 = _mm_add_ps(w0, step12);
+            w1 = _mm_add_ps(w1, step20);
+            w2 = _mm_add_ps(w2, step01);
+        }
+    }
+}
+
+// Shade
+// ---------------------------
+static inline uint32_t SwrPackColor(glm::vec3 c) {
+    uint32_t r = (uint32_t)(std::min(std::max(c.x, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(std::min(std::max(c.y, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(std::min(std::max(c.z, 0.0f), 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | 0xff000000u;
+}
+
+// Same math as colors_fragment.glsl
+static glm::vec3 SwrShadeLit(const SwrContext &ctx, const SwrFrame &frame,
+                             glm::vec3 fragmentPosition, glm::vec3 normal, glm::vec2 uv) {
+    const SpotLight &light = frame.light;
+    glm::vec3 diffuseTexel, specularTexel;
+    if (ctx.packedMaterial) {
+        glm::vec4 texel = SwrTextureSample(ctx.materialMap, uv.x, uv.y);
+        diffuseTexel = glm::vec3(texel);
+        specularTexel = glm::vec3(texel.w);
+    } else {
+        diffuseTexel = glm::vec3(SwrTextureSample(ctx.diffuseMap, uv.x, uv.y));
+        specularTexel = glm::vec3(SwrTextureSample(ctx.specularMap, uv.x, uv.y));
+    }
+
+    glm::vec3 ambient = light.ambient * diffuseTexel;
+
+    glm::vec3 norm = glm::normalize(normal);
+    glm::vec3 toLight = light.position - fragmentPosition;
+    float distance = glm::length(toLight);
+    glm::vec3 lightDir = toLight / distance;
+    float diff = std::max(glm::dot(lightDir, norm), 0.0f);
+    glm::vec3 diffuse = diff * light.diffuse * diffuseTexel;
+
+    glm::vec3 cameraDir = glm::normalize(frame.cameraPosition - fragmentPosition);
+    glm::vec3 incident = -lightDir;
+    glm::vec3 reflectedDir = incident - 2.0f * glm::dot(norm, incident) * norm;
+    float spec = std::pow(std::max(glm::dot(cameraDir, reflectedDir), 0.0f), CUBE_MATERIAL_SHININESS);
+    glm::vec3 specular = spec * light.specular * specularTexel;
+
+    float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+
+    float theta = glm::dot(lightDir, glm::normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = std::min(std::max((theta - light.outerCutOff) / epsilon, 0.0f), 1.0f);
+
+    return (diffuse * intensity + specular * intensity + ambient) * attenuation;
+}
+
+static void SwrShadeTile(SwrContext &ctx, const SwrFrame &frame,
+                         int32_t tileX0, int32_t tileY0, int32_t tileX1, int32_t tileY1) {
+    for (int32_t y = tileY0; y <= tileY1; ++y) {
+        size_t row = (size_t)y * ctx.stride;
+        for (int32_t x = tileX0; x <= tileX1; ++x) {
+            size_t index = row + x;
+            const SwrTriangle *t = ctx.triangle[index];
+            if (!t) {
+                ctx.color[index] = 0xff000000u;
+                continue;
+            }
+            if (!t->lit) {
+                ctx.color[index] = 0xffffffffu;
+                continue;
+            }
+
+            // Perspective correct weights from the screen space ones
+            float l1 = ctx.weight1[index];
+            float l2 = ctx.weight2[index];
+            float p0 = (1.0f - l1 - l2) * t->invW[0];
+            float p1 = l1 * t->invW[1];
+            float p2 = l2 * t->invW[2];
+            float norm = 1.0f / (p0 + p1 + p2);
+            p0 *= norm;
+            p1 *= norm;
+            p2 *= norm;
+
+            glm::vec3 position = t->position[0] * p0 + t->position[1] * p1 + t->position[2] * p2;
+            glm::vec3 normal = t->normal[0] * p0 + t->normal[1] * p1 + t->normal[2] * p2;
+            glm::vec2 uv = t->uv[0] * p0 + t->uv[1] * p1 + t->uv[2] * p2;
+            ctx.color[index] = SwrPackColor(SwrShadeLit(ctx, frame, position, normal, uv));
+        }
+    }
+}
+
+// Frame
+// ---------------------------
+void SwrRenderFrame(SwrContext &ctx, const SwrFrame &frame) {
+    const uint32_t tileCount = ctx.tilesX * ctx.tilesY;
+    const uint32_t drawCount = frame.visibleCount + 1; // plus the light cube
+    const uint32_t chunkCount = std::min(drawCount, ctx.threadCount * 4);
+
+    ctx.chunkTriangles.resize(chunkCount);
+    ctx.chunkBins.resize((size_t)chunkCount * tileCount);
+    for (std::vector<SwrTriangle> &triangles : ctx.chunkTriangles) {
+        triangles.clear();
+    }
+    for (std::vector<uint32_t> &bin : ctx.chunkBins) {
+        bin.clear();
+    }
+
+    // Contiguous chunks of draws, so walking the chunks in order keeps the
+    // submission order inside every tile
+    JobPoolParallelFor(ctx.pool, chunkCount, [&](uint32_t chunk) {
+        uint32_t begin = (uint32_t)((uint64_t)drawCount * chunk / chunkCount);
+        uint32_t end = (uint32_t)((uint64_t)drawCount * (chunk + 1) / chunkCount);
+        for (uint32_t draw = begin; draw < end; ++draw) {
+            if (draw < frame.visibleCount) {
+                const CubeInstance &instance = frame.instances[frame.visible[draw]];
+                SwrDrawCube(ctx, chunk, frame.viewProjection, instance.model, instance.normalMatrix, true);
+            } else {
+                SwrDrawCube(ctx, chunk, frame.viewProjection, frame.lightCubeModel, glm::mat3(1.0f), false);
+            }
+        }
+    });
+
+    JobPoolParallelFor(ctx.pool, tileCount, [&](uint32_t tile) {
+        int32_t tileX0 = (int32_t)(tile % ctx.tilesX) * SWR_TILE_SIZE;
+        int32_t tileY0 = (int32_t)(tile / ctx.tilesX) * SWR_TILE_SIZE;
+        int32_t tileX1 = std::min(tileX0 + SWR_TILE_SIZE, (int32_t)ctx.width) - 1;
+        int32_t tileY1 = std::min(tileY0 + SWR_TILE_SIZE, (int32_t)ctx.height) - 1;
+
+        // The last 4-wide step of a row may run into the stride padding
+        int32_t clearX1 = std::min(tileX0 + SWR_TILE_SIZE, (int32_t)ctx.stride) - 1;
+        for (int32_t y = tileY0; y <= tileY1; ++y) {
+            size_t row = (size_t)y * ctx.stride;
+            std::fill(&ctx.depth[row + tileX0], &ctx.depth[row + clearX1] + 1, 1.0f);
+            std::fill(&ctx.triangle[row + tileX0], &ctx.triangle[row + clearX1] + 1, nullptr);
+        }
+
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+            const std::vector<SwrTriangle> &triangles = ctx.chunkTriangles[chunk];
+            for (uint32_t index : ctx.chunkBins[chunk * tileCount + tile]) {
+                SwrRasterTriangle(ctx, triangles[index], tileX0, tileY0, tileX1, tileY1);
+            }
+        }
+        SwrShadeTile(ctx, frame, tileX0, tileY0, tileX1, tileY1);
+    });
+
+    ctx.textureBytes = SwrTextureTakeTouchedBytes(ctx.diffuseMap) + SwrTextureTakeTouchedBytes(ctx.specularMap) +
+                       SwrTextureTakeTouchedBytes(ctx.materialMap);
+}
+
+bool SwrWritePPM(const SwrContext &ctx, const char *path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file << "P6\n" << ctx.width << " " << ctx.height << "\n255\n";
+    std::vector<char> row(ctx.width * 3);
+    for (uint32_t y = ctx.height; y-- > 0;) {
+        for (uint32_t x = 0; x < ctx.width; ++x) {
+            uint32_t c = ctx.color[(size_t)y * ctx.stride + x];
+            row[x * 3 + 0] = (char)(c & 0xff);
+            row[x * 3 + 1] = (char)((c >> 8) & 0xff);
+            row[x * 3 + 2] = (char)((c >> 16) & 0xff);
+        }
+        file.write(row.data(), row.size());
+    }
+    return (bool)file;
+}
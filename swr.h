@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+#include "scene.h"
+
+// Software rasterizer
+// Draws the lit-cube scene without a GPU. Triangles are transformed and
+// binned into screen tiles in parallel chunks, then every tile is
+// rasterized with SSE edge functions into a visibility buffer (depth,
+// triangle, barycentrics) and shaded once per pixel. Tiles are spread
+// over the job pool, so no two threads ever touch the same pixel.
+// -------------------------------------
+#define SWR_TILE_SIZE 64 // multiple of 4, the rasterizer steps 4 pixels at a time
+#define SWR_CACHE_LINE 64
+
+struct SwrTexture {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint32_t> texels; // RGBA8, rows bottom to top, like the GL upload
+    // One bit per SWR_CACHE_LINE bytes of texels, set by this frame's samples
+    std::unique_ptr<std::atomic<uint64_t>[]> linesTouched;
+    uint32_t lineWords = 0; // stays 0 for the maps a context doesn't load
+};
+
+// A triangle after clipping and viewport transform, with counter-clockwise
+// winding in window coordinates
+struct SwrTriangle {
+    float x[3];
+    float y[3];
+    float z[3];
+    float invW[3];
+    glm::vec3 position[3];
+    glm::vec3 normal[3];
+    glm::vec2 uv[3];
+    bool lit; // false for the light cube, which is plain white
+    int32_t minX, minY, maxX, maxY;
+};
+
+// Everything RendererDrawFrame hands the GL path for one frame
+struct SwrFrame {
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;
+    SpotLight light;
+    const CubeInstance *instances;
+    const uint32_t *visible;
+    uint32_t visibleCount;
+    glm::mat4 lightCubeModel;
+};
+
+struct SwrContext {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride; // width rounded up to 4
+    uint32_t tilesX;
+    uint32_t tilesY;
+
+    std::vector<uint32_t> color; // RGBA8, rows bottom to top
+    std::vector<float> depth;
+    std::vector<const SwrTriangle *> triangle;
+    std::vector<float> weight1; // screen space barycentrics of vertex 1 and 2
+    std::vector<float> weight2;
+
+    // Either both maps, or one packed texture with specular in alpha like
+    // the GL path samples (material_pack.h)
+    bool packedMaterial;
+    SwrTexture diffuseMap;
+    SwrTexture specularMap;
+    SwrTexture materialMap;
+    uint64_t textureBytes; // distinct texture cache lines the last frame sampled, in bytes
+
+    // Transform output, one triangle list and one set of tile bins per chunk
+    std::vector<std::vector<SwrTriangle>> chunkTriangles;
+    std::vector<std::vector<uint32_t>> chunkBins; // [chunk * tileCount + tile]
+
+    uint32_t threadCount;
+    JobPool pool;
+};
+
+// threadCount includes the calling thread, which always takes part
+void SwrInit(SwrContext &ctx, uint32_t width, uint32_t height, uint32_t threadCount,
+             const char *diffusePath, const char *specularPath, bool packedMaterial);
+void SwrShutdown(SwrContext &ctx);
+void SwrRenderFrame(SwrContext &ctx, const SwrFrame &frame);
+bool SwrWritePPM(const SwrContext &ctx, const char *path);
@@ -0,0 +1,331 @@
+#include "texture_streamer.h"
+#include "cooked_texture.h"
+#include "bc_encoder.h"
+#include "material_pack.h"
+#include "gl_state.h"
+#include "stb_image.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+static GLenum TextureFormat(int channels) {
+    switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+// Releases the pixels of a decode, whichever way they were produced
+static void TextureDecodedFree(TextureDecoded &d) {
+    if (d.cached.pixels) {
+        ImageCacheClose(d.cached);
+    } else {
+        stbi_image_free(d.pixels);
+    }
+    d.pixels = nullptr;
+}
+
+void TextureStreamerInit(TextureStreamer &s, JobPool &pool, ImageCache *imageCache, uint32_t frameBudget) {
+    s.pool = &pool;
+    s.imageCache = imageCache;
+    s.pboIndex = 0;
+    s.frameBudget = frameBudget;
+    s.bytesUploaded = 0;
+    s.bytesUploadedThisFrame = 0;
+
+    // Mid grey, so lighting still reads while the real texture streams in.
+    // Alpha too, it is the specular of packed materials.
+    const unsigned char grey[4] = { 128, 128, 128, 128 };
+    glGenTextures(1, &s.placeholder);
+    GLStateBindTextureForEdit(0, GL_TEXTURE_2D, s.placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+
+    glGenBuffers(TEXTURE_STREAM_PBO_COUNT, s.pbos);
+    for (uint32_t i = 0; i < TEXTURE_STREAM_PBO_COUNT; ++i) {
+        GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBudget, nullptr, GL_STREAM_DRAW);
+        s.fences[i] = nullptr;
+    }
+    GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamerShutdown(TextureStreamer &s) {
+    // The pool is shut down by its owner first, so no decode can still
+    // be writing to `ready`
+    for (TextureDecoded &d : s.ready) {
+        TextureDecodedFree(d);
+    }
+    s.ready.clear();
+    for (TextureStreamEntry &e : s.entries) {
+        if (!e.resident && e.decoded.pixels) {
+            TextureDecodedFree(e.decoded);
+        }
+        GLStateDeleteTextures(1, &e.texture);
+    }
+    s.entries.clear();
+    for (uint32_t i = 0; i < TEXTURE_STREAM_PBO_COUNT; ++i) {
+        if (s.fences[i]) {
+            glDeleteSync(s.fences[i]);
+        }
+    }
+    GLStateDeleteBuffers(TEXTURE_STREAM_PBO_COUNT, s.pbos);
+    GLStateDeleteTextures(1, &s.placeholder);
+}
+
+// Cooked textures already carry every mip level, upload them straight from
+// the mapping: no decode, no staging copy, no glGenerateMipmap. Block
+// compressed levels stay compressed on the GPU when the driver has the
+// format, otherwise they are expanded back to RGBA first.
+// ---------------------------
+static bool TextureStreamerUploadCooked(TextureStreamEntry &e) {
+    CookedTexture cooked;
+    bool packed = !e.specularPath.empty();
+    std::string cookedPath = packed ? CookedTexturePackedPath(e.path.c_str(), e.specularPath.c_str())
+                                    : CookedTexturePath(e.path.c_str());
+    if (!CookedTextureOpen(cooked, cookedPath.c_str(), e.path.c_str(), packed ? e.specularPath.c_str() : nullptr)) {
+        return false;
+    }
+
+    const CookedTextureHeader &header = *cooked.header;
+    BcFormat blockFormat = (BcFormat)header.format;
+    bool compressed = blockFormat != BC_FORMAT_NONE && BcGLSupported(blockFormat);
+    GLenum format = TextureFormat((int)header.channels);
+    GLStateBindTextureForEdit(0, GL_TEXTURE_2D, e.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)header.mipCount - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::vector<uint8_t> decoded; // blocks the driver can't sample, expanded to RGBA
+    for (uint32_t level = 0; level < header.mipCount; ++level) {
+        const CookedTextureMip &mip = header.mips[level];
+        const uint8_t *data = CookedTextureMipData(cooked, level);
+        if (compressed) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, BcGLInternalFormat(blockFormat),
+                (GLsizei)mip.width, (GLsizei)mip.height, 0, (GLsizei)mip.size, data);
+        } else if (blockFormat != BC_FORMAT_NONE) {
+            decoded.resize((size_t)mip.width * mip.height * 4);
+            BcDecode(blockFormat, data, mip.width, mip.height, decoded.data());
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA, (GLsizei)mip.width, (GLsizei)mip.height, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, (GLsizei)mip.width, (GLsizei)mip.height, 0,
+                format, GL_UNSIGNED_BYTE, data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    CookedTextureClose(cooked);
+    e.resident = true;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - e.requested).count();
+    std::cout << "Texture " << e.path << " resident after " << ms << " ms (cooked " << BcFormatName(blockFormat)
+              << (blockFormat != BC_FORMAT_NONE && !compressed ? ", decoded on the CPU" : "") << ")" << std::endl;
+    return true;
+}
+
+uint32_t TextureStreamerRequest(TextureStreamer &s, const char *path, const char *specularPath) {
+    uint32_t handle = (uint32_t)s.entries.size();
+    TextureStreamEntry entry{};
+    entry.path = path;
+    entry.specularPath = specularPath ? specularPath : "";
+    entry.requested = std::chrono::steady_clock::now();
+    glGenTextures(1, &entry.texture);
+    s.entries.push_back(entry);
+
+    if (TextureStreamerUploadCooked(s.entries[handle])) {
+        return handle;
+    }
+
+    TextureStreamer *streamer = &s;
+    std::string file = path;
+    std::string specularFile = entry.specularPath;
+    // Nothing waits on it, keep it away from threads waiting on frame work
+    JobPoolSubmitBackground(*s.pool, [streamer, handle, file, specularFile] {
+        TextureDecoded decoded{};
+        decoded.handle = handle;
+
+        // The recipe names everything that shapes the pixels besides the
+        // source contents
+        ImageCache *cache = streamer->imageCache;
+        const char *sources[] = { file.c_str(), specularFile.c_str() };
+        uint64_t key = 0;
+        if (cache) {
+            key = specularFile.empty() ? ImageCacheKey(*cache, sources, 1, "stb_image flipped, source channels")
+                                       : ImageCacheKey(*cache, sources, 2, "material pack, specular luma in alpha, flipped");
+        }
+        if (cache && ImageCacheOpen(*cache, key, decoded.cached)) {
+            decoded.pixels = (unsigned char *)decoded.cached.pixels;
+            decoded.width = decoded.cached.width;
+            decoded.height = decoded.cached.height;
+            decoded.channels = decoded.cached.channels;
+        } else {
+            auto decodeStart = std::chrono::steady_clock::now();
+            if (specularFile.empty()) {
+                stbi_set_flip_vertically_on_load_thread(true);
+                decoded.pixels = stbi_load(file.c_str(), &decoded.width, &decoded.height, &decoded.channels, 0);
+            } else {
+                decoded.pixels = MaterialPackLoad(file.c_str(), specularFile.c_str(), decoded.width, decoded.height);
+                decoded.channels = 4;
+            }
+            double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count();
+            if (!decoded.pixels) {
+                // Thread local in stb_image, the render thread would read null
+                decoded.failure = stbi_failure_reason();
+            }
+            if (cache) {
+                ImageCacheStore(*cache, key, decoded.pixels, decoded.width, decoded.height, decoded.channels, decodeMs);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(streamer->readyMutex);
+        streamer->ready.push_back(decoded);
+    });
+    return handle;
+}
+
+static void TextureStreamerFinishUpload(TextureStreamEntry &e) {
+    GLStateBindTextureForEdit(0, GL_TEXTURE_2D, e.texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    bool cached = e.decoded.cached.pixels != nullptr;
+    TextureDecodedFree(e.decoded);
+    e.resident = true;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - e.requested).count();
+    std::cout << "Texture " << e.path << " resident after " << ms << " ms" << (cached ? " (image cache)" : "") << std::endl;
+}
+
+// Allocate level 0 for a freshly decoded image and queue its rows for upload
+// ---------------------------
+static void TextureStreamerBeginUpload(TextureStreamer &s, const TextureDecoded &decoded) {
+    TextureStreamEntry &e = s.entries[decoded.handle];
+    if (!decoded.pixels) {
+        std::cerr << "Failed to load image " << e.path << " : " << (decoded.failure ? decoded.failure : "unknown error")
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    e.decoded = decoded;
+    e.nextRow = 0;
+
+    GLenum format = TextureFormat(decoded.channels);
+    GLStateBindTextureForEdit(0, GL_TEXTURE_2D, e.texture);
+
+    // A single row that doesn't fit in a PBO can't be split, upload it directly
+    size_t pitch = (size_t)decoded.width * decoded.channels;
+    if (pitch > s.frameBudget) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, decoded.width, decoded.height, 0, format, GL_UNSIGNED_BYTE, decoded.pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        e.nextRow = decoded.height;
+        TextureStreamerFinishUpload(e);
+        return;
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, format, decoded.width, decoded.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+    s.uploads.push_back(decoded.handle);
+}
+
+struct TextureUploadChunk {
+    uint32_t handle;
+    int firstRow;
+    int rowCount;
+    size_t offset;
+};
+
+void TextureStreamerUpdate(TextureStreamer &s) {
+    s.bytesUploadedThisFrame = 0;
+
+    std::vector<TextureDecoded> decoded;
+    {
+        std::lock_guard<std::mutex> lock(s.readyMutex);
+        decoded.swap(s.ready);
+    }
+    for (const TextureDecoded &d : decoded) {
+        TextureStreamerBeginUpload(s, d);
+    }
+    if (s.uploads.empty()) {
+        return;
+    }
+
+    // Only reuse a PBO once the GPU has consumed what we last put in it
+    uint32_t index = s.pboIndex;
+    if (s.fences[index]) {
+        GLenum status = glClientWaitSync(s.fences[index], 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        glDeleteSync(s.fences[index]);
+        s.fences[index] = nullptr;
+    }
+
+    GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbos[index]);
+    unsigned char *mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, s.frameBudget,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!mapped) {
+        GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    // Copy whole rows into the PBO until the frame budget is spent
+    TextureUploadChunk chunks[16];
+    uint32_t chunkCount = 0;
+    size_t used = 0;
+    for (uint32_t handle : s.uploads) {
+        if (chunkCount == 16) {
+            break;
+        }
+        TextureStreamEntry &e = s.entries[handle];
+        size_t pitch = (size_t)e.decoded.width * e.decoded.channels;
+        int rowsLeft = e.decoded.height - e.nextRow;
+        int rows = (int)((s.frameBudget - used) / pitch);
+        if (rows > rowsLeft) {
+            rows = rowsLeft;
+        }
+        if (rows <= 0) {
+            break;
+        }
+        memcpy(mapped + used, e.decoded.pixels + pitch * e.nextRow, pitch * rows);
+        chunks[chunkCount++] = { handle, e.nextRow, rows, used };
+        e.nextRow += rows;
+        used += pitch * rows;
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // Rows are tightly packed, whatever the width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t i = 0; i < chunkCount; ++i) {
+        const TextureUploadChunk &c = chunks[i];
+        TextureStreamEntry &e = s.entries[c.handle];
+        GLStateBindTextureForEdit(0, GL_TEXTURE_2D, e.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, c.firstRow, e.decoded.width, c.rowCount,
+            TextureFormat(e.decoded.channels), GL_UNSIGNED_BYTE, (const void *)c.offset);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GLStateBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    s.fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    s.pboIndex = (index + 1) % TEXTURE_STREAM_PBO_COUNT;
+    s.bytesUploadedThisFrame = (uint32_t)used;
+    s.bytesUploaded += used;
+
+    while (!s.uploads.empty()) {
+        TextureStreamEntry &e = s.entries[s.uploads.front()];
+        if (e.nextRow < e.decoded.height) {
+            break;
+        }
+        TextureStreamerFinishUpload(e);
+        s.uploads.pop_front();
+    }
+}
+
+uint32_t TextureStreamerResolve(const TextureStreamer &s, uint32_t handle) {
+    const TextureStreamEntry &e = s.entries[handle];
+    return e.resident ? e.texture : s.placeholder;
+}
+
+bool TextureStreamerAllResident(const TextureStreamer &s) {
+    for (const TextureStreamEntry &e : s.entries) {
+        if (!e.resident) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <glad/glad.h>
+
+#include "jobs.h"
+#include "image_cache.h"
+
+// Texture streaming
+// Textures with an up to date cooked container (see cooked_texture.h) are
+// uploaded right away from its mapping. Other images are decoded by
+// stb_image on the job pool, or mapped from the decoded image cache
+// (image_cache.h) when it has them. The render thread then uploads them
+// through a ring of pixel unpack buffers, at most
+// TEXTURE_STREAM_FRAME_BUDGET bytes per frame. Until a texture is fully
+// resident TextureStreamerResolve hands out a 1x1 placeholder instead.
+// Textures carry only their mip range, filtering and wrapping come from
+// the sampler bound next to them (sampler_cache.h).
+// -------------------------------------
+#define TEXTURE_STREAM_PBO_COUNT 3
+#define TEXTURE_STREAM_FRAME_BUDGET (4u * 1024u * 1024u)
+
+struct TextureDecoded {
+    uint32_t handle;
+    // Owned by stb_image until the upload finishes. On an image cache hit
+    // it points into `cached` instead, which is unmapped afterwards.
+    unsigned char *pixels;
+    ImageCacheImage cached;
+    int width;
+    int height;
+    int channels;
+    const char *failure; // stb_image's reason when pixels is null, read on the decoding thread
+};
+
+struct TextureStreamEntry {
+    std::string path;
+    std::string specularPath; // packed into alpha (material_pack.h), empty for a plain texture
+    uint32_t texture;
+    bool resident;
+    TextureDecoded decoded;
+    int nextRow;
+    std::chrono::steady_clock::time_point requested;
+};
+
+struct TextureStreamer {
+    JobPool *pool;
+    ImageCache *imageCache; // may be null
+    uint32_t placeholder;
+    std::vector<TextureStreamEntry> entries;
+
+    // Filled by the decode jobs, drained by TextureStreamerUpdate
+    std::mutex readyMutex;
+    std::vector<TextureDecoded> ready;
+
+    // Handles whose pixels are still being copied into their texture
+    std::deque<uint32_t> uploads;
+
+    uint32_t pbos[TEXTURE_STREAM_PBO_COUNT];
+    GLsync fences[TEXTURE_STREAM_PBO_COUNT];
+    uint32_t pboIndex;
+    uint32_t frameBudget;
+
+    uint64_t bytesUploaded;
+    uint32_t bytesUploadedThisFrame;
+};
+
+void TextureStreamerInit(TextureStreamer &s, JobPool &pool, ImageCache *imageCache = nullptr,
+                         uint32_t frameBudget = TEXTURE_STREAM_FRAME_BUDGET);
+void TextureStreamerShutdown(TextureStreamer &s);
+
+// Queues `path` for decoding and returns a handle for TextureStreamerResolve.
+// With `specularPath` the texture is the material pack of both maps.
+uint32_t TextureStreamerRequest(TextureStreamer &s, const char *path, const char *specularPath = nullptr);
+
+// Call once per frame on the GL thread
+void TextureStreamerUpdate(TextureStreamer &s);
+
+// GL texture to bind for `handle`: the real one once resident, else the placeholder
+uint32_t TextureStreamerResolve(const TextureStreamer &s, uint32_t handle);
+bool TextureStreamerAllResident(const TextureStreamer &s);
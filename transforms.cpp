@@ -0,0 +1,326 @@
+#include "transforms.h"
+#include "cpu_features.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// CubeInstance is written as 25 consecutive floats: the model matrix
+// column by column, then the normal matrix column by column
+static_assert(sizeof(CubeInstance) == 25 * sizeof(float), "CubeInstance must be tightly packed");
+
+#define TRANSFORM_ROWS 20 // the non-constant floats of a CubeInstance
+
+// Output float of each kernel row inside a CubeInstance
+static const uint8_t transformRowOffset[TRANSFORM_ROWS] = {
+    0, 1, 2,     // model column 0
+    4, 5, 6,     // model column 1
+    8, 9, 10,    // model column 2
+    12, 13, 14,  // model column 3, the translation
+    16, 17, 18,  // normal matrix
+    19, 20, 21,
+    22, 23,      // normal[2][2] is the separate `normal22` output
+};
+
+void TransformsResize(Transforms &t, uint32_t count) {
+    // Padded to whole blocks with identity transforms, so kernels never
+    // need a remainder loop
+    uint32_t padded = (count + TRANSFORM_BLOCK - 1) / TRANSFORM_BLOCK * TRANSFORM_BLOCK;
+    t.px.assign(padded, 0.0f);
+    t.py.assign(padded, 0.0f);
+    t.pz.assign(padded, 0.0f);
+    t.qx.assign(padded, 0.0f);
+    t.qy.assign(padded, 0.0f);
+    t.qz.assign(padded, 0.0f);
+    t.qw.assign(padded, 1.0f);
+    t.scale.assign(padded, 1.0f);
+    t.dirtyBlocks.assign(padded / TRANSFORM_BLOCK, 1);
+    t.count = count;
+    t.anyDirty = true;
+}
+
+void TransformsSet(Transforms &t, uint32_t index, glm::vec3 position, glm::vec3 axis, float angle, float scale) {
+    glm::vec3 a = glm::normalize(axis);
+    float s = std::sin(angle * 0.5f);
+    t.px[index] = position.x;
+    t.py[index] = position.y;
+    t.pz[index] = position.z;
+    t.qx[index] = a.x * s;
+    t.qy[index] = a.y * s;
+    t.qz[index] = a.z * s;
+    t.qw[index] = std::cos(angle * 0.5f);
+    t.scale[index] = scale;
+    t.dirtyBlocks[index / TRANSFORM_BLOCK] = 1;
+    t.anyDirty = true;
+}
+
+void TransformsMarkAllDirty(Transforms &t) {
+    std::fill(t.dirtyBlocks.begin(), t.dirtyBlocks.end(), (uint8_t)1);
+    t.anyDirty = true;
+}
+
+// Copies one block of kernel rows into the instances, lane by lane
+static void TransformScatter(const float rows[][TRANSFORM_BLOCK], float normal22[TRANSFORM_BLOCK],
+                             CubeInstance *out, uint32_t base, uint32_t count) {
+    uint32_t lanes = std::min<uint32_t>(TRANSFORM_BLOCK, count - base);
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+        float *dst = (float *)&out[base + lane];
+        for (uint32_t row = 0; row < TRANSFORM_ROWS; ++row) {
+            dst[transformRowOffset[row]] = rows[row][lane];
+        }
+        dst[3] = 0.0f;
+        dst[7] = 0.0f;
+        dst[11] = 0.0f;
+        dst[15] = 1.0f;
+        dst[24] = normal22[lane];
+    }
+}
+
+// Scalar
+// ---------------------------
+static void TransformBlockScalar(const Transforms &t, uint32_t base, CubeInstance *out) {
+    alignas(32) float rows[TRANSFORM_ROWS][TRANSFORM_BLOCK];
+    alignas(32) float normal22[TRANSFORM_BLOCK];
+    for (uint32_t lane = 0; lane < TRANSFORM_BLOCK; ++lane) {
+        uint32_t i = base + lane;
+        float x = t.qx[i], y = t.qy[i], z = t.qz[i], w = t.qw[i];
+        float s = t.scale[i];
+        float invS = 1.0f / s;
+
+        // Columns of the rotation matrix
+        float r[9] = {
+            1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y),
+            2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x),
+            2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y),
+        };
+        for (int k = 0; k < 9; ++k) {
+            rows[k][lane] = r[k] * s;
+        }
+        rows[9][lane] = t.px[i];
+        rows[10][lane] = t.py[i];
+        rows[11][lane] = t.pz[i];
+        for (int k = 0; k < 8; ++k) {
+            rows[12 + k][lane] = r[k] * invS;
+        }
+        normal22[lane] = r[8] * invS;
+    }
+    TransformScatter(rows, normal22, out, base, t.count);
+}
+
+// SSE2, 4 instances per step
+// ---------------------------
+static void TransformBlockSSE2(const Transforms &t, uint32_t base, CubeInstance *out) {
+    alignas(32) float rows[TRANSFORM_ROWS][TRANSFORM_BLOCK];
+    alignas(32) float normal22[TRANSFORM_BLOCK];
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    for (uint32_t half = 0; half < TRANSFORM_BLOCK; half += 4) {
+        uint32_t i = base + half;
+        __m128 x = _mm_loadu_ps(&t.qx[i]);
+        __m128 y = _mm_loadu_ps(&t.qy[i]);
+        __m128 z = _mm_loadu_ps(&t.qz[i]);
+        __m128 w = _mm_loadu_ps(&t.qw[i]);
+        __m128 s = _mm_loadu_ps(&t.scale[i]);
+        __m128 invS = _mm_div_ps(one, s);
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 r[9] = {
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))),
+            _mm_mul_ps(two, _mm_add_ps(xy, wz)),
+            _mm_mul_ps(two, _mm_sub_ps(xz, wy)),
+            _mm_mul_ps(two, _mm_sub_ps(xy, wz)),
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))),
+            _mm_mul_ps(two, _mm_add_ps(yz, wx)),
+            _mm_mul_ps(two, _mm_add_ps(xz, wy)),
+            _mm_mul_ps(two, _mm_sub_ps(yz, wx)),
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))),
+        };
+        for (int k = 0; k < 9; ++k) {
+            _mm_store_ps(&rows[k][half], _mm_mul_ps(r[k], s));
+        }
+        _mm_store_ps(&rows[9][half], _mm_loadu_ps(&t.px[i]));
+        _mm_store_ps(&rows[10][half], _mm_loadu_ps(&t.py[i]));
+        _mm_store_ps(&rows[11][half], _mm_loadu_ps(&t.pz[i]));
+        for (int k = 0; k < 8; ++k) {
+            _mm_store_ps(&rows[12 + k][half], _mm_mul_ps(r[k], invS));
+        }
+        _mm_store_ps(&normal22[half], _mm_mul_ps(r[8], invS));
+    }
+    TransformScatter(rows, normal22, out, base, t.count);
+}
+
+// AVX2, 8 instances per step
+// ---------------------------
+SIMD_TARGET_AVX2
+static void TransformBlockAVX2(const Transforms &t, uint32_t base, CubeInstance *out) {
+    alignas(32) float rows[TRANSFORM_ROWS][TRANSFORM_BLOCK];
+    alignas(32) float normal22[TRANSFORM_BLOCK];
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    __m256 x = _mm256_loadu_ps(&t.qx[base]);
+    __m256 y = _mm256_loadu_ps(&t.qy[base]);
+    __m256 z = _mm256_loadu_ps(&t.qz[base]);
+    __m256 w = _mm256_loadu_ps(&t.qw[base]);
+    __m256 s = _mm256_loadu_ps(&t.scale[base]);
+    __m256 invS = _mm256_div_ps(one, s);
+
+    __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+    __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+    __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+    __m256 r[9] = {
+        _mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one),
+        _mm256_mul_ps(two, _mm256_add_ps(xy, wz)),
+        _mm256_mul_ps(two, _mm256_sub_ps(xz, wy)),
+        _mm256_mul_ps(two, _mm256_sub_ps(xy, wz)),
+        _mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one),
+        _mm256_mul_ps(two, _mm256_add_ps(yz, wx)),
+        _mm256_mul_ps(two, _mm256_add_ps(xz, wy)),
+        _mm256_mul_ps(two, _mm256_sub_ps(yz, wx)),
+        _mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one),
+    };
+    for (int k = 0; k < 9; ++k) {
+        _mm256_store_ps(rows[k], _mm256_mul_ps(r[k], s));
+    }
+    _mm256_store_ps(rows[9], _mm256_loadu_ps(&t.px[base]));
+    _mm256_store_ps(rows[10], _mm256_loadu_ps(&t.py[base]));
+    _mm256_store_ps(rows[11], _mm256_loadu_ps(&t.pz[base]));
+    for (int k = 0; k < 8; ++k) {
+        _mm256_store_ps(rows[12 + k], _mm256_mul_ps(r[k], invS));
+    }
+    _mm256_store_ps(normal22, _mm256_mul_ps(r[8], invS));
+    _mm256_zeroupper();
+    TransformScatter(rows, normal22, out, base, t.count);
+}
+
+const char *TransformPathName(TransformPath path) {
+    switch (path) {
+    case TRANSFORM_PATH_SCALAR: return "scalar";
+    case TRANSFORM_PATH_SSE2: return "sse2";
+    case TRANSFORM_PATH_AVX2: return "avx2";
+    default: return "auto";
+    }
+}
+
+TransformPath TransformBestPath() {
+    const CpuFeatures &cpu = CpuGetFeatures();
+    if (cpu.avx2 && cpu.fma) {
+        return TRANSFORM_PATH_AVX2;
+    }
+    if (cpu.sse2) {
+        return TRANSFORM_PATH_SSE2;
+    }
+    return TRANSFORM_PATH_SCALAR;
+}
+
+uint32_t TransformsUpdate(Transforms &t, CubeInstance *out, JobPool *pool, TransformPath path) {
+    if (!t.anyDirty) {
+        return 0;
+    }
+    if (path == TRANSFORM_PATH_AUTO) {
+        path = TransformBestPath();
+    }
+    void (*kernel)(const Transforms &, uint32_t, CubeInstance *) =
+        path == TRANSFORM_PATH_AVX2 ? TransformBlockAVX2 :
+        path == TRANSFORM_PATH_SSE2 ? TransformBlockSSE2 : TransformBlockScalar;
+
+    const uint32_t blockCount = (uint32_t)t.dirtyBlocks.size();
+    const uint32_t jobCount = (blockCount + TRANSFORM_JOB_BLOCKS - 1) / TRANSFORM_JOB_BLOCKS;
+    std::vector<uint32_t> rebuilt(jobCount, 0);
+    auto job = [&](uint32_t j) {
+        uint32_t end = std::min(blockCount, (j + 1) * TRANSFORM_JOB_BLOCKS);
+        for (uint32_t block = j * TRANSFORM_JOB_BLOCKS; block < end; ++block) {
+            if (t.dirtyBlocks[block]) {
+                kernel(t, block * TRANSFORM_BLOCK, out);
+                t.dirtyBlocks[block] = 0;
+                rebuilt[j] += std::min<uint32_t>(TRANSFORM_BLOCK, t.count - block * TRANSFORM_BLOCK);
+            }
+        }
+    };
+    if (pool) {
+        JobPoolParallelFor(*pool, jobCount, job);
+    } else {
+        for (uint32_t j = 0; j < jobCount; ++j) {
+            job(j);
+        }
+    }
+    t.anyDirty = false;
+
+    uint32_t total = 0;
+    for (uint32_t n : rebuilt) {
+        total += n;
+    }
+    return total;
+}
+
+// Benchmark
+// ---------------------------
+static float TransformRandom(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    return (float)(state >> 8) / 16777216.0f;
+}
+
+void TransformBenchmark(JobPool &pool) {
+    const uint32_t count = 1000000;
+    const uint32_t iterations = 10;
+
+    Transforms t;
+    TransformsResize(t, count);
+    uint32_t seed = 1234;
+    for (uint32_t i = 0; i < count; ++i) {
+        glm::vec3 position(TransformRandom(seed) * 100.0f, TransformRandom(seed) * 100.0f, TransformRandom(seed) * 100.0f);
+        glm::vec3 axis(TransformRandom(seed) - 0.5f, TransformRandom(seed) - 0.5f, TransformRandom(seed) + 0.1f);
+        TransformsSet(t, i, position, axis, TransformRandom(seed) * 6.2831853f, 0.5f + TransformRandom(seed));
+    }
+
+    std::vector<CubeInstance> reference(count);
+    TransformsUpdate(t, reference.data(), nullptr, TRANSFORM_PATH_SCALAR);
+
+    // The general path this replaces: glm inverse of the full 4x4 model
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i) {
+            reference[i].normalMatrix = glm::transpose(glm::mat3(glm::inverse(reference[i].model)));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "transforms " << count << ": glm::inverse normal matrices " << ms << " ms" << std::endl;
+    }
+
+    const CpuFeatures &cpu = CpuGetFeatures();
+    std::vector<CubeInstance> out(count);
+    const TransformPath paths[] = { TRANSFORM_PATH_SCALAR, TRANSFORM_PATH_SSE2, TRANSFORM_PATH_AVX2 };
+    for (TransformPath path : paths) {
+        if ((path == TRANSFORM_PATH_SSE2 && !cpu.sse2) || (path == TRANSFORM_PATH_AVX2 && !(cpu.avx2 && cpu.fma))) {
+            continue;
+        }
+        for (int threaded = 0; threaded < 2; ++threaded) {
+            double best = 1e30;
+            for (uint32_t it = 0; it < iterations; ++it) {
+                TransformsMarkAllDirty(t);
+                auto start = std::chrono::steady_clock::now();
+                TransformsUpdate(t, out.data(), threaded ? &pool : nullptr, path);
+                best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            float maxError = 0.0f;
+            for (uint32_t i = 0; i < count; ++i) {
+                const float *a = (const float *)&out[i];
+                const float *b = (const float *)&reference[i];
+                for (int k = 0; k < 25; ++k) {
+                    maxError = std::max(maxError, std::fabs(a[k] - b[k]));
+                }
+            }
+            std::cout << "transforms " << TransformPathName(path) << (threaded ? " pool:   " : " single: ")
+                      << best << " ms, max error vs glm " << maxError << std::endl;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "jobs.h"
+#include "scene.h"
+
+// Instance transforms
+// Position, rotation (unit quaternion) and uniform scale are kept as
+// structure of arrays. Changes mark their block of TRANSFORM_BLOCK
+// instances dirty, and TransformsUpdate rebuilds model and normal matrices
+// for dirty blocks only, 8 (AVX2) or 4 (SSE2) instances per step spread
+// over a job pool. The transforms are rigid plus uniform scale, so the
+// normal matrix is the rotation divided by the scale and no general
+// inverse is ever needed.
+// -------------------------------------
+#define TRANSFORM_BLOCK 8
+#define TRANSFORM_JOB_BLOCKS 128 // blocks per job
+
+struct Transforms {
+    std::vector<float> px;
+    std::vector<float> py;
+    std::vector<float> pz;
+    std::vector<float> qx;
+    std::vector<float> qy;
+    std::vector<float> qz;
+    std::vector<float> qw;
+    std::vector<float> scale;
+    std::vector<uint8_t> dirtyBlocks;
+    uint32_t count;
+    bool anyDirty;
+};
+
+enum TransformPath {
+    TRANSFORM_PATH_SCALAR,
+    TRANSFORM_PATH_SSE2,
+    TRANSFORM_PATH_AVX2,
+    TRANSFORM_PATH_AUTO
+};
+
+void TransformsResize(Transforms &t, uint32_t count);
+// Rotation of `angle` radians around `axis`, which need not be normalized
+void TransformsSet(Transforms &t, uint32_t index, glm::vec3 position, glm::vec3 axis, float angle, float scale);
+void TransformsMarkAllDirty(Transforms &t);
+
+// Writes model and normal matrices of dirty instances to out[0..count) and
+// returns how many were rebuilt. `pool` may be null to run inline.
+uint32_t TransformsUpdate(Transforms &t, CubeInstance *out, JobPool *pool, TransformPath path = TRANSFORM_PATH_AUTO);
+
+const char *TransformPathName(TransformPath path);
+TransformPath TransformBestPath();
+
+// Rebuilds 1M transforms on every path, single threaded and on the pool
+void TransformBenchmark(JobPool &pool);